@@ -33,11 +33,55 @@
 #include <thread>
 #include <memory>
 #include <mutex>
+#include <chrono>
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <rtac_asio/BufferPool.h>
+#include <rtac_asio/ServiceMonitor.h>
 
 namespace rtac { namespace asio {
 
+class TimerWheel;
+class UringQueue;
+
+// Hint to the CPU that the caller is spinning (busy-wait loops).
+inline void spin_pause()
+{
+    #if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+    #elif defined(__aarch64__)
+    asm volatile("yield");
+    #endif
+}
+
+/**
+ * Wraps a boost::asio::io_service running in its own thread.
+ *
+ * Timers are based on the monotonic clock (steady_timer) so they are not
+ * affected by wall clock changes. Short lived timeouts (such as the
+ * StreamReader and StreamWriter operation timeouts) should be armed on the
+ * timer_wheel() which batches them on a single kernel timer.
+ *
+ * The internal buffers of the streams using this service are taken from its
+ * buffer_pool(). Set the BufferPool::Parameters at creation to give the pool
+ * a preallocated (and possibly locked) arena.
+ *
+ * The event loop can be instrumented with enable_monitoring() to find which
+ * handlers (and which streams) stall the loop (see ServiceMonitor).
+ *
+ * With the IoUring backend, the connected stream sockets (UnixStream and
+ * TCPSessionStream) submit their reads and writes to an io_uring queue
+ * (uring()) instead of waiting for readiness notifications. The other streams
+ * (TCPClientStream, UDPClientStream, UnixDatagramStream, SerialStream) still
+ * use the reactor : the io_service runs the loop for both.
+ *
+ * In busy-poll mode (set_busy_poll) the service thread never sleeps : it
+ * polls the io_service (non-blocking epoll_wait) in a loop. This removes the
+ * wakeup latency of the thread at the cost of a full CPU core, ideally an
+ * isolated one the thread is pinned to.
+ */
 class AsyncService
 {
     public:
@@ -45,12 +89,21 @@ class AsyncService
     using Ptr      = std::shared_ptr<AsyncService>;
     using ConstPtr = std::shared_ptr<const AsyncService>;
 
-    using Timer     = boost::asio::deadline_timer;
-    using Millis    = boost::posix_time::milliseconds;
+    using Timer     = boost::asio::steady_timer;
+    using Millis    = std::chrono::milliseconds;
     using ErrorCode = boost::system::error_code;
 
+    enum Backend {
+        Reactor, // boost::asio default (epoll on Linux)
+        IoUring, // Linux io_uring, throws at creation if unavailable
+    };
+
     protected:
-    
+
+    // Declared first to be destroyed last : pending handlers and timers may
+    // still hold buffers from the pool.
+    BufferPool::Ptr               bufferPool_;
+
     boost::asio::io_service       service_;
     std::unique_ptr<std::thread>  thread_;
     bool                          isRunning_;
@@ -60,13 +113,37 @@ class AsyncService
     bool                          waiterWasNotified_;
 
     mutable Timer timer_; // this timer keeps the service busy (would stop otherwise)
+
+    std::unique_ptr<TimerWheel> timerWheel_;
+    std::unique_ptr<UringQueue> uring_;
+
+    std::atomic<bool>       busyPoll_;
+    int                     cpu_; // core the service thread is pinned to (-1 : none)
+
+    unsigned int            maxInlineDepth_; // see dispatch
+
+    ServiceMonitor          monitor_;
+    std::atomic<bool>       monitoring_;
+    Timer                   probe_;        // loop lag probe
+    Millis                  probePeriod_;
+    Timer::time_point       probeExpected_;
+
     void timer_callback(const ErrorCode& err) const;
+    void pin_thread() const;
+    void arm_probe();
+    void probe_callback(const ErrorCode& err);
 
-    AsyncService();
+    AsyncService(const BufferPool::Parameters& poolParams, Backend backend);
 
     public:
 
-    static Ptr Create() { return Ptr(new AsyncService()); }
+    static Ptr Create(const BufferPool::Parameters& poolParams = BufferPool::Parameters(),
+                      Backend backend = Reactor) {
+        return Ptr(new AsyncService(poolParams, backend));
+    }
+    static Ptr Create(Backend backend) {
+        return Create(BufferPool::Parameters(), backend);
+    }
 
     ~AsyncService();
 
@@ -80,7 +157,48 @@ class AsyncService
     void start();
     void stop();
     
-    void post(const std::function<void()>& function);
+    void post(const std::function<void()>& function,
+              const PostTag& tag = PostTag());
+
+    /**
+     * Calls function right away when called from the service thread, posts
+     * it otherwise. This saves a round trip in the handler queue for the
+     * completion handlers which can run from the handler completing them.
+     *
+     * Nested inline calls (a handler dispatching a handler dispatching...)
+     * are limited to max_inline_depth() on a thread. Deeper handlers are
+     * posted so that a chain of synchronous completions cannot overflow the
+     * stack.
+     */
+    void dispatch(const std::function<void()>& function,
+                  const PostTag& tag = PostTag());
+    void set_max_inline_depth(unsigned int depth) { maxInlineDepth_ = depth; }
+    unsigned int max_inline_depth() const { return maxInlineDepth_; }
+
+    /**
+     * Enables or disables the busy-poll mode. If cpu is not negative the
+     * service thread is pinned to this core. A service started with start()
+     * is restarted to apply the change (must not be called from the service
+     * thread). Otherwise it applies to the next call to run().
+     */
+    void set_busy_poll(bool enable, int cpu = -1);
+    bool busy_polling() const { return busyPoll_; }
+
+    /**
+     * Starts timing the posted handlers and probing the loop lag every
+     * probeMillis milliseconds. The topN slowest handlers are kept.
+     */
+    void enable_monitoring(unsigned int topN = 16, unsigned int probeMillis = 100);
+    void disable_monitoring();
+    bool monitoring_enabled() const { return monitoring_; }
+    ServiceMonitor::Snapshot monitoring() const { return monitor_.snapshot(); }
+    ServiceMonitor& monitor() { return monitor_; }
+
+    TimerWheel& timer_wheel() { return *timerWheel_; }
+    // nullptr with the Reactor backend.
+    UringQueue* uring() { return uring_.get(); }
+    Backend backend() const { return uring_ ? IoUring : Reactor; }
+    BufferPool& buffer_pool() { return *bufferPool_; }
 };
 
 } //namespace asio
@@ -0,0 +1,190 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_BRIDGE_H_
+#define _DEF_RTAC_ASIO_BRIDGE_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Forwards the bytes received on a StreamInterface to another one, in both
+ * directions (for example a serial port to a TCP session).
+ *
+ * When both streams expose a descriptor (StreamInterface::native_fd) the
+ * bytes are moved with splice() through a pipe : they never go through
+ * user memory and each chunk costs two syscalls in the service thread,
+ * woken up by the readiness of the descriptors. Otherwise, or if the kernel
+ * cannot splice from one of the devices (EINVAL, some ttys), the direction
+ * falls back to reading into a buffer and writing it on the other stream.
+ *
+ * Backpressure : a direction reads its source only once the previous chunk
+ * was fully written on the destination, so a slow destination stops the
+ * reads instead of growing a buffer. At most Parameters::chunkSize bytes
+ * are in flight per direction (plus the socket buffers).
+ *
+ * Half-close : the end of stream on one side (peer shutdown) is forwarded
+ * by shutting down the writing side of the other socket once the pending
+ * bytes are written, the other direction keeps working. The bridge is
+ * closed once both directions ended, or on the first error. Streams without
+ * a socket descriptor cannot forward a half-close.
+ *
+ * The streams belong to the bridge while it runs and must not be read or
+ * written by anyone else.
+ */
+class Bridge : public std::enable_shared_from_this<Bridge>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<Bridge>;
+    using ConstPtr = std::shared_ptr<const Bridge>;
+
+    using ErrorCode      = StreamInterface::ErrorCode;
+    // Called once when the bridge closes, with no error if both directions
+    // reached the end of stream.
+    using ClosedCallback = std::function<void(const ErrorCode&)>;
+
+    enum Mode {
+        Splice,
+        Buffered,
+    };
+
+    struct Parameters
+    {
+        std::size_t chunkSize; // pipe or buffer size of each direction
+        bool        zeroCopy;  // splice when both streams have a descriptor
+
+        Parameters(std::size_t chunkSize = 65536, bool zeroCopy = true) :
+            chunkSize(chunkSize),
+            zeroCopy(zeroCopy)
+        {}
+    };
+
+    struct Stats
+    {
+        struct Direction {
+            Mode     mode      = Buffered;
+            uint64_t bytes     = 0; // forwarded to the destination
+            uint64_t transfers = 0; // writes on the destination
+            bool     ended     = false;
+        };
+        Direction forward;  // first stream to second stream
+        Direction backward; // second stream to first stream
+    };
+
+    protected:
+
+    using Descriptor = boost::asio::posix::stream_descriptor;
+
+    struct Direction {
+        StreamInterface::Ptr src;
+        StreamInterface::Ptr dst;
+
+        // splice mode. The descriptors are duplicates of the stream ones,
+        // used to wait for their readiness.
+        std::unique_ptr<Descriptor> srcWait;
+        std::unique_ptr<Descriptor> dstWait;
+        int                         pipe[2];
+        std::size_t                 inPipe; // bytes read, not written yet
+        bool                        dstSocket;
+
+        // buffered mode
+        std::vector<uint8_t> buffer;
+        std::size_t          pending; // bytes read, written up to written
+        std::size_t          written;
+
+        bool             eof;
+        Stats::Direction stats;
+
+        Direction(StreamInterface::Ptr src, StreamInterface::Ptr dst);
+        ~Direction();
+    };
+
+    AsyncService::Ptr service_; // of the first stream
+    Parameters        parameters_;
+    Direction         forward_;
+    Direction         backward_;
+    bool              started_;
+    bool              closed_;
+    ClosedCallback    closedCallback_;
+    mutable std::mutex mutex_;
+
+    Bridge(StreamInterface::Ptr first, StreamInterface::Ptr second,
+           const Parameters& params);
+
+    bool setup_splice(Direction& d);
+    void start_direction(Direction& d);
+    void record(Direction& d, std::size_t count);
+    bool is_closed() const;
+
+    void splice_pump(Direction* d);
+    void splice_ready(Direction* d, const ErrorCode& err);
+
+    void buffered_read(Direction* d);
+    void buffered_read_done(Direction* d, const ErrorCode& err, std::size_t count);
+    void buffered_write(Direction* d);
+    void buffered_write_done(Direction* d, const ErrorCode& err, std::size_t count);
+
+    void direction_ended(Direction* d);
+    void close(const ErrorCode& err);
+    void close_descriptors(const ErrorCode& err, ClosedCallback callback);
+
+    public:
+
+    ~Bridge();
+
+    static Ptr Create(StreamInterface::Ptr first, StreamInterface::Ptr second,
+                      const Parameters& params = Parameters());
+
+    const Parameters& parameters() const { return parameters_; }
+    AsyncService::Ptr service()    const { return service_; }
+
+    // Must be set before start.
+    void set_closed_callback(const ClosedCallback& callback);
+
+    void start();
+    // Stops forwarding (the closed callback gets operation_aborted).
+    void stop();
+    bool is_open() const { return !this->is_closed(); }
+
+    Stats stats() const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_BRIDGE_H_
@@ -0,0 +1,187 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_BROADCAST_GROUP_H_
+#define _DEF_RTAC_ASIO_BROADCAST_GROUP_H_
+
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <functional>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/Stream.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Writes the same frame to a group of Streams (for example the TCP clients
+ * of a telemetry server).
+ *
+ * A frame is an immutable ref-counted Buffer : it is written from the same
+ * memory on every member and released when the last member is done with
+ * it, so the caller does not copy it per member nor keep it alive. A
+ * single callback is called once the frame was handled by every member,
+ * with the count of members which received it.
+ *
+ * Each member writes one frame at a time and queues up to
+ * Parameters::maxQueued frames behind it. When a frame finds the queue of
+ * a member full (the client does not read fast enough), the policy decides
+ * what happens to this member, the other members are never delayed :
+ * - Drop       : the new frame is skipped for this member.
+ * - DropOldest : the oldest frame not yet started is skipped instead (the
+ *                member keeps receiving the most recent frames).
+ * - Disconnect : the member is removed from the group and its stream is
+ *                closed (Stream::close, the client streams are not
+ *                reconnected).
+ * With maxQueued = 0, the policy applies as soon as a member is busy.
+ *
+ * Frames are written whole : a member whose write fails or times out
+ * (Parameters::timeoutMillis) is removed from the group since its peer
+ * may have received a partial frame.
+ */
+class BroadcastGroup : public std::enable_shared_from_this<BroadcastGroup>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<BroadcastGroup>;
+    using ConstPtr = std::shared_ptr<const BroadcastGroup>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+    using Buffer    = std::shared_ptr<const std::vector<uint8_t>>;
+
+    enum SlowPolicy {
+        Drop,
+        DropOldest,
+        Disconnect,
+    };
+
+    struct Parameters
+    {
+        SlowPolicy   policy;
+        std::size_t  maxQueued;     // frames waiting per member
+        unsigned int timeoutMillis; // of each member write (0 : none)
+
+        Parameters(SlowPolicy policy = Drop,
+                   std::size_t maxQueued = 16,
+                   unsigned int timeoutMillis = 0) :
+            policy(policy),
+            maxQueued(maxQueued),
+            timeoutMillis(timeoutMillis)
+        {}
+    };
+
+    // Outcome of a frame for all the members of the group.
+    struct Result
+    {
+        std::size_t delivered = 0; // members which wrote the whole frame
+        std::size_t dropped   = 0; // members which skipped it (slow or removed)
+        std::size_t failed    = 0; // members whose write failed (removed)
+    };
+    using Callback        = std::function<void(const Result&)>;
+    using RemovedCallback = std::function<void(Stream::Ptr, const ErrorCode&)>;
+
+    struct Stats
+    {
+        uint64_t frames       = 0;
+        uint64_t delivered    = 0; // member writes
+        uint64_t dropped      = 0;
+        uint64_t failed       = 0;
+        uint64_t disconnected = 0; // members removed by the Disconnect policy
+    };
+
+    protected:
+
+    struct Frame {
+        Buffer      buffer;
+        Callback    callback;
+        std::size_t remaining; // members which did not handle it yet
+        Result      result;
+    };
+    using FramePtr = std::shared_ptr<Frame>;
+
+    struct Member {
+        Stream::Ptr          stream;
+        std::deque<FramePtr> queue; // the front is being written if writing
+        bool                 writing = false;
+        bool                 removed = false;
+    };
+    using MemberPtr = std::shared_ptr<Member>;
+
+    AsyncService::Ptr      service_;
+    Parameters             parameters_;
+    std::vector<MemberPtr> members_;
+    RemovedCallback        removedCallback_;
+    Stats                  stats_;
+    mutable std::mutex     mutex_;
+
+    BroadcastGroup(AsyncService::Ptr service, const Parameters& params);
+
+    void frame_done(const FramePtr& frame);
+    void drop(const FramePtr& frame);
+    void start_write(const MemberPtr& member);
+    void write_done(MemberPtr member, FramePtr written,
+                    const ErrorCode& err, std::size_t count);
+    bool remove_member(const MemberPtr& member);
+    void disconnect(const MemberPtr& member, const ErrorCode& err, bool close);
+
+    public:
+
+    // The frame callbacks are posted on service.
+    static Ptr Create(AsyncService::Ptr service,
+                      const Parameters& params = Parameters());
+
+    static Buffer make_buffer(const uint8_t* data, std::size_t size);
+    static Buffer make_buffer(std::vector<uint8_t>&& data);
+
+    AsyncService::Ptr service()    const { return service_; }
+    const Parameters& parameters() const { return parameters_; }
+
+    bool add(Stream::Ptr stream);
+    // The frames already queued for this member are dropped.
+    bool remove(Stream::Ptr stream);
+    std::size_t size() const;
+
+    // Called when the group removes a member (slow member or write error).
+    void set_removed_callback(const RemovedCallback& callback);
+
+    /**
+     * Submits the frame to all the members. Returns the number of members
+     * which started or queued it. The callback (optional) is called once
+     * every member wrote, skipped or failed the frame.
+     */
+    std::size_t broadcast(Buffer buffer, Callback callback = nullptr);
+
+    Stats stats() const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_BROADCAST_GROUP_H_
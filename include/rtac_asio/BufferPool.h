@@ -0,0 +1,230 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_BUFFER_POOL_H_
+#define _DEF_RTAC_ASIO_BUFFER_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <boost/asio/streambuf.hpp>
+
+namespace rtac { namespace asio {
+
+/**
+ * Pool of I/O buffers recycled by size class.
+ *
+ * Blocks are power of two sizes between Parameters::minBlockSize and
+ * Parameters::maxBlockSize. They are carved from an arena of
+ * Parameters::arenaSize bytes reserved (and touched) when the pool is
+ * created, then from the heap once the arena is used up. A released block is
+ * never given back to the system : it goes to a free list of its size class
+ * and is reused by the next allocation of the same class. After warm-up, the
+ * memory used by the pool does not change and no allocation reaches the
+ * system allocator. Requests larger than maxBlockSize are not pooled.
+ *
+ * Each thread keeps up to Parameters::threadCacheSize free blocks per size
+ * class, so that allocations and releases from the io_service thread take no
+ * lock most of the time.
+ *
+ * For real-time use, the arena can be backed by huge pages and locked in RAM
+ * (mlock). Both are best effort : a warning is printed if the system refuses
+ * and the pool falls back to regular pages.
+ *
+ * An AsyncService owns a pool (AsyncService::buffer_pool) used by the
+ * internal buffers of the streams running on it.
+ */
+class BufferPool
+{
+    public:
+
+    using Ptr      = std::shared_ptr<BufferPool>;
+    using ConstPtr = std::shared_ptr<const BufferPool>;
+
+    static constexpr unsigned int MaxClasses = 32;
+
+    struct Parameters
+    {
+        std::size_t  minBlockSize;
+        std::size_t  maxBlockSize;
+        std::size_t  arenaSize;       // 0 : all blocks are taken from the heap
+        unsigned int threadCacheSize; // 0 disables thread caches
+        bool         hugePages;
+        bool         lockMemory;
+
+        Parameters(std::size_t  minBlockSize    = 64,
+                   std::size_t  maxBlockSize    = 1024*1024,
+                   std::size_t  arenaSize       = 0,
+                   unsigned int threadCacheSize = 8,
+                   bool         hugePages       = false,
+                   bool         lockMemory      = false) :
+            minBlockSize(minBlockSize),
+            maxBlockSize(maxBlockSize),
+            arenaSize(arenaSize),
+            threadCacheSize(threadCacheSize),
+            hugePages(hugePages),
+            lockMemory(lockMemory)
+        {}
+
+        static Parameters RealTime(std::size_t arenaSize) {
+            return Parameters(64, 1024*1024, arenaSize, 8, true, true);
+        }
+    };
+
+    struct Stats
+    {
+        std::size_t arenaSize;     // reserved at creation
+        std::size_t arenaUsed;     // carved into blocks
+        std::size_t heapBytes;     // blocks taken from the heap
+        std::size_t inUse;         // blocks currently allocated
+        std::size_t unpooled;      // allocations larger than maxBlockSize
+        bool        hugePages;     // arena is backed by huge pages
+        bool        locked;        // arena is locked in RAM
+    };
+
+    /**
+     * Standard allocator drawing from a BufferPool, so the standard
+     * containers (and boost::asio::basic_streambuf) can use the pool. A
+     * default constructed allocator uses the heap.
+     */
+    template <typename T>
+    class Allocator
+    {
+        public:
+
+        using value_type = T;
+
+        template <typename U> struct rebind { using other = Allocator<U>; };
+
+        protected:
+
+        BufferPool* pool_;
+
+        public:
+
+        Allocator(BufferPool* pool = nullptr) : pool_(pool) {}
+        template <typename U>
+        Allocator(const Allocator<U>& other) : pool_(other.pool()) {}
+
+        BufferPool* pool() const { return pool_; }
+
+        T* allocate(std::size_t n) {
+            if(!pool_) {
+                return std::allocator<T>().allocate(n);
+            }
+            return (T*)pool_->allocate(n*sizeof(T));
+        }
+        void deallocate(T* p, std::size_t n) {
+            if(!pool_) {
+                std::allocator<T>().deallocate(p, n);
+                return;
+            }
+            pool_->deallocate(p, n*sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const Allocator<U>& other) const { return pool_ == other.pool(); }
+        template <typename U>
+        bool operator!=(const Allocator<U>& other) const { return pool_ != other.pool(); }
+    };
+
+    using Bytes        = std::vector<uint8_t, Allocator<uint8_t>>;
+    using StreamBuffer = boost::asio::basic_streambuf<Allocator<char>>;
+
+    protected:
+
+    Parameters  parameters_;
+    uint64_t    id_; // identifies this pool in the thread caches
+    unsigned int minShift_;
+    unsigned int classCount_;
+
+    uint8_t*    arena_;
+    std::size_t arenaSize_;
+    std::size_t arenaUsed_;
+    bool        mapped_;
+    bool        hugePages_;
+    bool        locked_;
+
+    std::array<std::vector<void*>, MaxClasses> free_;
+    std::vector<void*>       heapBlocks_; // released in the destructor
+    std::size_t              heapBytes_;
+    std::atomic<std::size_t> inUse_;
+    std::atomic<std::size_t> unpooled_;
+    mutable std::mutex       mutex_;
+
+    BufferPool(const Parameters& params);
+
+    void map_arena();
+    void* new_block(unsigned int sizeClass);
+
+    public:
+
+    ~BufferPool();
+
+    static Ptr Create(const Parameters& params = Parameters());
+
+    const Parameters& parameters() const { return parameters_; }
+    uint64_t id() const { return id_; }
+    // Preallocated arena (nullptr if Parameters::arenaSize was 0).
+    uint8_t*    arena()      const { return arena_; }
+    std::size_t arena_size() const { return arenaSize_; }
+
+    /**
+     * Returns a block of at least size bytes. Its actual capacity is
+     * capacity(size). deallocate must be called with the same size.
+     */
+    void* allocate(std::size_t size);
+    void  deallocate(void* block, std::size_t size);
+
+    std::size_t capacity(std::size_t size) const;
+    int size_class(std::size_t size) const; // -1 if not pooled
+
+    // used by the thread caches
+    void  push_free(unsigned int sizeClass, void** blocks, std::size_t count);
+    std::size_t pop_free(unsigned int sizeClass, void** blocks, std::size_t count);
+
+    /**
+     * Allocates count blocks of blockSize bytes and releases them right away
+     * so that later allocations of this size are served from the free lists.
+     */
+    void reserve(std::size_t blockSize, std::size_t count);
+
+    Stats stats() const;
+
+    template <typename T>
+    Allocator<T> allocator() { return Allocator<T>(this); }
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_BUFFER_POOL_H_
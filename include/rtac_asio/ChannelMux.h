@@ -0,0 +1,265 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_CHANNEL_MUX_H_
+#define _DEF_RTAC_ASIO_CHANNEL_MUX_H_
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/Stream.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Multiplexes logical channels over a single transport Stream.
+ *
+ * Each channel is a StreamInterface : wrap it in a Stream to get the usual
+ * reader and writer (timeouts, read_until...) on the channel. Both ends of
+ * the link must run a ChannelMux with the same Parameters and open the
+ * channels they use with the same ids.
+ *
+ * Wire format : each frame is a 4 bytes header (channel id, frame type,
+ * payload length on 16 bits little endian) followed by the payload. Data
+ * frames carry the channel bytes, Credit frames give back receive window
+ * (32 bits little endian payload).
+ *
+ * Flow control : a channel may only send as many bytes as the peer has room
+ * for in its receive buffer for this channel (Parameters::window). The
+ * window is given back as the channel reader consumes the data, so a
+ * channel whose reader is slow stops sending instead of filling the receive
+ * side or blocking the other channels.
+ *
+ * Scheduling : the transport writer sends one frame at a time. Credit
+ * frames go first, then the pending write of the channel with the lowest
+ * priority value (0 is the most urgent), round-robin between channels of
+ * the same priority. Writes are cut in frames of at most
+ * Parameters::maxPayload bytes, which bounds the time an urgent message
+ * waits behind bulk traffic.
+ *
+ * The transport reader and writer belong to the mux once start() was called
+ * and must not be used directly. stop() (or releasing the mux) cancels the
+ * transport operations and ends the pending channel operations with
+ * operation_aborted.
+ */
+class ChannelMux : public std::enable_shared_from_this<ChannelMux>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<ChannelMux>;
+    using ConstPtr = std::shared_ptr<const ChannelMux>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+    using Callback  = StreamInterface::Callback;
+
+    enum FrameType : uint8_t {
+        Data   = 0,
+        Credit = 1,
+    };
+    static constexpr std::size_t HeaderSize = 4;
+
+    struct Parameters
+    {
+        std::size_t window;     // receive buffer of each channel (bytes)
+        std::size_t maxPayload; // largest data frame payload (at most 65535)
+        std::size_t readChunk;  // size of the reads on the transport
+
+        Parameters(std::size_t window     = 65536,
+                   std::size_t maxPayload = 1024,
+                   std::size_t readChunk  = 16384) :
+            window(window),
+            maxPayload(maxPayload),
+            readChunk(readChunk)
+        {}
+    };
+
+    struct Stats
+    {
+        uint64_t framesIn  = 0;
+        uint64_t framesOut = 0;
+        uint64_t bytesIn   = 0; // channel payload bytes
+        uint64_t bytesOut  = 0;
+        uint64_t dropped   = 0; // payload bytes for a channel not opened
+        uint64_t overruns  = 0; // payload bytes beyond the window (dropped)
+    };
+
+    class Channel : public StreamInterface
+    {
+        public:
+
+        friend class ChannelMux;
+
+        using Ptr      = std::shared_ptr<Channel>;
+        using ConstPtr = std::shared_ptr<const Channel>;
+
+        protected:
+
+        struct Operation {
+            std::size_t    size;
+            uint8_t*       buffer; // read destination
+            const uint8_t* data;   // write source
+            Callback       callback;
+        };
+
+        std::weak_ptr<ChannelMux> mux_; // expired once the mux is destroyed
+
+        // The other fields are protected by the mutex of the mux.
+        uint8_t      id_;
+        unsigned int priority_;
+
+        std::vector<uint8_t>      rxData_; // received, not read yet
+        std::size_t               rxHead_;
+        std::size_t               consumed_; // read since the last Credit frame
+        std::unique_ptr<Operation> pendingRead_;
+
+        std::size_t                txCredit_; // bytes the peer can receive
+        std::unique_ptr<Operation> pendingWrite_;
+        std::size_t                inFlight_; // bytes of pendingWrite_ being sent
+
+        Channel(const std::shared_ptr<ChannelMux>& mux, uint8_t id,
+                unsigned int priority);
+
+        std::size_t rx_size() const { return rxData_.size() - rxHead_; }
+        bool        can_send() const {
+            return pendingWrite_ && inFlight_ == 0 && txCredit_ > 0;
+        }
+
+        public:
+
+        uint8_t      id()       const { return id_; }
+        unsigned int priority() const { return priority_; }
+
+        void async_read_some(std::size_t bufferSize,
+                             uint8_t*    buffer,
+                             Callback    callback);
+        void async_write_some(std::size_t    count,
+                              const uint8_t* data,
+                              Callback       callback);
+        void flush();
+        void reset();
+        bool is_open() const;
+        bool cancel();
+    };
+
+    protected:
+
+    struct Level {
+        std::vector<Channel::Ptr> channels;
+        std::size_t               next; // round-robin position
+    };
+
+    Stream::Ptr transport_;
+    Parameters  parameters_;
+
+    std::map<uint8_t, Channel::Ptr>  channels_;
+    std::map<unsigned int, Level>    levels_; // by priority
+    mutable std::mutex               mutex_;
+    std::atomic<bool>                stopped_;
+
+    // Buffers of the transport operations are shared with their handlers,
+    // which only hold a weak reference on the mux.
+    using Buffer = std::shared_ptr<std::vector<uint8_t>>;
+
+    // receive side
+    Buffer               rxChunk_;
+    uint8_t              rxHeader_[HeaderSize];
+    std::size_t          headerFill_;
+    std::size_t          remaining_; // payload bytes left in the current frame
+    uint8_t              creditBytes_[4];
+    std::size_t          creditFill_;
+    bool                 reading_;
+
+    // transmit side
+    std::map<uint8_t, std::size_t> creditsToSend_;
+    std::map<uint8_t, std::size_t> txCredits_; // credits in txFrame_
+    Buffer                         txFrame_;
+    Channel::Ptr                   txChannel_; // channel of the data frame in txFrame_
+    bool                           writing_;
+
+    Stats stats_;
+
+    ChannelMux(Stream::Ptr transport, const Parameters& params);
+
+    void read_transport();
+    void transport_read_continue(const ErrorCode& err, std::size_t count);
+    void parse(const uint8_t* data, std::size_t count);
+    void deliver(const uint8_t* data, std::size_t count);
+    void credit_received(uint32_t credit);
+    void serve_read(Channel& channel);
+
+    void send_next(std::unique_lock<std::mutex>& lock);
+    Channel* next_sender();
+    void append_header(uint8_t id, FrameType type, std::size_t length);
+    void transport_write_continue(const ErrorCode& err, std::size_t count);
+    void fail_operations(const ErrorCode& err, bool reads, bool writes);
+
+    void give_back(Channel& channel, std::size_t count);
+    void channel_read(Channel& channel, std::size_t bufferSize,
+                      uint8_t* buffer, Callback callback);
+    void channel_write(Channel& channel, std::size_t count,
+                       const uint8_t* data, Callback callback);
+    void channel_flush(Channel& channel);
+    bool channel_cancel(Channel& channel);
+
+    public:
+
+    ~ChannelMux();
+
+    static Ptr Create(Stream::Ptr transport,
+                      const Parameters& params = Parameters());
+
+    Stream::Ptr       transport()  const { return transport_; }
+    const Parameters& parameters() const { return parameters_; }
+    AsyncService::Ptr service()    const { return transport_->service(); }
+
+    /**
+     * Opens the channel id (returns the existing one if already open).
+     * Channels with a lower priority value are sent first.
+     */
+    Channel::Ptr open_channel(uint8_t id, unsigned int priority = 0);
+    Channel::Ptr channel(uint8_t id) const;
+
+    // Starts reading the transport.
+    void start();
+    // Cancels the transport operations and closes the channels. The mux
+    // cannot be restarted.
+    void stop();
+
+    Stats stats() const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_CHANNEL_MUX_H_
@@ -0,0 +1,127 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_READ_BLOCK_POOL_H_
+#define _DEF_RTAC_ASIO_READ_BLOCK_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace rtac { namespace asio {
+
+class ReadBlockPool;
+
+/**
+ * Read-only view on a block of a ReadBlockPool lent to the user by
+ * StreamReader::async_read_borrowed.
+ *
+ * The view is valid until release() is called on it (and on all its copies)
+ * or until it is destroyed. The block then goes back to the pool to be
+ * reused by a later read.
+ */
+class BorrowedBuffer
+{
+    public:
+
+    struct Lease {
+        std::shared_ptr<ReadBlockPool> pool;
+        std::size_t                    index;
+        ~Lease();
+    };
+
+    protected:
+
+    std::shared_ptr<Lease> lease_;
+    const uint8_t*         data_;
+    std::size_t            size_;
+
+    public:
+
+    BorrowedBuffer() : data_(nullptr), size_(0) {}
+    BorrowedBuffer(std::shared_ptr<Lease> lease, const uint8_t* data, std::size_t size) :
+        lease_(lease), data_(data), size_(size)
+    {}
+
+    const uint8_t* data() const { return data_; }
+    std::size_t    size() const { return size_; }
+    bool           empty() const { return size_ == 0; }
+
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end()   const { return data_ + size_; }
+
+    void release() {
+        lease_ = nullptr;
+        data_  = nullptr;
+        size_  = 0;
+    }
+};
+
+/**
+ * Fixed pool of equally sized blocks in a single allocation. The blocks are
+ * lent to the user through BorrowedBuffer and recycled on release.
+ */
+class ReadBlockPool : public std::enable_shared_from_this<ReadBlockPool>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<ReadBlockPool>;
+    using ConstPtr = std::shared_ptr<const ReadBlockPool>;
+
+    protected:
+
+    std::size_t              blockSize_;
+    std::vector<uint8_t>     storage_;
+    std::vector<std::size_t> free_;
+    mutable std::mutex       mutex_;
+
+    ReadBlockPool(std::size_t blockCount, std::size_t blockSize);
+
+    public:
+
+    static Ptr Create(std::size_t blockCount = 8, std::size_t blockSize = 65536);
+
+    /**
+     * Takes a block from the pool. Returns nullptr if all blocks are lent.
+     * The block goes back to the pool when the Lease is destroyed.
+     */
+    std::shared_ptr<BorrowedBuffer::Lease> acquire();
+    void release(std::size_t index);
+
+    uint8_t* block(std::size_t index) { return storage_.data() + index*blockSize_; }
+
+    std::size_t block_size()  const { return blockSize_; }
+    std::size_t block_count() const { return storage_.size() / blockSize_; }
+    std::size_t available()   const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_READ_BLOCK_POOL_H_
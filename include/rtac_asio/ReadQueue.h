@@ -0,0 +1,132 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_READ_QUEUE_H_
+#define _DEF_RTAC_ASIO_READ_QUEUE_H_
+
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <fstream>
+
+#include <boost/asio/streambuf.hpp>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/TimerWheel.h>
+#include <rtac_asio/StreamStats.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Queued read mode of the StreamReader (see
+ * StreamReader::enable_queued_reads).
+ *
+ * A single internal read loop reads from the stream into a ring buffer as
+ * long as the ring is not full, whether user reads are queued or not. User
+ * reads are queued (up to maxQueued of them) and served in order from the
+ * ring. This keeps the kernel socket buffer drained while the user handles
+ * completed reads, at the cost of one copy from the ring to the user buffer.
+ *
+ * Since the stream never writes in the user buffers, a queued read which
+ * reaches its timeout is simply removed from the queue.
+ */
+class ReadQueue : public std::enable_shared_from_this<ReadQueue>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<ReadQueue>;
+    using ConstPtr = std::shared_ptr<const ReadQueue>;
+
+    using ErrorCode  = StreamInterface::ErrorCode;
+    using Callback   = StreamInterface::Callback;
+    using ReadBuffer = BufferPool::StreamBuffer;
+
+    protected:
+
+    struct Request {
+        unsigned int       id;
+        std::size_t        size;
+        uint8_t*           data;
+        Callback           callback;
+        bool               exact; // async_read (true) or async_read_some
+        std::size_t        processed;
+        TimerWheel::Handle timeout;
+        OperationCounters::Clock::time_point start;
+    };
+
+    StreamInterface::Ptr stream_;
+    std::size_t          maxQueued_;
+    std::deque<Request>  requests_;
+    unsigned int         requestCounter_;
+
+    BufferPool::Bytes    ring_;
+    std::size_t          ringHead_;  // first byte to be delivered
+    std::size_t          ringCount_; // number of bytes in the ring
+    bool                 reading_;   // a read is pending on the stream
+    bool                 stopped_;
+    ErrorCode            error_;     // delivered once the ring is empty
+
+    std::ofstream*         rxDump_;
+    OperationCounters::Ptr counters_; // counters of the owning StreamReader
+    mutable std::mutex     mutex_;
+
+    ReadQueue(StreamInterface::Ptr stream, std::size_t maxQueued,
+              std::size_t ringSize, std::ofstream* rxDump,
+              OperationCounters::Ptr counters);
+
+    std::function<void()> completion(const Request& request, const ErrorCode& err);
+
+    void serve();
+    void complete_front(const ErrorCode& err);
+    void start_read();
+    void read_continue(const ErrorCode& err, std::size_t readCount);
+    void timeout_reached(unsigned int id);
+
+    public:
+
+    static Ptr Create(StreamInterface::Ptr stream, std::size_t maxQueued,
+                      std::size_t ringSize, std::ofstream* rxDump = nullptr,
+                      OperationCounters::Ptr counters = nullptr);
+
+    bool async_read(std::size_t count, uint8_t* data, Callback callback,
+                    bool exact, unsigned int timeoutMillis = 0);
+
+    void push_front(ReadBuffer& buffer);
+    void stop(ReadBuffer& leftover);
+    void flush();
+
+    std::size_t queued()    const;
+    std::size_t available() const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_READ_QUEUE_H_
@@ -58,6 +58,28 @@ class SerialStream : public StreamInterface
         FlushBoth    = TCIOFLUSH
     };
 
+    /**
+     * Serial port configuration.
+     *
+     * Non-standard baudrates are supported on Linux (set through termios2 /
+     * BOTHER).
+     *
+     * The low latency settings are opt-in (see Parameters::LowLatency) :
+     * - lowLatency sets ASYNC_LOW_LATENCY on the driver (on FTDI adapters,
+     *   this reduces the latency timer from 16ms to 1ms).
+     * - rawMode puts the tty in raw mode (no line discipline processing)
+     *   with the given VMIN / VTIME settings. The character size, parity
+     *   and flow control settings are kept.
+     *
+     * frameGapMicros is the line silence delimiting two frames when reading
+     * with StreamReader::async_read_frame. When 0, it is computed from the
+     * line settings as 3.5 character times (Modbus RTU), or fixed to 1750us
+     * above 19200 bauds as recommended by the Modbus specification.
+     *
+     * Failing to apply the low latency settings (for example on a pseudo
+     * terminal which does not support TIOCSSERIAL) is reported as a warning
+     * and does not prevent the port from being opened.
+     */
     struct Parameters
     {
         SerialPort::baud_rate      baudrate;
@@ -66,13 +88,36 @@ class SerialStream : public StreamInterface
         SerialPort::flow_control   flowControl;
         SerialPort::stop_bits      stopBits;
 
+        bool    lowLatency;
+        bool    rawMode;
+        uint8_t vmin;  // minimum number of characters for a read (raw mode)
+        uint8_t vtime; // inter-character timeout in 0.1s (raw mode)
+
+        unsigned int frameGapMicros; // 0 : computed from the line settings
+
         Parameters(unsigned int bauds = 115200) :
             baudrate(bauds),
             characterSize(8),
             parity(SerialPort::parity::none),
             flowControl(SerialPort::flow_control::none),
-            stopBits(SerialPort::stop_bits::one)
+            stopBits(SerialPort::stop_bits::one),
+            lowLatency(false),
+            rawMode(false),
+            vmin(1),
+            vtime(0),
+            frameGapMicros(0)
         {}
+
+        static Parameters LowLatency(unsigned int bauds = 115200,
+                                     uint8_t vmin = 1, uint8_t vtime = 0)
+        {
+            Parameters params(bauds);
+            params.lowLatency = true;
+            params.rawMode    = true;
+            params.vmin       = vmin;
+            params.vtime      = vtime;
+            return params;
+        }
     };
 
     protected:
@@ -86,6 +131,8 @@ class SerialStream : public StreamInterface
                  const std::string& device,
                  const Parameters& params);
 
+    void apply_low_latency_settings();
+
     public:
 
     ~SerialStream();
@@ -103,10 +150,18 @@ class SerialStream : public StreamInterface
     ErrorCode flush(FlushType flushType);
     void flush() { this->flush(FlushBoth); }
     bool is_open() const;
+    bool cancel();
+    int native_handle();
+    int native_fd() const;
+
+    unsigned int frame_gap_micros() const;
 
     void async_read_some(std::size_t bufferSize,
                          uint8_t*    buffer,
                          Callback    callback);
+    std::size_t try_read_some(std::size_t bufferSize,
+                              uint8_t*    buffer,
+                              ErrorCode&  err);
     void async_write_some(std::size_t    count,
                           const uint8_t* data,
                           Callback       callback);
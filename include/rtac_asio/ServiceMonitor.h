@@ -0,0 +1,189 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_SERVICE_MONITOR_H_
+#define _DEF_RTAC_ASIO_SERVICE_MONITOR_H_
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <iosfwd>
+#include <cstring>
+
+#include <rtac_asio/StreamStats.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Identifies the origin of a handler posted on an AsyncService, for the
+ * ServiceMonitor reports. source is usually the StreamInterface the handler
+ * belongs to, operation a string literal ("read", "write"...).
+ */
+struct PostTag
+{
+    const void* source    = nullptr;
+    const char* operation = nullptr;
+
+    PostTag(const void* source = nullptr, const char* operation = nullptr) :
+        source(source), operation(operation)
+    {}
+};
+
+/**
+ * Instrumentation of the event loop of an AsyncService.
+ *
+ * When enabled (AsyncService::enable_monitoring), every handler posted with
+ * AsyncService::post is timed :
+ * - queue delay : time between the post and the start of the handler,
+ * - handler time : execution time of the handler.
+ * The execution time is also accumulated per (source, operation) tag, and
+ * the slowest individual handlers are kept for a top-N report. The number of
+ * posted handlers not yet executed (queue depth) is tracked as well.
+ *
+ * A probe timer fires periodically on the loop. Its lateness (loop lag)
+ * shows stalls caused by handlers which are not posted (socket completions,
+ * timers).
+ *
+ * All recording is done from the service thread. The reports can be read
+ * from any thread.
+ */
+class ServiceMonitor
+{
+    public:
+
+    using Clock    = std::chrono::steady_clock;
+    using Duration = Clock::duration;
+
+    struct SourceStats
+    {
+        const void* source;
+        std::string name;      // see AsyncService::name_source
+        std::string operation;
+        uint64_t    count;
+        uint64_t    totalNanos;
+        uint64_t    maxNanos;
+    };
+
+    struct SlowHandler
+    {
+        const void* source;
+        std::string name;
+        std::string operation;
+        uint64_t    nanos;
+        uint64_t    queuedNanos;
+        Clock::time_point start;
+    };
+
+    struct Snapshot
+    {
+        uint64_t    posted        = 0;
+        uint64_t    executed      = 0;
+        uint64_t    queueDepth    = 0;
+        uint64_t    maxQueueDepth = 0;
+        LatencyHistogram::Snapshot queueDelay;
+        LatencyHistogram::Snapshot handlerTime;
+        LatencyHistogram::Snapshot loopLag;
+        std::vector<SourceStats>   sources; // by decreasing total time
+        std::vector<SlowHandler>   slowest; // by decreasing execution time
+
+        std::string to_text() const;
+    };
+
+    protected:
+
+    struct Key {
+        const void* source;
+        const char* operation;
+        bool operator<(const Key& other) const {
+            if(source != other.source) return std::less<const void*>()(source, other.source);
+            // the same literal may have several addresses
+            if(!operation || !other.operation) return operation == nullptr && other.operation;
+            return std::strcmp(operation, other.operation) < 0;
+        }
+    };
+    struct Totals {
+        uint64_t count      = 0;
+        uint64_t totalNanos = 0;
+        uint64_t maxNanos   = 0;
+    };
+    struct Slow {
+        Key               key;
+        uint64_t          nanos;
+        uint64_t          queuedNanos;
+        Clock::time_point start;
+    };
+
+    std::atomic<uint64_t> posted_;
+    std::atomic<uint64_t> executed_;
+    std::atomic<uint64_t> maxQueueDepth_;
+    LatencyHistogram      queueDelay_;
+    LatencyHistogram      handlerTime_;
+    LatencyHistogram      loopLag_;
+
+    unsigned int                       topN_;
+    std::map<Key, Totals>              totals_;
+    std::vector<Slow>                  slowest_; // min-heap on nanos
+    std::map<const void*, std::string> names_;
+    mutable std::mutex                 mutex_;
+
+    void record(const PostTag& tag, Clock::time_point posted,
+                Clock::time_point start, Clock::time_point end);
+
+    public:
+
+    ServiceMonitor(unsigned int topN = 16);
+
+    void set_top_n(unsigned int topN);
+    void reset();
+
+    /**
+     * Returns a handler running function and recording its timings under
+     * tag. The monitor must outlive the returned handler.
+     */
+    std::function<void()> wrap(const std::function<void()>& function,
+                               const PostTag& tag);
+
+    void record_loop_lag(Duration lag) { loopLag_.record(lag); }
+
+    void name_source(const void* source, const std::string& name);
+    void forget_source(const void* source);
+
+    Snapshot snapshot() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const ServiceMonitor::Snapshot& snapshot);
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_SERVICE_MONITOR_H_
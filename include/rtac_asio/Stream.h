@@ -42,6 +42,8 @@
 #include <rtac_asio/SerialStream.h>
 #include <rtac_asio/UDPClientStream.h>
 #include <rtac_asio/TCPClientStream.h>
+#include <rtac_asio/UnixStream.h>
+#include <rtac_asio/UnixDatagramStream.h>
 
 namespace rtac { namespace asio {
 
@@ -69,8 +71,12 @@ class Stream
         const SerialStream::Parameters& params = SerialStream::Parameters());
     static Ptr CreateUDPClient(const std::string& remoteIP,
                                uint16_t remotePort);
-    static Ptr CreateTCPClient(const std::string& remoteIP,
-                               uint16_t remotePort);
+    static Ptr CreateTCPClient(const std::string& remoteHost,
+                               uint16_t remotePort,
+        const TCPClientStream::Parameters& params = TCPClientStream::Parameters());
+    static Ptr CreateUnix(const std::string& path);
+    static Ptr CreateUnixDatagram(const std::string& path,
+        UnixDatagramStream::Mode mode = UnixDatagramStream::SeqPacket);
     
     AsyncService::Ptr service() const { return reader_.stream()->service(); }
 
@@ -80,8 +86,19 @@ class Stream
 
     void flush();
     void reset();
+    void cancel();
+    void close();
     bool is_open() const { return reader_.stream()->is_open(); }
 
+    // Snapshot of the reader, writer and transport counters.
+    StreamStats stats() const;
+    // Name of this stream in the AsyncService monitoring reports.
+    void set_name(const std::string& name);
+    // Spin time of the synchronous reads and writes (see StreamReader::set_sync_spin).
+    void set_sync_spin(unsigned int micros);
+    // Inline completion of the callbacks (see StreamReader::set_inline_completion).
+    void set_inline_completion(bool enable);
+
     bool async_read_some(std::size_t count, uint8_t* data,
                          Callback callback, unsigned int timeoutMillis = 0);
     bool async_write_some(std::size_t count, const uint8_t* data,
@@ -94,6 +111,10 @@ class Stream
 
     std::size_t read(std::size_t count, uint8_t* data,
                      unsigned int timeoutMillis = 0);
+
+    bool async_read_borrowed(StreamReader::BorrowedCallback callback,
+                             unsigned int timeoutMillis = 0);
+    void set_block_pool(ReadBlockPool::Ptr pool);
     std::size_t write(std::size_t count, const uint8_t* data,
                       unsigned int timeoutMillis = 0);
 
@@ -102,6 +123,29 @@ class Stream
     std::size_t read_until(std::size_t maxSize, uint8_t* data,
                            char delimiter, unsigned int timeoutMillis = 0);
 
+    bool async_read_frame(std::size_t maxSize, uint8_t* data, Callback callback,
+                          unsigned int timeoutMillis = 0,
+                          unsigned int gapMicros = 0);
+    std::size_t read_frame(std::size_t maxSize, uint8_t* data,
+                           unsigned int timeoutMillis = 0,
+                           unsigned int gapMicros = 0);
+
+    bool async_write_priority(unsigned int priority,
+                              std::size_t count, const uint8_t* data,
+                              Callback callback, unsigned int timeoutMillis = 0);
+    std::size_t write_priority(unsigned int priority,
+                               std::size_t count, const uint8_t* data,
+                               unsigned int timeoutMillis = 0);
+    bool enable_scheduled_writes(const WriteScheduler::Parameters& params
+                                     = WriteScheduler::Parameters());
+    void disable_scheduled_writes();
+    bool enable_pacing(double bytesPerSecond, std::size_t burst);
+    void disable_pacing();
+
+    bool enable_queued_reads(std::size_t maxQueued = 16,
+                             std::size_t ringSize  = 1024*1024);
+    void disable_queued_reads();
+
     void enable_io_dump(const std::string& rxFile = "asio_rx.dump",
                         const std::string& txFile = "asio_tx.dump",
                         bool appendMode = false);
@@ -30,12 +30,14 @@
 #define _DEF_RTAC_ASIO_STREAM_INTERFACE_H_
 
 #include <memory>
+#include <mutex>
 #include <functional>
 
 //#include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
 
 #include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamStats.h>
 
 namespace rtac { namespace asio {
 
@@ -51,13 +53,63 @@ class StreamInterface
 
     protected:
 
-    AsyncService::Ptr service_;
-
-    StreamInterface(AsyncService::Ptr service) : service_(service) {}
+    // The completion handlers given to the device may run after the stream
+    // was destroyed (operation_aborted once the destructor closed the
+    // device). Those using the stream hold this token and check it under
+    // its mutex. The implementations invalidate it first in their destructor
+    // (see invalidate_handlers).
+    struct HandlerToken {
+        std::mutex mutex;
+        bool       valid = true;
+    };
+    using HandlerTokenPtr = std::shared_ptr<HandlerToken>;
+
+    AsyncService::Ptr      service_;
+    TransportCounters::Ptr counters_;
+    HandlerTokenPtr        handlerToken_;
+
+    StreamInterface(AsyncService::Ptr service) :
+        service_(service),
+        counters_(TransportCounters::Create(this)),
+        handlerToken_(std::make_shared<HandlerToken>())
+    {}
+
+    void invalidate_handlers();
+
+    // Completion handler recording a transfer in counters_ before calling
+    // the callback. Given by the implementations to the underlying device.
+    // It holds the counters, so it does not need the stream.
+    struct Recorder {
+        std::shared_ptr<TransportCounters::Direction> direction;
+        Callback                                      callback;
+        void operator()(const ErrorCode& err, std::size_t count) const {
+            direction->complete(err, count);
+            callback(err, count);
+        }
+    };
+    Recorder record_read(std::size_t size, const Callback& callback) {
+        counters_->rx.submit(size);
+        return Recorder{std::shared_ptr<TransportCounters::Direction>(
+                            counters_, &counters_->rx), callback};
+    }
+    Recorder record_write(std::size_t size, const Callback& callback) {
+        counters_->tx.submit(size);
+        return Recorder{std::shared_ptr<TransportCounters::Direction>(
+                            counters_, &counters_->tx), callback};
+    }
+
+    // Non-blocking read on a native descriptor, for try_read_some. Sockets
+    // are read with MSG_DONTWAIT, other descriptors (ttys) are polled first.
+    // Only the reads returning data are recorded in counters_.
+    std::size_t native_try_read(int fd, bool isSocket, std::size_t bufferSize,
+                                uint8_t* buffer, ErrorCode& err);
 
     public:
 
+    virtual ~StreamInterface();
+
     AsyncService::Ptr service() const { return service_; }
+    TransportCounters::Snapshot counters() const { return counters_->snapshot(); }
 
     virtual void async_read_some(std::size_t bufferSize,
                                  uint8_t*    buffer,
@@ -65,9 +117,36 @@ class StreamInterface
     virtual void async_write_some(std::size_t    count,
                                   const uint8_t* data,
                                   Callback       callback) = 0;
+    // Reads the data already available on the device without blocking and
+    // without going through the service. err is would_block when no data is
+    // available or when the stream does not support it (default). Must not
+    // be called while an async_read_some is pending.
+    virtual std::size_t try_read_some(std::size_t bufferSize,
+                                      uint8_t*    buffer,
+                                      ErrorCode&  err);
     virtual void flush() = 0;
     virtual void reset() = 0;
     virtual bool is_open() const { return true; }
+
+    // Cancels the pending read and write operations. They complete with
+    // boost::asio::error::operation_aborted, after which the stream does not
+    // access their buffers anymore. Returns false if the stream does not
+    // support cancellation.
+    virtual bool cancel() { return false; }
+
+    // Closes the device without reopening it (unlike reset(), which
+    // reconnects the client streams). Does nothing by default.
+    virtual void close() {}
+
+    // Line silence delimiting two frames for silence based framing
+    // (StreamReader::async_read_frame). 0 means the stream has no natural
+    // inter-frame gap and one must be given explicitly.
+    virtual unsigned int frame_gap_micros() const { return 0; }
+
+    // Byte stream descriptor of the device for the zero-copy forwarding of
+    // a Bridge, -1 if the stream has none (or it may change across
+    // reconnections).
+    virtual int native_fd() const { return -1; }
 };
 
 } //namespace asio
@@ -32,11 +32,19 @@
 #include <memory>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <fstream>
+#include <vector>
+
+#include <boost/asio/steady_timer.hpp>
 
 #include <rtac_asio/AsyncService.h>
+#include <rtac_asio/TimerWheel.h>
+#include <rtac_asio/ReadQueue.h>
+#include <rtac_asio/ReadBlockPool.h>
 #include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/StreamStats.h>
 
 namespace rtac { namespace asio {
 
@@ -53,30 +61,54 @@ class StreamReader
 
     using ErrorCode = StreamInterface::ErrorCode;
     using Callback  = StreamInterface::Callback;
+    using BorrowedCallback = std::function<void(const ErrorCode&, BorrowedBuffer)>;
+
+    static constexpr uint64_t Busy      = 0x1;
+    static constexpr uint64_t TimedOut  = 0x2;
+    static constexpr uint64_t Finishing = 0x4;
+    static constexpr uint64_t Cancelled = 0x8;
+
+    using Millis = AsyncService::Millis;
+
+    using ReadBuffer = BufferPool::StreamBuffer;
 
-    using Timer  = boost::asio::deadline_timer;
-    using Millis = boost::posix_time::milliseconds;
+    using GapTimer = boost::asio::steady_timer;
+    using Micros   = std::chrono::microseconds;
 
-    using ReadBuffer = boost::asio::streambuf;
+    static constexpr std::size_t FrameChunkSize = 4096;
+    static constexpr std::size_t DumpBufferSize = 8192;
 
     protected:
 
     StreamInterface::Ptr stream_;
 
-    unsigned int       readCounter_;
-    unsigned int       readId_;
+    // State of the current operation : the id of the last started
+    // operation in the upper 32 bits, and the Busy, TimedOut, Cancelled and
+    // Finishing flags in the lower bits. Starting, checking and ending an
+    // operation are done with atomic operations on this word instead of a
+    // mutex.
+    std::atomic<uint64_t> state_;
+    unsigned int       readId_; // id of the last started read
     std::size_t        requestedSize_;
     std::size_t        processed_;
     uint8_t*           dst_;
     Callback           callback_;
-    mutable std::mutex readMutex_;
 
-    Timer timer_;
+    TimerWheel::Handle timeout_; // armed on the service timer wheel
 
-    // synchronization for synchronous read
+    OperationCounters::Ptr               counters_;
+    OperationCounters::Clock::time_point startTime_; // of the current read
+    bool                                 inlineCompletion_; // see set_inline_completion
+
+    // synchronization for synchronous read. The waiting thread may spin on
+    // waiterNotified_ for spinMicros_ before sleeping on waiter_
+    // (waiterSleeping_ is then set and the callback must notify).
     std::mutex              mutex_;
     std::condition_variable waiter_;
-    bool                    waiterNotified_;
+    std::atomic<bool>       waiterNotified_;
+    std::atomic<bool>       waiterSleeping_;
+    unsigned int            spinMicros_;
+    std::size_t             syncCount_;
 
     // This buffer is necessary only because of the read_until primitive.
     // However, to keep a continuous stream of data, it needs to be read from
@@ -85,8 +117,31 @@ class StreamReader
     // primitives.
     ReadBuffer readBuffer_;
 
-    //output file for debug / record
-    std::ofstream rxDump_;
+    // Frame reads (async_read_frame) cannot read directly into the user
+    // buffer : the end of a frame is only detected after some silence on the
+    // line, while a read is still pending on the stream. This read is done in
+    // rxChunk_ and stays pending after the end of the frame. Its data will be
+    // delivered to the next read through the readBuffer_ (rxPending_ is true
+    // in the meantime and other reads are deferred until it completes).
+    BufferPool::Bytes     rxChunk_;
+    bool                  rxPending_;
+    std::function<void()> deferredRead_;
+    Callback              deferredCallback_;
+    std::mutex            rxMutex_;
+    unsigned int          frameReadId_;
+    Micros                frameGap_;
+    GapTimer              gapTimer_;
+    unsigned int          gapCounter_;
+
+    // Queued read mode (see enable_queued_reads)
+    ReadQueue::Ptr readQueue_;
+
+    // Blocks lent to the user by async_read_borrowed
+    ReadBlockPool::Ptr blockPool_;
+
+    //output file for debug / record (see StreamWriter::dumpBuffer_)
+    BufferPool::Bytes dumpBuffer_;
+    std::ofstream     rxDump_;
 
     StreamReader(StreamInterface::Ptr stream);
     
@@ -94,9 +149,14 @@ class StreamReader
     // request is still in progress.
     bool new_read(std::size_t requestedSize, uint8_t* data, Callback callback,
                   unsigned int timeoutMillis = 0);
+    void arm_timeout(unsigned int timeoutMillis);
     void finish_read(const ErrorCode& err);
+    std::size_t finish_read_sync();
     bool readid_ok(unsigned int readId) const;
     void timeout_reached(unsigned int readId, const ErrorCode& err);
+    bool aborted() const;
+    ErrorCode abort_error() const;
+    bool must_reissue(const ErrorCode& err) const;
 
     void do_read_some(std::size_t count, uint8_t* data, Callback callback);
 
@@ -104,12 +164,26 @@ class StreamReader
                                   const ErrorCode& err, std::size_t readCount);
     void async_read_continue(unsigned int readId,
                              const ErrorCode& err, std::size_t readCount);
+    bool read_now(bool untilDelimiter = false, char delimiter = '\0');
+    bool read_buffered_until(char delimiter);
     void read_callback(const ErrorCode& err, std::size_t readCount);
+    void wait_sync(std::unique_lock<std::mutex>& lock);
     void async_read_until_continue(unsigned int readId, char delimiter,
                                    const ErrorCode& err, std::size_t readCount);
     void dump_callback(Callback callback, uint8_t* data,
                        const ErrorCode& err, std::size_t readCount);
 
+    void borrowed_read_continue(std::shared_ptr<BorrowedBuffer::Lease>& lease,
+                                const uint8_t* block, BorrowedCallback callback,
+                                const ErrorCode& err, std::size_t readCount);
+
+    void start_frame(unsigned int readId);
+    void read_frame_chunk();
+    void frame_chunk_received(const ErrorCode& err, std::size_t readCount);
+    void arm_gap_timer(unsigned int readId);
+    void gap_reached(unsigned int readId, unsigned int gapId,
+                     const ErrorCode& err);
+
     public:
 
     ~StreamReader();
@@ -121,6 +195,43 @@ class StreamReader
 
     void flush();
     void reset();
+    // Ends the read in progress with operation_aborted (not the queued reads).
+    bool cancel();
+
+    OperationCounters::Snapshot stats() const { return counters_->snapshot(); }
+
+    /**
+     * The synchronous reads spin up to micros microseconds on the completion
+     * of the operation before sleeping (0, the default, never spins). This
+     * removes the thread wakeup latency when the read completes quickly,
+     * at the cost of a busy core.
+     */
+    void set_sync_spin(unsigned int micros) { spinMicros_ = micros; }
+
+    /**
+     * With inline completion, the callback of an operation completed in the
+     * service thread is called right away instead of being posted again on
+     * the service (see AsyncService::dispatch). The callback then runs
+     * inside the completion handler of the transport and must return
+     * quickly. It may start a new read. Disabled by default.
+     */
+    void set_inline_completion(bool enable) { inlineCompletion_ = enable; }
+    bool inline_completion() const { return inlineCompletion_; }
+
+    /**
+     * In queued read mode, up to maxQueued async_read_some / async_read
+     * requests are accepted at once and fulfilled in order. The stream is
+     * read continuously into a ring buffer of ringSize bytes by a single
+     * internal read loop, even when no read is queued (until the ring is
+     * full).
+     *
+     * async_read_until and async_read_frame are not available in this mode.
+     * This mode should be enabled and disabled while no read is in progress.
+     */
+    bool enable_queued_reads(std::size_t maxQueued = 16,
+                             std::size_t ringSize  = 1024*1024);
+    void disable_queued_reads();
+    bool queued_reads_enabled() const { return readQueue_ != nullptr; }
 
     void enable_dump(const std::string& filename="asio_rx.dump",
                      bool appendMode = false);
@@ -133,6 +244,27 @@ class StreamReader
     bool async_read(std::size_t count, uint8_t* data, Callback callback,
                     unsigned int timeoutMillis = 0);
 
+    /**
+     * Reads some data into a block owned by the reader and lends it to the
+     * user as a read-only BorrowedBuffer. The block is recycled in the pool
+     * when the BorrowedBuffer (and all its copies) are released.
+     *
+     * Returns false if a read is already in progress or if all blocks of the
+     * pool are lent. A default pool of 8 blocks of 64kB is created on the
+     * first call if none was set with set_block_pool.
+     */
+    bool async_read_borrowed(BorrowedCallback callback,
+                             unsigned int timeoutMillis = 0);
+    void set_block_pool(ReadBlockPool::Ptr pool) { blockPool_ = pool; }
+    ReadBlockPool::Ptr block_pool() const { return blockPool_; }
+
+    /**
+     * The synchronous reads (read, read_until) are completed on the calling
+     * thread without going through the service when the leftovers of a
+     * previous read_until and the data already available on the stream are
+     * enough (see StreamInterface::try_read_some). Otherwise they wait for
+     * the asynchronous read as usual.
+     */
     std::size_t read(std::size_t count, uint8_t* data,
                      unsigned int timeoutMillis = 0);
 
@@ -140,6 +272,23 @@ class StreamReader
                           Callback callback, unsigned int timeoutMillis = 0);
     std::size_t read_until(std::size_t maxSize, uint8_t* data,
                            char delimiter, unsigned int timeoutMillis = 0);
+
+    /**
+     * Reads a frame delimited by line silence (Modbus RTU style).
+     *
+     * The frame ends when no data was received for gapMicros microseconds
+     * after the last received chunk. If gapMicros is 0, the gap given by the
+     * underlying stream (StreamInterface::frame_gap_micros) is used.
+     *
+     * The callback is called once per frame. A frame longer than maxSize is
+     * truncated and its remaining bytes are delivered by the next read.
+     */
+    bool async_read_frame(std::size_t maxSize, uint8_t* data, Callback callback,
+                          unsigned int timeoutMillis = 0,
+                          unsigned int gapMicros = 0);
+    std::size_t read_frame(std::size_t maxSize, uint8_t* data,
+                           unsigned int timeoutMillis = 0,
+                           unsigned int gapMicros = 0);
 };
 
 } //namespace asio
@@ -0,0 +1,233 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_STREAM_STATS_H_
+#define _DEF_RTAC_ASIO_STREAM_STATS_H_
+
+#include <memory>
+#include <atomic>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <functional>
+#include <iosfwd>
+
+#include <boost/system/error_code.hpp>
+
+namespace rtac { namespace asio {
+
+/**
+ * Latency histogram with a bounded relative error (HDR histogram style).
+ *
+ * Values are nanoseconds. Each power of two range is split in SubBuckets
+ * linear buckets, so a recorded value is known within 1/SubBuckets (~6%).
+ * Values above 2^MaxExponent ns (~18 minutes) are counted in the last
+ * bucket. Recording is a single relaxed atomic increment, the histogram can
+ * be recorded from any thread while being read.
+ */
+class LatencyHistogram
+{
+    public:
+
+    static constexpr unsigned int SubBits     = 4;
+    static constexpr unsigned int SubBuckets  = 1 << SubBits;
+    static constexpr unsigned int MaxExponent = 40;
+    static constexpr unsigned int BucketCount = (MaxExponent - SubBits + 2) * SubBuckets;
+
+    struct Snapshot
+    {
+        std::vector<uint64_t> buckets; // empty if nothing was recorded
+        uint64_t count = 0;
+        uint64_t sum   = 0;
+        uint64_t min   = 0;
+        uint64_t max   = 0;
+
+        double   mean() const { return count > 0 ? double(sum) / count : 0.0; }
+        // value at percentile p (0 to 100), upper bound of its bucket.
+        uint64_t percentile(double p) const;
+    };
+
+    protected:
+
+    std::array<std::atomic<uint64_t>, BucketCount> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+
+    public:
+
+    LatencyHistogram();
+
+    static unsigned int bucket_index(uint64_t value);
+    static uint64_t     bucket_upper_bound(unsigned int index);
+
+    void record(uint64_t nanos);
+    void reset();
+    void record(std::chrono::steady_clock::duration d) {
+        this->record(d.count() > 0 ? (uint64_t)
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() : 0);
+    }
+    Snapshot snapshot() const;
+};
+
+/**
+ * Counters of the operations of a StreamReader or a StreamWriter.
+ *
+ * The latency histogram measures the time from the start of an operation
+ * (async_read, async_write...) to its completion. The dispatch histogram
+ * measures the time from its completion to the call of the user callback
+ * (time spent in the AsyncService queue). The pacing histogram (writer
+ * only) measures the time writes waited for the rate limit of a WritePacer.
+ */
+struct OperationCounters
+{
+    using Ptr       = std::shared_ptr<OperationCounters>;
+    using Clock     = std::chrono::steady_clock;
+    using ErrorCode = boost::system::error_code;
+    using Callback  = std::function<void(const ErrorCode&, std::size_t)>;
+
+    struct Snapshot
+    {
+        uint64_t ops      = 0;
+        uint64_t bytes    = 0;
+        uint64_t timeouts = 0;
+        uint64_t errors   = 0;
+        uint64_t busy     = 0;
+        uint64_t buffered = 0;
+        uint64_t paced    = 0;
+        LatencyHistogram::Snapshot latency;
+        LatencyHistogram::Snapshot dispatch;
+        LatencyHistogram::Snapshot pacing;
+    };
+
+    std::atomic<uint64_t> ops;      // completed operations
+    std::atomic<uint64_t> bytes;    // bytes transferred by completed operations
+    std::atomic<uint64_t> timeouts; // operations ended by their timeout
+    std::atomic<uint64_t> errors;   // operations ended by another error
+    std::atomic<uint64_t> busy;     // operations refused (one already in progress)
+    std::atomic<uint64_t> buffered; // bytes served from a leftover buffer (reader only)
+    std::atomic<uint64_t> paced;    // writes delayed by the rate limit (writer only)
+    LatencyHistogram      latency;
+    LatencyHistogram      dispatch;
+    LatencyHistogram      pacing;
+
+    OperationCounters();
+
+    static Ptr Create() { return std::make_shared<OperationCounters>(); }
+
+    void add(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records the completion of an operation started at start and returns
+     * the handler calling the user callback, to be posted on the service.
+     */
+    static std::function<void()> complete(const Ptr& counters,
+                                          const Callback& callback,
+                                          const ErrorCode& err,
+                                          std::size_t count,
+                                          Clock::time_point start);
+
+    Snapshot snapshot() const;
+};
+
+/**
+ * Counters of a StreamInterface : operations submitted to and completed by
+ * the underlying device or socket, in each direction.
+ */
+struct TransportCounters
+{
+    using Ptr      = std::shared_ptr<TransportCounters>;
+    using ConstPtr = std::shared_ptr<const TransportCounters>;
+
+    struct Direction
+    {
+        std::atomic<uint64_t> submitted;
+        std::atomic<uint64_t> completed;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> errors;
+        const void*           stream;    // for the tracepoints
+        int                   direction; // 0 rx, 1 tx
+
+        Direction(const void* stream, int direction) :
+            submitted(0), completed(0), bytes(0), errors(0),
+            stream(stream), direction(direction)
+        {}
+
+        // Defined in StreamStats.cpp : they expand the tracepoints, which
+        // are only enabled when building the library.
+        void submit(std::size_t size);
+        void complete(const boost::system::error_code& err, std::size_t count);
+    };
+
+    struct Snapshot
+    {
+        struct Direction {
+            uint64_t submitted = 0;
+            uint64_t completed = 0;
+            uint64_t bytes     = 0;
+            uint64_t errors    = 0;
+        };
+        Direction rx;
+        Direction tx;
+    };
+
+    Direction rx;
+    Direction tx;
+
+    // stream identifies the transport in the tracepoints.
+    TransportCounters(const void* stream = nullptr) : rx(stream, 0), tx(stream, 1) {}
+    static Ptr Create(const void* stream = nullptr) {
+        return std::make_shared<TransportCounters>(stream);
+    }
+
+    Snapshot snapshot() const;
+};
+
+/**
+ * Snapshot of all the counters of a Stream (Stream::stats()).
+ */
+struct StreamStats
+{
+    OperationCounters::Snapshot reader;
+    OperationCounters::Snapshot writer;
+    TransportCounters::Snapshot transport;
+
+    std::string to_text() const;
+    std::string to_json() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const StreamStats& stats);
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_STREAM_STATS_H_
@@ -32,11 +32,16 @@
 #include <memory>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <fstream>
 
 #include <rtac_asio/AsyncService.h>
+#include <rtac_asio/TimerWheel.h>
 #include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/StreamStats.h>
+#include <rtac_asio/WriteScheduler.h>
+#include <rtac_asio/WritePacer.h>
 
 namespace rtac { namespace asio {
 
@@ -54,30 +59,52 @@ class StreamWriter
     using ErrorCode = StreamInterface::ErrorCode;
     using Callback  = StreamInterface::Callback;
 
-    using Timer  = boost::asio::deadline_timer;
-    using Millis = boost::posix_time::milliseconds;
+    static constexpr uint64_t Busy      = 0x1;
+    static constexpr uint64_t TimedOut  = 0x2;
+    static constexpr uint64_t Finishing = 0x4;
+    static constexpr uint64_t Cancelled = 0x8;
+
+    using Millis = AsyncService::Millis;
+
+    static constexpr std::size_t DumpBufferSize = 8192;
 
     protected:
 
     StreamInterface::Ptr stream_;
 
-    unsigned int       writeCounter_;
-    unsigned int       writeId_;
+    // write id in the upper 32 bits, flags in the lower bits (see
+    // StreamReader::state_).
+    std::atomic<uint64_t> state_;
+    unsigned int       writeId_; // id of the last started write
     std::size_t        requestedSize_;
     std::size_t        processed_;
     const uint8_t*     src_;
     Callback           callback_;
-    mutable std::mutex writeMutex_;
 
-    Timer timer_;
+    TimerWheel::Handle timeout_; // armed on the service timer wheel
+
+    OperationCounters::Ptr               counters_;
+    OperationCounters::Clock::time_point startTime_; // of the current write
+    bool                                 inlineCompletion_; // see set_inline_completion
 
-    // synchronization for synchronous write
+    // synchronization for synchronous write. The waiting thread may spin on
+    // waiterNotified_ for spinMicros_ before sleeping on waiter_
+    // (waiterSleeping_ is then set and the callback must notify).
     std::mutex              mutex_;
     std::condition_variable waiter_;
-    bool                    waiterNotified_;
+    std::atomic<bool>       waiterNotified_;
+    std::atomic<bool>       waiterSleeping_;
+    unsigned int            spinMicros_;
 
-    //output file for debug / record
-    std::ofstream txDump_;
+    // Scheduled write mode (see enable_scheduled_writes)
+    WriteScheduler::Ptr scheduler_;
+    // Rate limit (see enable_pacing)
+    WritePacer::Ptr     pacer_;
+
+    //output file for debug / record. The file buffer is taken from the
+    // service buffer pool (it must outlive txDump_).
+    BufferPool::Bytes dumpBuffer_;
+    std::ofstream     txDump_;
 
     StreamWriter(StreamInterface::Ptr stream);
 
@@ -88,6 +115,9 @@ class StreamWriter
     void finish_write(const ErrorCode& err);
     bool writeid_ok(unsigned int writeId) const;
     void timeout_reached(unsigned int writeId, const ErrorCode& err);
+    bool aborted() const;
+    ErrorCode abort_error() const;
+    bool must_reissue(const ErrorCode& err) const;
 
     void do_write_some(std::size_t count, const uint8_t* data, Callback callback);
 
@@ -96,6 +126,9 @@ class StreamWriter
     void async_write_continue(unsigned int writeId,
                               const ErrorCode& err, std::size_t writtenCount);
     void write_callback(const ErrorCode& err, std::size_t writtenCount);
+    void wait_sync(std::unique_lock<std::mutex>& lock);
+    std::size_t scheduled_write(unsigned int priority, std::size_t count,
+                                const uint8_t* data, unsigned int timeoutMillis);
     void dump_callback(Callback callback, const uint8_t* data,
                        const ErrorCode& err, std::size_t writtenCount);
 
@@ -110,6 +143,58 @@ class StreamWriter
 
     void flush();
     void reset();
+    // Ends the write in progress with operation_aborted (not the scheduled writes).
+    bool cancel();
+
+    OperationCounters::Snapshot stats() const { return counters_->snapshot(); }
+
+    /**
+     * The synchronous writes spin up to micros microseconds on the completion
+     * of the operation before sleeping (0, the default, never spins). This
+     * removes the thread wakeup latency when the write completes quickly,
+     * at the cost of a busy core.
+     */
+    void set_sync_spin(unsigned int micros) { spinMicros_ = micros; }
+
+    /**
+     * With inline completion, the callback of an operation completed in the
+     * service thread is called right away instead of being posted again on
+     * the service (see AsyncService::dispatch). The callback then runs
+     * inside the completion handler of the transport and must return
+     * quickly. It may start a new write. Disabled by default.
+     */
+    void set_inline_completion(bool enable) { inlineCompletion_ = enable; }
+    bool inline_completion() const { return inlineCompletion_; }
+
+    /**
+     * In scheduled write mode, writes are queued by priority class instead
+     * of being refused while another write is in progress, and large writes
+     * are sent in slices so that urgent writes can go in between (see
+     * WriteScheduler for the policies and the caveats of slicing).
+     *
+     * async_write, async_write_some and write use the default priority of
+     * the parameters, async_write_priority and write_priority take one (0
+     * is the most urgent). This mode should be enabled and disabled while no
+     * write is in progress.
+     */
+    bool enable_scheduled_writes(const WriteScheduler::Parameters& params
+                                     = WriteScheduler::Parameters());
+    void disable_scheduled_writes();
+    bool scheduled_writes_enabled() const { return scheduler_ != nullptr; }
+    WriteScheduler::Ptr scheduler() const { return scheduler_; }
+
+    /**
+     * Limits the byte rate of the writes with a token bucket of burst bytes
+     * refilled at bytesPerSecond (see WritePacer). Delayed writes are
+     * started again by the service timer wheel, no thread is blocked
+     * meanwhile. The time spent waiting for the rate limit is recorded in
+     * the pacing histogram of the writer stats. Calling enable_pacing again
+     * changes the rate of the current bucket.
+     */
+    bool enable_pacing(double bytesPerSecond, std::size_t burst);
+    void disable_pacing();
+    bool pacing_enabled() const { return pacer_ != nullptr; }
+    WritePacer::Ptr pacer() const { return pacer_; }
 
     void enable_dump(const std::string& filename="asio_tx.dump",
                      bool appendMode = false);
@@ -126,6 +211,14 @@ class StreamWriter
 
     std::size_t write(std::size_t count, const uint8_t* data,
                       unsigned int timeoutMillis = 0);
+
+    // priority is ignored if the scheduled write mode is not enabled.
+    bool async_write_priority(unsigned int priority,
+                              std::size_t count, const uint8_t* data,
+                              Callback callback, unsigned int timeoutMillis = 0);
+    std::size_t write_priority(unsigned int priority,
+                               std::size_t count, const uint8_t* data,
+                               unsigned int timeoutMillis = 0);
 };
 
 } //namespace asio
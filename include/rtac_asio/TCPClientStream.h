@@ -30,23 +30,46 @@
 #define _DEF_RTAC_ASIO_TCP_CLIENT_STREAM_H_
 
 #include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
 
-#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/ip/tcp.hpp>
 
 #include <rtac_asio/AsyncService.h>
 #include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/TCPSocketOptions.h>
+#include <rtac_asio/ip_utils.h>
 
 namespace rtac { namespace asio {
 
 /**
- * The main purpose of this class is to buffer TCP packets.
+ * TCP client connection.
  *
- * A read on a boost::asio UDP socket will lose some data if the whole packet
- * is not read fully at once. This class buffers UDP data until read or flushed
- * by the user.
+ * The connection is established asynchronously on the AsyncService : the
+ * constructor (and reset()) never block, and a connection attempt is aborted
+ * after Parameters::connectTimeoutMillis.
  *
- * The default buffer size of 1024 should be safe enough for any UDP packet
- * (but please check this in your own application).
+ * The remote can be given as a numeric address or as a host name. Host names
+ * are resolved with Resolver::Default() (asynchronous and cached). When
+ * several addresses are resolved, they are tried "Happy Eyeballs" style
+ * (RFC 8305) : address families are interleaved, a new attempt is started
+ * every Parameters::attemptDelayMillis (or as soon as the previous one
+ * failed) without cancelling the previous ones, and the first established
+ * connection is kept.
+ *
+ * When Parameters::autoReconnect is set, a lost or failed connection is
+ * re-established with an exponential backoff (starting at
+ * reconnectMinMillis, capped at reconnectMaxMillis and randomized by
+ * reconnectJitter to avoid many clients reconnecting in sync).
+ *
+ * While the connection is not established, written data is buffered (up to
+ * Parameters::writeBufferSize bytes) and sent as soon as the connection is
+ * up. A read requested while the connection is down is started once the
+ * connection is established.
+ *
+ * Parameters::socketOptions are applied to the socket on each connection
+ * attempt (see TCPSocketOptions).
  */
 class TCPClientStream : public StreamInterface
 {
@@ -61,40 +84,138 @@ class TCPClientStream : public StreamInterface
     using Socket       = boost::asio::ip::tcp::socket;
     using EndPoint     = boost::asio::ip::tcp::endpoint;
 
+    using ConnectHandler = std::function<void(const ErrorCode&)>;
+
+    enum State {
+        Disconnected,
+        Connecting,
+        Connected
+    };
+
+    struct Parameters
+    {
+        unsigned int connectTimeoutMillis; // 0 means OS connect timeout
+        bool         autoReconnect;
+        unsigned int reconnectMinMillis;
+        unsigned int reconnectMaxMillis;
+        float        reconnectJitter;      // in [0,1], fraction of the delay
+        unsigned int attemptDelayMillis;   // delay between parallel attempts
+        std::size_t  writeBufferSize;      // 0 means writes fail while disconnected
+
+        TCPSocketOptions socketOptions;
+
+        Parameters(unsigned int connectTimeoutMillis = 3000,
+                   bool         autoReconnect        = false,
+                   const TCPSocketOptions& options   = TCPSocketOptions()) :
+            connectTimeoutMillis(connectTimeoutMillis),
+            autoReconnect(autoReconnect),
+            reconnectMinMillis(100),
+            reconnectMaxMillis(10000),
+            reconnectJitter(0.2f),
+            attemptDelayMillis(250),
+            writeBufferSize(65536),
+            socketOptions(options)
+        {}
+    };
+
     protected:
 
+    struct PendingRead {
+        std::size_t bufferSize;
+        uint8_t*    buffer;
+        Callback    callback;
+    };
+
+    Parameters              parameters_;
     std::unique_ptr<Socket> socket_;
+    std::string             host_; // empty if connecting to remote_ directly
+    uint16_t                port_;
     EndPoint                remote_;
 
-    TCPClientStream(AsyncService::Ptr service,
-                    const std::string& remoteIP,
-                    uint16_t remotePort);
+    // connection attempts in progress
+    std::vector<EndPoint>                candidates_;
+    std::vector<std::unique_ptr<Socket>> trials_;
+    std::size_t                          nextCandidate_;
+    std::size_t                          failedTrials_;
+
+    mutable std::recursive_mutex mutex_;
+    State                        state_;
+    unsigned int                 connectId_; // allows to detect stale handlers
+    unsigned int                 attempts_;
+    bool                         reconnecting_;
+    AsyncService::Timer          connectTimer_;
+    AsyncService::Timer          reconnectTimer_;
+    AsyncService::Timer          trialTimer_;
+    std::minstd_rand             rng_;
+    ConnectHandler               connectHandler_;
+
+    std::unique_ptr<PendingRead> pendingRead_;
+    BufferPool::Bytes            txBuffer_;   // waiting to be sent
+    BufferPool::Bytes            txFlushing_; // being sent
 
-    void receive_continue(std::size_t bufferSize,
-                          uint8_t* buffer,
-                          Callback callback,
-                          const ErrorCode& err,
-                          std::size_t received);
+    TCPClientStream(AsyncService::Ptr service,
+                    const std::string& remoteHost,
+                    uint16_t remotePort,
+                    const Parameters& params);
+
+    void start_connect();
+    void resolve_continue(unsigned int connectId, const ErrorCode& err,
+                          const Resolver::AddressList& addresses);
+    void start_trial();
+    void trial_timer_callback(unsigned int connectId, const ErrorCode& err);
+    void close_trials();
+    void connect_continue(unsigned int connectId, std::size_t trialIndex,
+                          const ErrorCode& err);
+    void connect_timeout(unsigned int connectId, const ErrorCode& err);
+    void connection_failed(const ErrorCode& err);
+    void schedule_reconnect();
+    void reconnect_callback(unsigned int connectId, const ErrorCode& err);
+    void link_lost(unsigned int connectId, const ErrorCode& err);
+
+    void flush_tx_buffer();
+    void write_tx_flushing();
+    void transfer_continue(unsigned int connectId, const ErrorCode& err);
+    // Static : the stream is only used if the token is still valid.
+    static void flush_continue(TCPClientStream* stream, HandlerTokenPtr token,
+                               unsigned int connectId,
+                               const ErrorCode& err, std::size_t written);
+    static void read_continue(TCPClientStream* stream, HandlerTokenPtr token,
+                              unsigned int connectId, Callback callback,
+                              const ErrorCode& err, std::size_t count);
+    static void write_continue(TCPClientStream* stream, HandlerTokenPtr token,
+                               unsigned int connectId, Callback callback,
+                               const ErrorCode& err, std::size_t count);
 
     public:
 
     ~TCPClientStream();
 
     static Ptr Create(AsyncService::Ptr service,
-                      const std::string& remoteIP,
-                      uint16_t remotePort);
+                      const std::string& remoteHost,
+                      uint16_t remotePort,
+                      const Parameters& params = Parameters());
+
+    const std::string& host()      const { return host_;       }
+    const EndPoint&   remote()     const { return remote_;     }
+    const Parameters& parameters() const { return parameters_; }
+    State state() const;
+    bool  is_connected() const { return this->state() == Connected; }
 
-    const EndPoint& remote() const { return remote_; }
+    void set_connect_handler(const ConnectHandler& handler);
     
     void close();
     void reset(const EndPoint& remote);
     void reset();
     void flush();
     bool is_open() const;
+    bool cancel();
 
     void async_read_some(std::size_t bufferSize,
                          uint8_t*    buffer,
                          Callback    callback);
+    std::size_t try_read_some(std::size_t bufferSize,
+                              uint8_t*    buffer,
+                              ErrorCode&  err);
     void async_write_some(std::size_t    count,
                           const uint8_t* data,
                           Callback       callback);
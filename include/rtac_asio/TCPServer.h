@@ -0,0 +1,172 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_TCP_SERVER_H_
+#define _DEF_RTAC_ASIO_TCP_SERVER_H_
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/Stream.h>
+#include <rtac_asio/TCPSessionStream.h>
+#include <rtac_asio/TCPSocketOptions.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Accepts TCP connections on an AsyncService and wraps each of them in a
+ * Stream.
+ *
+ * Each accepted session is handed to the user through the AcceptCallback as
+ * a regular Stream (reader, writer and io dumps are available). The server
+ * keeps a reference on each session until it is closed, either by the remote
+ * end, by the user (Stream::reset) or because it was idle for more than
+ * Parameters::idleTimeoutMillis.
+ *
+ * When Parameters::maxSessions is reached, the server stops accepting new
+ * connections until a session is closed. Pending connections are kept by the
+ * kernel in the listen backlog in the meantime.
+ *
+ * All sessions share the AsyncService of the server. Idle sessions are
+ * checked by a single timer for the whole server instead of one timer per
+ * session. A session allocates no read buffer until the user starts reading
+ * on it.
+ *
+ * When accept fails because the process or the system ran out of file
+ * descriptors, accepting is retried after Parameters::acceptRetryMillis
+ * instead of immediately, to give sessions a chance to close.
+ *
+ * Asynchronous handlers only hold a weak reference on the server : releasing
+ * the last TCPServer::Ptr stops the server and closes its sessions.
+ */
+class TCPServer : public std::enable_shared_from_this<TCPServer>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<TCPServer>;
+    using ConstPtr = std::shared_ptr<const TCPServer>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+
+    using Acceptor = boost::asio::ip::tcp::acceptor;
+    using Socket   = boost::asio::ip::tcp::socket;
+    using EndPoint = boost::asio::ip::tcp::endpoint;
+
+    using AcceptCallback = std::function<void(Stream::Ptr)>;
+
+    struct Parameters
+    {
+        int          backlog;
+        std::size_t  maxSessions;
+        unsigned int idleTimeoutMillis; // 0 means no idle timeout
+
+        TCPSocketOptions socketOptions; // applied on each accepted session
+
+        unsigned int acceptRetryMillis; // delay before accepting again on EMFILE/ENFILE
+
+        Parameters(int          backlog           = Acceptor::max_listen_connections,
+                   std::size_t  maxSessions       = 1024,
+                   unsigned int idleTimeoutMillis = 0,
+                   const TCPSocketOptions& options = TCPSocketOptions(),
+                   unsigned int acceptRetryMillis = 100) :
+            backlog(backlog),
+            maxSessions(maxSessions),
+            idleTimeoutMillis(idleTimeoutMillis),
+            socketOptions(options),
+            acceptRetryMillis(acceptRetryMillis)
+        {}
+    };
+
+    protected:
+
+    struct Session {
+        TCPSessionStream::Ptr transport;
+        Stream::Ptr           stream;
+    };
+    using SessionMap = std::unordered_map<const TCPSessionStream*, Session>;
+
+    AsyncService::Ptr service_;
+    EndPoint          local_;
+    Parameters        parameters_;
+
+    std::unique_ptr<Acceptor> acceptor_;
+    std::unique_ptr<Socket>   pending_;
+    AcceptCallback            callback_;
+    bool                      accepting_;
+
+    SessionMap         sessions_;
+    mutable std::mutex sessionsMutex_;
+
+    AsyncService::Timer idleTimer_;
+    AsyncService::Timer retryTimer_;
+
+    TCPServer(AsyncService::Ptr service,
+              const std::string& localIP,
+              uint16_t localPort,
+              const Parameters& params);
+
+    void do_accept();
+    void accept_continue(const ErrorCode& err);
+    void retry_accept(const ErrorCode& err);
+    void session_closed(TCPSessionStream* session);
+    void remove_session(const TCPSessionStream* session);
+
+    void start_idle_timer();
+    void idle_timer_callback(const ErrorCode& err);
+
+    public:
+
+    ~TCPServer();
+
+    static Ptr Create(AsyncService::Ptr service,
+                      const std::string& localIP,
+                      uint16_t localPort,
+                      const Parameters& params = Parameters());
+    static Ptr Create(const std::string& localIP,
+                      uint16_t localPort,
+                      const Parameters& params = Parameters());
+
+    AsyncService::Ptr service() const { return service_; }
+    const EndPoint&   local()   const { return local_;   }
+    const Parameters& parameters() const { return parameters_; }
+
+    void start(const AcceptCallback& callback);
+    void stop();
+    void close_sessions();
+
+    std::size_t session_count() const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_TCP_SERVER_H_
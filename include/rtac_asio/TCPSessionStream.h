@@ -0,0 +1,134 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_TCP_SESSION_STREAM_H_
+#define _DEF_RTAC_ASIO_TCP_SESSION_STREAM_H_
+
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/TCPSocketOptions.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * StreamInterface around a TCP connection accepted by a TCPServer.
+ *
+ * Contrary to TCPClientStream, a session cannot be re-established from this
+ * side of the connection : reset() closes the session and the remote peer is
+ * expected to reconnect.
+ *
+ * The session keeps track of the time of its last successful transfer so the
+ * server can close idle sessions. No buffer is allocated by the session
+ * itself, all reads and writes are done directly in the user buffers.
+ */
+class TCPSessionStream : public StreamInterface
+{
+    public:
+
+    using Ptr      = std::shared_ptr<TCPSessionStream>;
+    using ConstPtr = std::shared_ptr<const TCPSessionStream>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+    using Callback  = StreamInterface::Callback;
+
+    using Socket   = boost::asio::ip::tcp::socket;
+    using EndPoint = boost::asio::ip::tcp::endpoint;
+    using Clock    = std::chrono::steady_clock;
+
+    using CloseHandler = std::function<void(TCPSessionStream*)>;
+
+    protected:
+
+    std::unique_ptr<Socket>         socket_;
+    EndPoint                        remote_;
+    std::atomic<Clock::rep>         lastActivity_;
+    CloseHandler                    closeHandler_;
+    TCPSocketOptions                options_;
+
+    TCPSessionStream(AsyncService::Ptr service,
+                     std::unique_ptr<Socket> socket,
+                     const CloseHandler& closeHandler,
+                     const TCPSocketOptions& options);
+
+    void touch();
+    void transfer_continue(const ErrorCode& err, std::size_t count);
+    // Static : the stream is only used if the token is still valid.
+    static void read_continue(TCPSessionStream* stream,
+                              HandlerTokenPtr token,
+                              Callback callback,
+                              const ErrorCode& err,
+                              std::size_t count);
+    static void write_continue(TCPSessionStream* stream,
+                               HandlerTokenPtr token,
+                               Callback callback,
+                               const ErrorCode& err,
+                               std::size_t count);
+
+    public:
+
+    ~TCPSessionStream();
+
+    static Ptr Create(AsyncService::Ptr service,
+                      std::unique_ptr<Socket> socket,
+                      const CloseHandler& closeHandler = CloseHandler(),
+                      const TCPSocketOptions& options = TCPSocketOptions());
+
+    const EndPoint& remote() const { return remote_; }
+    Clock::time_point last_activity() const;
+    const TCPSocketOptions& socket_options() const { return options_; }
+
+    void set_close_handler(const CloseHandler& handler) { closeHandler_ = handler; }
+
+    void close();
+    void reset();
+    void flush();
+    bool is_open() const;
+    bool cancel();
+    int  native_fd() const;
+
+    void async_read_some(std::size_t bufferSize,
+                         uint8_t*    buffer,
+                         Callback    callback);
+    std::size_t try_read_some(std::size_t bufferSize,
+                              uint8_t*    buffer,
+                              ErrorCode&  err);
+    void async_write_some(std::size_t    count,
+                          const uint8_t* data,
+                          Callback       callback);
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_TCP_SESSION_STREAM_H_
@@ -0,0 +1,92 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_TCP_SOCKET_OPTIONS_H_
+#define _DEF_RTAC_ASIO_TCP_SOCKET_OPTIONS_H_
+
+#include <boost/asio/ip/tcp.hpp>
+
+namespace rtac { namespace asio {
+
+/**
+ * Latency related options of a TCP socket.
+ *
+ * The default values leave the operating system defaults untouched. Options
+ * which are not supported on the current platform (most of them are Linux
+ * specific) are ignored with a warning.
+ *
+ * TCP_QUICKACK is not permanent on Linux (the kernel may leave the quickack
+ * mode on its own). When quickAck is set, it is re-armed after each
+ * completed read by the streams using these options.
+ */
+struct TCPSocketOptions
+{
+    using Socket    = boost::asio::ip::tcp::socket;
+    using Acceptor  = boost::asio::ip::tcp::acceptor;
+    using ErrorCode = boost::system::error_code;
+
+    bool         noDelay;           // TCP_NODELAY (disables Nagle's algorithm)
+    bool         quickAck;          // TCP_QUICKACK (disables delayed ACKs)
+    bool         keepAlive;         // SO_KEEPALIVE
+    int          keepAliveIdle;     // TCP_KEEPIDLE (seconds, 0 : system default)
+    int          keepAliveInterval; // TCP_KEEPINTVL (seconds, 0 : system default)
+    int          keepAliveCount;    // TCP_KEEPCNT (0 : system default)
+    int          receiveBufferSize; // SO_RCVBUF (bytes, 0 : system default)
+    int          sendBufferSize;    // SO_SNDBUF (bytes, 0 : system default)
+    unsigned int userTimeoutMillis; // TCP_USER_TIMEOUT (0 : system default)
+    int          busyPollMicros;    // SO_BUSY_POLL (0 : system default)
+
+    TCPSocketOptions() :
+        noDelay(false),
+        quickAck(false),
+        keepAlive(false),
+        keepAliveIdle(0),
+        keepAliveInterval(0),
+        keepAliveCount(0),
+        receiveBufferSize(0),
+        sendBufferSize(0),
+        userTimeoutMillis(0),
+        busyPollMicros(0)
+    {}
+
+    static TCPSocketOptions LowLatency() {
+        TCPSocketOptions options;
+        options.noDelay  = true;
+        options.quickAck = true;
+        return options;
+    }
+
+    ErrorCode apply(Socket& socket) const;
+    ErrorCode apply(Acceptor& acceptor) const;
+    void rearm(Socket& socket) const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_TCP_SOCKET_OPTIONS_H_
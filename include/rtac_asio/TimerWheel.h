@@ -0,0 +1,142 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_TIMER_WHEEL_H_
+#define _DEF_RTAC_ASIO_TIMER_WHEEL_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <functional>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace rtac { namespace asio {
+
+/**
+ * Hierarchical timer wheel batching many timeouts on a single kernel timer.
+ *
+ * StreamReader and StreamWriter arm a timeout on each operation and cancel it
+ * almost always before it expires. Using one boost timer per operation means
+ * one update of the kernel timer (timerfd) per operation. The wheel keeps the
+ * deadlines in 4 levels of 256 slots with a 1ms resolution (the same layout
+ * as the former Linux kernel timers) so that arm() and cancel() are O(1).
+ * The single steady_timer of the wheel is only re-armed when a new deadline
+ * is earlier than the one it is waiting for, or to cascade a higher level.
+ *
+ * Expired handlers are called from the io_service thread, without any lock
+ * held. A deadline is rounded up to the next millisecond tick.
+ */
+class TimerWheel
+{
+    public:
+
+    using Ptr      = std::shared_ptr<TimerWheel>;
+    using ConstPtr = std::shared_ptr<const TimerWheel>;
+
+    using Clock     = std::chrono::steady_clock;
+    using Handler   = std::function<void()>;
+    using ErrorCode = boost::system::error_code;
+
+    /**
+     * Identifies an armed timeout. The generation makes a handle on an
+     * already expired or cancelled timeout harmless.
+     */
+    struct Handle {
+        uint32_t index      = 0;
+        uint32_t generation = 0;
+        bool is_valid() const { return generation != 0; }
+    };
+
+    static constexpr unsigned int SlotBits  = 8;
+    static constexpr unsigned int SlotCount = 1 << SlotBits;
+    static constexpr unsigned int SlotMask  = SlotCount - 1;
+    static constexpr unsigned int Levels    = 4;
+
+    protected:
+
+    static constexpr uint32_t Nil = 0xffffffff;
+
+    struct Entry {
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        uint16_t level;
+        uint16_t slot;
+        uint64_t expiry;
+        Handler  handler;
+    };
+
+    struct Level {
+        std::array<uint32_t, SlotCount>      heads;
+        std::array<uint64_t, SlotCount / 64> occupied;
+    };
+
+    boost::asio::steady_timer timer_;
+    Clock::time_point         origin_;
+    uint64_t                  currentTick_;   // next tick to be processed
+    uint64_t                  scheduledTick_; // tick the timer_ is waiting for
+    bool                      scheduled_;
+    std::array<Level, Levels> levels_;
+    std::vector<Entry>        entries_;
+    uint32_t                  freeList_;
+    std::size_t               count_;
+    mutable std::mutex        mutex_;
+
+    uint64_t tick_at(const Clock::time_point& t) const;
+
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    uint32_t allocate();
+    void release(uint32_t index);
+
+    void cascade(unsigned int level, unsigned int slot);
+    void expire_slot(unsigned int slot, std::vector<Handler>& expired);
+    bool next_level0_tick(uint64_t from, uint64_t to, uint64_t& tick) const;
+    void schedule();
+    void timer_callback(const ErrorCode& err);
+
+    public:
+
+    TimerWheel(boost::asio::io_service& service);
+    ~TimerWheel();
+
+    Handle arm(unsigned int delayMillis, const Handler& handler);
+    bool   cancel(Handle& handle);
+    void   cancel_all();
+
+    std::size_t size() const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_TIMER_WHEEL_H_
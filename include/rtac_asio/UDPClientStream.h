@@ -66,20 +66,24 @@ class UDPClientStream : public StreamInterface
 
     std::unique_ptr<Socket>        socket_;
     EndPoint                       remote_;
-    std::vector<uint8_t>           buffer_;
-    std::vector<uint8_t>::iterator bufferBegin_;
-    std::vector<uint8_t>::iterator bufferEnd_;
+    BufferPool::Bytes              buffer_; // from the service buffer pool
+    BufferPool::Bytes::iterator    bufferBegin_;
+    BufferPool::Bytes::iterator    bufferEnd_;
 
     UDPClientStream(AsyncService::Ptr service,
                     const std::string& remoteIP,
                     uint16_t remotePort,
                     std::size_t bufferSize = 1024);
 
-    void receive_continue(std::size_t bufferSize,
-                          uint8_t* buffer,
-                          Callback callback,
-                          const ErrorCode& err,
-                          std::size_t received);
+    std::size_t read_buffered(std::size_t bufferSize, uint8_t* buffer);
+    // Static : the stream is only used if the token is still valid.
+    static void receive_continue(UDPClientStream* stream,
+                                 HandlerTokenPtr token,
+                                 std::size_t bufferSize,
+                                 uint8_t* buffer,
+                                 Callback callback,
+                                 const ErrorCode& err,
+                                 std::size_t received);
 
     public:
 
@@ -98,6 +102,7 @@ class UDPClientStream : public StreamInterface
     void reset();
     void flush();
     bool is_open() const;
+    bool cancel();
 
     void async_read_some(std::size_t bufferSize,
                          uint8_t*    buffer,
@@ -0,0 +1,129 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_UNIX_DATAGRAM_STREAM_H_
+#define _DEF_RTAC_ASIO_UNIX_DATAGRAM_STREAM_H_
+
+#include <memory>
+#include <vector>
+
+#include <boost/asio/generic/datagram_protocol.hpp>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Connection to a Unix domain packet socket (SOCK_DGRAM or SOCK_SEQPACKET).
+ *
+ * As for UDPClientStream, received packets are buffered so that a packet is
+ * not lost if it is read with a user buffer smaller than the packet. The
+ * buffer size must be at least the size of the largest expected packet.
+ *
+ * In Datagram mode, the socket is bound to an anonymous (autobind) address
+ * so the remote end can reply to it.
+ */
+class UnixDatagramStream : public StreamInterface
+{
+    public:
+
+    using Ptr      = std::shared_ptr<UnixDatagramStream>;
+    using ConstPtr = std::shared_ptr<const UnixDatagramStream>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+    using Callback  = StreamInterface::Callback;
+
+    // SOCK_SEQPACKET sockets are handled through a generic datagram socket.
+    // Connected send/receive operations are the same for both types.
+    using Socket = boost::asio::generic::datagram_protocol::socket;
+
+    enum Mode {
+        Datagram,  // SOCK_DGRAM
+        SeqPacket  // SOCK_SEQPACKET (connection oriented, reliable, ordered)
+    };
+
+    protected:
+
+    std::unique_ptr<Socket>        socket_;
+    std::string                    path_;
+    Mode                           mode_;
+    BufferPool::Bytes              buffer_; // from the service buffer pool
+    BufferPool::Bytes::iterator    bufferBegin_;
+    BufferPool::Bytes::iterator    bufferEnd_;
+
+    UnixDatagramStream(AsyncService::Ptr service,
+                       const std::string& path,
+                       Mode mode,
+                       std::size_t bufferSize);
+
+    std::size_t read_buffered(std::size_t bufferSize, uint8_t* buffer);
+    // Static : the stream is only used if the token is still valid.
+    static void receive_continue(UnixDatagramStream* stream,
+                                 HandlerTokenPtr token,
+                                 std::size_t bufferSize,
+                                 uint8_t* buffer,
+                                 Callback callback,
+                                 const ErrorCode& err,
+                                 std::size_t received);
+    static void receive_direct_continue(Mode mode,
+                                        Callback callback,
+                                        const ErrorCode& err,
+                                        std::size_t received);
+
+    public:
+
+    ~UnixDatagramStream();
+
+    static Ptr Create(AsyncService::Ptr service,
+                      const std::string& path,
+                      Mode mode = SeqPacket,
+                      std::size_t bufferSize = 65536);
+
+    const std::string& path() const { return path_; }
+    Mode mode() const { return mode_; }
+    std::size_t available() const { return bufferEnd_ - bufferBegin_; }
+
+    void close();
+    void reset();
+    void flush();
+    bool is_open() const;
+    bool cancel();
+
+    void async_read_some(std::size_t bufferSize,
+                         uint8_t*    buffer,
+                         Callback    callback);
+    void async_write_some(std::size_t    count,
+                          const uint8_t* data,
+                          Callback       callback);
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_UNIX_DATAGRAM_STREAM_H_
@@ -0,0 +1,102 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_UNIX_STREAM_H_
+#define _DEF_RTAC_ASIO_UNIX_STREAM_H_
+
+#include <memory>
+
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Connection to a Unix domain stream socket (SOCK_STREAM).
+ *
+ * This is the local equivalent of TCPClientStream for processes running on
+ * the same host. Connection to a local socket does not wait on the network,
+ * so the connection is done synchronously in the constructor and in reset().
+ */
+class UnixStream : public StreamInterface
+{
+    public:
+
+    using Ptr      = std::shared_ptr<UnixStream>;
+    using ConstPtr = std::shared_ptr<const UnixStream>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+    using Callback  = StreamInterface::Callback;
+
+    using Socket   = boost::asio::local::stream_protocol::socket;
+    using EndPoint = boost::asio::local::stream_protocol::endpoint;
+
+    protected:
+
+    std::unique_ptr<Socket> socket_;
+    EndPoint                remote_;
+
+    UnixStream(AsyncService::Ptr service, const std::string& path);
+    UnixStream(AsyncService::Ptr service, int nativeSocket);
+
+    public:
+
+    ~UnixStream();
+
+    static Ptr Create(AsyncService::Ptr service, const std::string& path);
+    // Takes ownership of an already connected socket (from socketpair for
+    // example). Such a stream cannot be reconnected : reset() closes it.
+    static Ptr Create(AsyncService::Ptr service, int nativeSocket);
+
+    const EndPoint& remote() const { return remote_; }
+
+    void close();
+    void reset(const EndPoint& remote);
+    void reset();
+    void flush();
+    bool is_open() const;
+    bool cancel();
+    int  native_fd() const;
+
+    void async_read_some(std::size_t bufferSize,
+                         uint8_t*    buffer,
+                         Callback    callback);
+    std::size_t try_read_some(std::size_t bufferSize,
+                              uint8_t*    buffer,
+                              ErrorCode&  err);
+    void async_write_some(std::size_t    count,
+                          const uint8_t* data,
+                          Callback       callback);
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_UNIX_STREAM_H_
@@ -0,0 +1,169 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_URING_QUEUE_H_
+#define _DEF_RTAC_ASIO_URING_QUEUE_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace rtac { namespace asio {
+
+/**
+ * Linux io_uring submission queue driven by an io_service.
+ *
+ * With the reactor (epoll) backend of boost::asio, a read or write which
+ * cannot complete right away costs a readiness notification and then a
+ * separate read or write syscall. Reads and writes submitted to this queue
+ * are performed by the kernel : the operations submitted during one handler
+ * batch are given to the kernel with a single io_uring_enter call from the
+ * io_service thread. Operations completed during this call are handled
+ * right away, the others are signaled to the io_service by an eventfd.
+ *
+ * Files (sockets) can be registered once (fixed files) to avoid a file
+ * table lookup on each operation, and a memory range can be registered
+ * (fixed buffer) so that operations on buffers inside it are not mapped by
+ * the kernel each time. The AsyncService registers the arena of its
+ * BufferPool.
+ *
+ * Submissions are accepted from any thread. Callbacks are called from the
+ * io_service thread, without any lock held. Used through AsyncService::uring()
+ * when the service is created with the IoUring backend. The operations still
+ * in flight are cancelled and waited for at destruction.
+ */
+class UringQueue
+{
+    public:
+
+    using ErrorCode = boost::system::error_code;
+    using Callback  = std::function<void(const ErrorCode&, std::size_t)>;
+
+    struct Stats
+    {
+        uint64_t submitted    = 0; // read and write operations
+        uint64_t completed    = 0;
+        uint64_t enters       = 0; // io_uring_enter syscalls
+        uint64_t wakeups      = 0; // completion notifications (eventfd reads)
+        uint64_t fixedFiles   = 0; // operations on a registered file
+        uint64_t fixedBuffers = 0; // operations on the registered buffer
+    };
+
+    protected:
+
+    struct Operation {
+        int      fd;
+        Callback callback;
+        bool     read;
+    };
+
+    boost::asio::io_service& service_;
+    int ringFd_;
+
+    // rings shared with the kernel
+    void*        sqRing_;
+    std::size_t  sqRingSize_;
+    void*        cqRing_;
+    std::size_t  cqRingSize_;
+    io_uring_sqe* sqes_;
+    std::size_t  sqesSize_;
+    unsigned*    sqHead_;
+    unsigned*    sqTail_;
+    unsigned*    sqArray_;
+    unsigned     sqMask_;
+    unsigned     sqEntries_;
+    unsigned*    cqHead_;
+    unsigned*    cqTail_;
+    unsigned     cqMask_;
+    io_uring_cqe* cqes_;
+
+    boost::asio::posix::stream_descriptor eventFd_;
+    uint64_t                              eventValue_;
+
+    std::unordered_map<uint64_t, Operation> operations_; // by user_data
+    uint64_t                                nextId_;
+    unsigned int                            pending_; // queued, not submitted
+    bool                                    flushPosted_;
+
+    std::vector<int>             files_;     // registered fd of each slot
+    std::unordered_map<int, int> fileSlots_; // slot of each registered fd
+    uint8_t*                     fixedBuffer_;
+    std::size_t                  fixedBufferSize_;
+
+    Stats              stats_;
+    mutable std::mutex mutex_;
+
+    void map_rings(unsigned int entries);
+    void unmap_rings();
+    void setup_files(unsigned int fileSlots);
+
+    io_uring_sqe* get_sqe();
+    void queue(uint8_t opcode, int fd, const uint8_t* buffer, std::size_t size,
+               const Callback& callback);
+    void submit();
+    void flush();
+    void wait_completions();
+    void completions_ready(const ErrorCode& err);
+    void reap();
+    void drain();
+
+    public:
+
+    UringQueue(boost::asio::io_service& service,
+               unsigned int entries   = 256,
+               unsigned int fileSlots = 1024);
+    ~UringQueue();
+
+    static bool is_supported();
+
+    bool register_buffer(uint8_t* data, std::size_t size);
+    bool register_file(int fd);
+    void unregister_file(int fd);
+
+    void async_read_some(int fd, uint8_t* buffer, std::size_t size,
+                         const Callback& callback);
+    void async_write_some(int fd, const uint8_t* data, std::size_t size,
+                          const Callback& callback);
+    // Cancels all the operations on fd. They complete with operation_aborted.
+    void cancel(int fd);
+
+    Stats stats() const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_URING_QUEUE_H_
@@ -0,0 +1,121 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_WRITE_PACER_H_
+#define _DEF_RTAC_ASIO_WRITE_PACER_H_
+
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/TimerWheel.h>
+#include <rtac_asio/StreamStats.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Token bucket limiting the byte rate of the writes of a StreamWriter (see
+ * StreamWriter::enable_pacing).
+ *
+ * The bucket holds at most burst bytes and is refilled at rate bytes per
+ * second. A write on the stream is limited to the bytes available in the
+ * bucket. When the bucket is empty, the write is started again by the
+ * timer wheel of the service once enough bytes are available (the whole
+ * write or a full burst), so no thread is blocked or spinning while a
+ * write is delayed. The timer wheel has a 1ms resolution and each delay is
+ * rounded up : the burst should hold several milliseconds of data (rate /
+ * 1000 bytes per millisecond), a smaller burst lowers the effective rate.
+ *
+ * Only one write may be in progress at a time (the StreamWriter and its
+ * WriteScheduler already ensure this).
+ */
+class WritePacer : public std::enable_shared_from_this<WritePacer>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<WritePacer>;
+    using ConstPtr = std::shared_ptr<const WritePacer>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+    using Callback  = StreamInterface::Callback;
+    using Clock     = std::chrono::steady_clock;
+
+    protected:
+
+    StreamInterface::Ptr stream_;
+    double               rate_;   // bytes per second
+    double               burst_;  // bucket size (bytes)
+    double               tokens_; // bytes available
+    Clock::time_point    refilled_;
+
+    // write delayed until the bucket is refilled
+    TimerWheel::Handle timer_;
+    bool               waiting_;
+    unsigned int       waitId_; // ignores a timer expired before a cancel
+    Callback           waitingCallback_;
+    Clock::time_point  delayStart_;
+
+    OperationCounters::Ptr counters_; // counters of the owning StreamWriter
+    mutable std::mutex     mutex_;
+
+    WritePacer(StreamInterface::Ptr stream, double bytesPerSecond,
+               std::size_t burst, OperationCounters::Ptr counters);
+
+    void refill(const Clock::time_point& now);
+    void start_write(std::size_t count, const uint8_t* data,
+                     Callback callback, unsigned int waitId);
+    void write_continue(std::size_t granted, Callback callback,
+                        const ErrorCode& err, std::size_t writtenCount);
+
+    public:
+
+    static Ptr Create(StreamInterface::Ptr stream, double bytesPerSecond,
+                      std::size_t burst, OperationCounters::Ptr counters = nullptr);
+
+    double      rate()  const { return rate_; }
+    std::size_t burst() const { return burst_; }
+    std::size_t available() const;
+
+    void set_rate(double bytesPerSecond, std::size_t burst);
+
+    // Same semantics as StreamInterface::async_write_some.
+    void async_write_some(std::size_t count, const uint8_t* data, Callback callback);
+
+    /**
+     * Aborts a write waiting for the bucket (its callback is posted with
+     * operation_aborted). Returns false if no write was waiting.
+     */
+    bool cancel();
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_WRITE_PACER_H_
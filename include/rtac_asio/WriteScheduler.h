@@ -0,0 +1,174 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_WRITE_SCHEDULER_H_
+#define _DEF_RTAC_ASIO_WRITE_SCHEDULER_H_
+
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <fstream>
+
+#include <rtac_asio/AsyncService.h>
+#include <rtac_asio/StreamInterface.h>
+#include <rtac_asio/TimerWheel.h>
+#include <rtac_asio/StreamStats.h>
+#include <rtac_asio/WritePacer.h>
+
+namespace rtac { namespace asio {
+
+/**
+ * Scheduled write mode of the StreamWriter (see
+ * StreamWriter::enable_scheduled_writes).
+ *
+ * Writes are queued in priority classes (0 is the most urgent) instead of
+ * being refused while another write is in progress. They are written on
+ * the stream in slices of at most sliceSize bytes and the next slice is
+ * chosen after each slice, so an urgent write waits for at most one slice
+ * of a large write (sliceSize / bitrate on a serial line).
+ *
+ * Slices of different writes are interleaved on the stream (a slice
+ * partially written by the stream is completed before switching) : sliceSize
+ * should be a multiple of the record size of the device protocol (for
+ * example a firmware block). A sliceSize of 0 never splits a write,
+ * urgent writes then only overtake the writes not started yet.
+ *
+ * With the StrictPriority policy, a class is only served when all the more
+ * urgent classes are empty. With the WeightedFair policy, the non-empty
+ * classes share the stream in proportion of their weights (in bytes), which
+ * bounds the latency of every class without starving the bulk ones.
+ * Within a class, writes are served in order.
+ */
+class WriteScheduler : public std::enable_shared_from_this<WriteScheduler>
+{
+    public:
+
+    using Ptr      = std::shared_ptr<WriteScheduler>;
+    using ConstPtr = std::shared_ptr<const WriteScheduler>;
+
+    using ErrorCode = StreamInterface::ErrorCode;
+    using Callback  = StreamInterface::Callback;
+
+    enum Policy {
+        StrictPriority,
+        WeightedFair,
+    };
+
+    struct Parameters
+    {
+        Policy                    policy;
+        std::size_t               sliceSize;       // 0 : writes are not split
+        std::vector<unsigned int> weights;         // one per class (WeightedFair)
+        unsigned int              defaultPriority; // of the writes without priority
+        std::size_t               maxQueued;       // per class
+
+        Parameters(Policy policy = StrictPriority,
+                   std::size_t sliceSize = 256,
+                   const std::vector<unsigned int>& weights = {16, 4, 1},
+                   unsigned int defaultPriority = 1,
+                   std::size_t maxQueued = 64) :
+            policy(policy),
+            sliceSize(sliceSize),
+            weights(weights),
+            defaultPriority(defaultPriority),
+            maxQueued(maxQueued)
+        {}
+    };
+
+    protected:
+
+    struct Request {
+        unsigned int       id;
+        std::size_t        size;
+        const uint8_t*     data;
+        Callback           callback;
+        bool               exact; // async_write (true) or async_write_some
+        std::size_t        processed;
+        TimerWheel::Handle timeout;
+        bool               timedOut;
+        OperationCounters::Clock::time_point start;
+    };
+
+    StreamInterface::Ptr             stream_;
+    Parameters                       parameters_;
+    std::vector<std::deque<Request>> classes_;
+    std::vector<double>              virtualTime_; // WeightedFair bytes/weight
+    double                           systemTime_;
+    unsigned int                     requestCounter_;
+
+    bool         writing_;  // a slice is being written
+    unsigned int current_;  // class of the slice being written
+    std::size_t  sliceLeft_; // bytes of the current slice not written yet
+    bool         stopped_;
+
+    std::ofstream*         txDump_;   // of the owning StreamWriter, nullptr once stopped
+    OperationCounters::Ptr counters_; // counters of the owning StreamWriter
+    WritePacer::Ptr        pacer_;    // rate limit of the owning StreamWriter
+    mutable std::mutex     mutex_;
+
+    WriteScheduler(StreamInterface::Ptr stream, const Parameters& params,
+                   std::ofstream* txDump, OperationCounters::Ptr counters);
+
+    std::function<void()> completion(const Request& request, const ErrorCode& err);
+    void complete_front(unsigned int priority, const ErrorCode& err);
+
+    int  next_class() const;
+    void start_write();
+    void write_continue(const ErrorCode& err, std::size_t writtenCount);
+    void timeout_reached(unsigned int priority, unsigned int id);
+
+    public:
+
+    static Ptr Create(StreamInterface::Ptr stream,
+                      const Parameters& params = Parameters(),
+                      std::ofstream* txDump = nullptr,
+                      OperationCounters::Ptr counters = nullptr);
+
+    const Parameters& parameters() const { return parameters_; }
+    unsigned int class_count() const { return classes_.size(); }
+
+    // priorities beyond the last class are queued in the last class.
+    bool async_write(std::size_t count, const uint8_t* data, Callback callback,
+                     bool exact, unsigned int priority,
+                     unsigned int timeoutMillis = 0);
+
+    // Slices are written through the pacer if not null.
+    void set_pacer(WritePacer::Ptr pacer);
+
+    // Aborts the queued writes. A slice being written completes.
+    void stop();
+
+    std::size_t queued() const;
+    std::size_t queued(unsigned int priority) const;
+};
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_WRITE_SCHEDULER_H_
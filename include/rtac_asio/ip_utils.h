@@ -30,11 +30,96 @@
 #define _DEF_RTAC_ASIO_IP_UTILS_H_
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
 #include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <rtac_asio/AsyncService.h>
 
 namespace rtac { namespace asio {
 
 boost::asio::ip::address make_address(const std::string& ipStr);
+bool parse_address(const std::string& ipStr, boost::asio::ip::address& address);
+
+/**
+ * Asynchronous host name resolution with a TTL cache.
+ *
+ * Resolution is done with the boost::asio resolver (getaddrinfo in a
+ * background thread), so no AsyncService thread is ever blocked. Resolved
+ * addresses are kept for ttl milliseconds. Concurrent requests for the same
+ * host are merged into a single lookup.
+ *
+ * The lookups run on an AsyncService owned by the Resolver (started on the
+ * first lookup), so that a lookup shared by several callers does not depend
+ * on the service of one of them. The callbacks are posted on the service of
+ * each caller. Callers still waiting when the Resolver is destroyed receive
+ * boost::asio::error::operation_aborted.
+ *
+ * Numeric addresses are returned directly without any lookup.
+ *
+ * Resolver::Default() is shared by all streams of the process.
+ */
+class Resolver
+{
+    public:
+
+    using Ptr      = std::shared_ptr<Resolver>;
+    using ConstPtr = std::shared_ptr<const Resolver>;
+
+    using ErrorCode   = boost::system::error_code;
+    using Address     = boost::asio::ip::address;
+    using AddressList = std::vector<Address>;
+    using Clock       = std::chrono::steady_clock;
+    using Callback    = std::function<void(const ErrorCode&, const AddressList&)>;
+
+    protected:
+
+    struct Entry {
+        AddressList       addresses;
+        Clock::time_point expiration;
+    };
+    struct Waiter {
+        AsyncService::Ptr service;
+        Callback          callback;
+    };
+
+    // Shared with the lookups in progress, which may complete after the
+    // Resolver was destroyed.
+    struct State {
+        std::chrono::milliseconds ttl;
+        std::unordered_map<std::string, Entry>               cache;
+        std::unordered_map<std::string, std::vector<Waiter>> pending;
+        mutable std::mutex                                   mutex;
+    };
+    using StatePtr = std::shared_ptr<State>;
+
+    StatePtr          state_;
+    AsyncService::Ptr service_; // runs the lookups
+
+    Resolver(unsigned int ttlMillis);
+
+    static void resolve_continue(const StatePtr& state, const std::string& host,
+                                 const ErrorCode& err, const AddressList& addresses);
+
+    public:
+
+    static Ptr Create(unsigned int ttlMillis = 60000);
+    static Ptr Default();
+    ~Resolver();
+
+    void set_ttl(unsigned int ttlMillis);
+    unsigned int ttl() const;
+    void clear();
+
+    bool lookup(const std::string& host, AddressList& addresses) const;
+    void async_resolve(AsyncService::Ptr service, const std::string& host,
+                       const Callback& callback);
+};
 
 } //namespace asio
 } //namespace rtac
@@ -0,0 +1,69 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_SERIAL_UTILS_H_
+#define _DEF_RTAC_ASIO_SERIAL_UTILS_H_
+
+#include <string>
+#include <cstdint>
+
+#include <boost/system/error_code.hpp>
+
+namespace rtac { namespace asio {
+
+/**
+ * Low level serial port settings which are not covered by the
+ * boost::asio::serial_port options. These are Linux specific and return
+ * boost::asio::error::operation_not_supported on other platforms.
+ *
+ * All functions operate on an open tty file descriptor.
+ */
+
+// raw mode (no line discipline, translation nor echo) with the given VMIN /
+// VTIME read settings. Unlike cfmakeraw, the character size, parity, stop
+// bits and software flow control settings are left untouched.
+boost::system::error_code set_raw_mode(int fd, uint8_t vmin, uint8_t vtime);
+
+// Sets the ASYNC_LOW_LATENCY flag through TIOCSSERIAL. For FTDI based
+// adapters this also sets the latency timer to 1ms.
+boost::system::error_code set_low_latency(int fd, bool enable);
+bool low_latency_enabled(int fd);
+
+// Sets the latency_timer sysfs attribute of an usb-serial device (FTDI).
+// device is the path of the tty (/dev/ttyUSB0).
+boost::system::error_code set_usb_latency_timer(const std::string& device,
+                                                unsigned int millis);
+
+// Arbitrary baudrate through termios2 / BOTHER.
+boost::system::error_code set_custom_baudrate(int fd, unsigned int baudrate);
+boost::system::error_code get_baudrate(int fd, unsigned int& baudrate);
+
+} //namespace asio
+} //namespace rtac
+
+#endif //_DEF_RTAC_ASIO_SERIAL_UTILS_H_
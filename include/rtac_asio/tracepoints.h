@@ -0,0 +1,68 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _DEF_RTAC_ASIO_TRACEPOINTS_H_
+#define _DEF_RTAC_ASIO_TRACEPOINTS_H_
+
+/**
+ * Static tracepoints (USDT probes) of the rtac_asio library.
+ *
+ * The probes are compiled in only when the library is configured with
+ * -DWITH_USDT_PROBES=ON (needs sys/sdt.h, from systemtap-sdt-dev). An
+ * inactive probe is a single nop instruction. Otherwise RTAC_ASIO_TRACE
+ * expands to nothing and its arguments are not evaluated.
+ *
+ * Probes (provider rtac_asio) and their arguments :
+ * - read_start      (stream, read id, requested size)
+ * - read_done       (stream, read id, processed bytes, error value)
+ * - read_timeout    (stream, read id)
+ * - write_start     (stream, write id, requested size)
+ * - write_done      (stream, write id, processed bytes, error value)
+ * - write_timeout   (stream, write id)
+ * - queued_timeout  (stream, queued read id)
+ * - transport_submit   (stream, direction (0 rx, 1 tx), sequence, buffer size)
+ * - transport_complete (stream, direction, sequence, bytes, error value)
+ * - service_post    (service, source, operation string)
+ *
+ * stream is the address of the StreamInterface. The read and write ids are
+ * the ones of StreamReader and StreamWriter, the transport sequence number
+ * counts the submitted operations in each direction. Since a stream has at
+ * most one read and one write in progress, the submissions between a
+ * read_start and its read_done belong to this read.
+ *
+ * Example :
+ *   bpftrace -e 'usdt:librtac_asio.so:rtac_asio:read_done { @[arg2] = count(); }'
+ */
+#ifdef RTAC_ASIO_USDT
+    #include <sys/sdt.h>
+    #define RTAC_ASIO_TRACE(name, ...) STAP_PROBEV(rtac_asio, name, __VA_ARGS__)
+#else
+    #define RTAC_ASIO_TRACE(name, ...) do {} while(0)
+#endif
+
+#endif //_DEF_RTAC_ASIO_TRACEPOINTS_H_
@@ -27,19 +27,44 @@
 
 
 #include <rtac_asio/AsyncService.h>
+#include <rtac_asio/TimerWheel.h>
+#include <rtac_asio/UringQueue.h>
+#include <rtac_asio/tracepoints.h>
 #include <functional>
+#include <algorithm>
+#include <cstring>
+
+#include <pthread.h>
 
 namespace rtac { namespace asio {
 
-AsyncService::AsyncService() :
+AsyncService::AsyncService(const BufferPool::Parameters& poolParams, Backend backend) :
+    bufferPool_(BufferPool::Create(poolParams)),
     thread_(nullptr),
     isRunning_(false),
-    timer_(service_)
-{}
+    timer_(service_),
+    timerWheel_(std::make_unique<TimerWheel>(service_)),
+    busyPoll_(false),
+    cpu_(-1),
+    maxInlineDepth_(8),
+    monitoring_(false),
+    probe_(service_),
+    probePeriod_(100)
+{
+    if(backend == IoUring) {
+        uring_ = std::make_unique<UringQueue>(service_);
+        if(bufferPool_->arena()) {
+            // the internal buffers of the streams are fixed buffers.
+            uring_->register_buffer(bufferPool_->arena(), bufferPool_->arena_size());
+        }
+    }
+}
 
 AsyncService::~AsyncService()
 {
     this->stop();
+    timerWheel_ = nullptr; // must be destroyed before service_
+    uring_      = nullptr;
 }
 
 void AsyncService::timer_callback(const ErrorCode& err) const
@@ -57,19 +82,30 @@ void AsyncService::run()
             return;
         }
         isRunning_ = true;
+        // Restarted before start() returns, so that a stop() called right
+        // after start() is not undone here.
+        //service_.reset(); // deprecated
+        service_.restart();
         waiterWasNotified_ = true;
         //lock.unlock(); // ?
         waitStart_.notify_one();
     }
     try {
-        //service_.reset(); // deprecated
-        service_.restart();
-
         // Giving work to the service to prevent it from stopping right away
         timer_.cancel();
         this->timer_callback(ErrorCode());
 
-        service_.run();
+        this->pin_thread();
+        if(busyPoll_) {
+            while(!service_.stopped()) {
+                if(service_.poll() == 0) {
+                    spin_pause();
+                }
+            }
+        }
+        else {
+            service_.run();
+        }
     }
     catch(...) {
         // This ensures isRunning_ is set to false if service::run() throws an
@@ -82,6 +118,36 @@ void AsyncService::run()
     }
 }
 
+void AsyncService::pin_thread() const
+{
+    if(cpu_ < 0) {
+        return;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu_, &cpus);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if(err != 0) {
+        std::cerr << "rtac::asio::AsyncService : could not pin thread to core "
+                  << cpu_ << " (" << std::strerror(err) << ")." << std::endl;
+    }
+}
+
+void AsyncService::set_busy_poll(bool enable, int cpu)
+{
+    bool restart = false;
+    {
+        std::lock_guard<std::mutex> lock(startMutex_);
+        busyPoll_ = enable;
+        cpu_      = cpu;
+        restart   = thread_ && isRunning_;
+    }
+    if(restart) {
+        this->stop();
+        this->start();
+    }
+}
+
 bool AsyncService::is_running() const
 {
     //std::lock_guard<std::mutex> lock(startMutex_); // necessary ?
@@ -132,9 +198,85 @@ void AsyncService::stop()
     thread_ = nullptr;
 }
 
-void AsyncService::post(const std::function<void()>& function)
+void AsyncService::post(const std::function<void()>& function, const PostTag& tag)
 {
-    boost::asio::post(service_, function);
+    RTAC_ASIO_TRACE(service_post, this, tag.source, tag.operation);
+    if(monitoring_.load(std::memory_order_relaxed)) {
+        boost::asio::post(service_, monitor_.wrap(function, tag));
+    }
+    else {
+        boost::asio::post(service_, function);
+    }
+}
+
+namespace {
+
+// Inline handlers currently nested on this thread (see AsyncService::dispatch).
+thread_local unsigned int inlineDepth = 0;
+
+struct InlineScope
+{
+    InlineScope()  { inlineDepth++; }
+    ~InlineScope() { inlineDepth--; }
+};
+
+} //namespace
+
+void AsyncService::dispatch(const std::function<void()>& function, const PostTag& tag)
+{
+    if(inlineDepth >= maxInlineDepth_
+       || !service_.get_executor().running_in_this_thread())
+    {
+        this->post(function, tag);
+        return;
+    }
+    InlineScope scope;
+    if(monitoring_.load(std::memory_order_relaxed)) {
+        monitor_.wrap(function, tag)();
+    }
+    else {
+        function();
+    }
+}
+
+void AsyncService::enable_monitoring(unsigned int topN, unsigned int probeMillis)
+{
+    monitor_.set_top_n(topN);
+    probePeriod_ = Millis(std::max(probeMillis, 1u));
+    if(!monitoring_.exchange(true)) {
+        // the probe timer is only handled from the service thread.
+        boost::asio::post(service_, std::bind(&AsyncService::arm_probe, this));
+    }
+}
+
+void AsyncService::disable_monitoring()
+{
+    if(monitoring_.exchange(false)) {
+        boost::asio::post(service_, [this]() {
+            ErrorCode err;
+            probe_.cancel(err);
+        });
+    }
+}
+
+void AsyncService::arm_probe()
+{
+    if(!monitoring_) {
+        return;
+    }
+    probeExpected_ = Timer::clock_type::now() + probePeriod_;
+    probe_.expires_at(probeExpected_);
+    probe_.async_wait(std::bind(&AsyncService::probe_callback, this,
+                                std::placeholders::_1));
+}
+
+void AsyncService::probe_callback(const ErrorCode& err)
+{
+    if(err) {
+        return;
+    }
+    monitor_.record_loop_lag(Timer::clock_type::now() - probeExpected_);
+    this->arm_probe();
 }
 
 } //namespace asio
@@ -0,0 +1,459 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/Bridge.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <time.h>
+
+#include <iostream>
+
+#include <boost/asio/error.hpp>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+namespace {
+
+Bridge::ErrorCode errno_code()
+{
+    return Bridge::ErrorCode(errno, boost::asio::error::get_system_category());
+}
+
+bool is_socket(int fd)
+{
+    struct stat st;
+    return ::fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+/**
+ * splice() to a socket closed by its peer raises SIGPIPE (there is no
+ * MSG_NOSIGNAL equivalent). The signal is blocked in this thread while the
+ * guard lives, and a SIGPIPE raised meanwhile is consumed.
+ */
+class SigPipeGuard
+{
+    sigset_t set_;
+    sigset_t old_;
+    bool     wasPending_;
+
+    public:
+
+    SigPipeGuard() {
+        sigemptyset(&set_);
+        sigaddset(&set_, SIGPIPE);
+        sigset_t pending;
+        sigpending(&pending);
+        wasPending_ = sigismember(&pending, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &set_, &old_);
+    }
+    ~SigPipeGuard() {
+        if(!wasPending_) {
+            sigset_t pending;
+            sigpending(&pending);
+            if(sigismember(&pending, SIGPIPE)) {
+                timespec zero{0, 0};
+                int savedErrno = errno;
+                sigtimedwait(&set_, nullptr, &zero);
+                errno = savedErrno;
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &old_, nullptr);
+    }
+};
+
+// Moves at most this number of chunks before yielding the service thread
+// to the other handlers.
+constexpr unsigned int MaxChunksPerHandler = 16;
+
+} //namespace
+
+Bridge::Direction::Direction(StreamInterface::Ptr src, StreamInterface::Ptr dst) :
+    src(src),
+    dst(dst),
+    pipe{-1, -1},
+    inPipe(0),
+    dstSocket(false),
+    pending(0),
+    written(0),
+    eof(false)
+{}
+
+Bridge::Direction::~Direction()
+{
+    if(pipe[0] >= 0) ::close(pipe[0]);
+    if(pipe[1] >= 0) ::close(pipe[1]);
+}
+
+Bridge::Bridge(StreamInterface::Ptr first, StreamInterface::Ptr second,
+               const Parameters& params) :
+    service_(first->service()),
+    parameters_(params),
+    forward_(first, second),
+    backward_(second, first),
+    started_(false),
+    closed_(false)
+{
+    if(parameters_.chunkSize == 0) {
+        throw std::runtime_error("rtac::asio::Bridge : chunkSize must not be 0.");
+    }
+}
+
+Bridge::~Bridge()
+{
+    // Descriptors are closed by the Direction destructors. No handler is
+    // pending since they all hold a reference on the bridge.
+}
+
+Bridge::Ptr Bridge::Create(StreamInterface::Ptr first, StreamInterface::Ptr second,
+                           const Parameters& params)
+{
+    return Ptr(new Bridge(first, second, params));
+}
+
+void Bridge::set_closed_callback(const ClosedCallback& callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    closedCallback_ = callback;
+}
+
+Bridge::Stats Bridge::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats res;
+    res.forward  = forward_.stats;
+    res.backward = backward_.stats;
+    return res;
+}
+
+bool Bridge::is_closed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+void Bridge::record(Direction& d, std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    d.stats.bytes += count;
+    d.stats.transfers++;
+}
+
+/**
+ * Duplicates the stream descriptors to wait on their readiness and creates
+ * the pipe. Returns false if the direction must use the buffered mode.
+ */
+bool Bridge::setup_splice(Direction& d)
+{
+    int srcFd = d.src->native_fd();
+    int dstFd = d.dst->native_fd();
+    if(!parameters_.zeroCopy || srcFd < 0 || dstFd < 0) {
+        return false;
+    }
+    if(::pipe2(d.pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        std::cerr << "rtac::asio::Bridge : could not create a pipe ("
+                  << errno_code().message() << "), using buffered mode." << std::endl;
+        d.pipe[0] = d.pipe[1] = -1;
+        return false;
+    }
+    // best effort, the default pipe size is 64kB.
+    ::fcntl(d.pipe[1], F_SETPIPE_SZ, (int)parameters_.chunkSize);
+
+    int srcDup = ::fcntl(srcFd, F_DUPFD_CLOEXEC, 0);
+    int dstDup = ::fcntl(dstFd, F_DUPFD_CLOEXEC, 0);
+    if(srcDup < 0 || dstDup < 0) {
+        if(srcDup >= 0) ::close(srcDup);
+        if(dstDup >= 0) ::close(dstDup);
+        return false;
+    }
+    // The file status flags are shared with the stream descriptors, which
+    // the asio operations already expect to be non blocking.
+    ::fcntl(srcDup, F_SETFL, ::fcntl(srcDup, F_GETFL) | O_NONBLOCK);
+    ::fcntl(dstDup, F_SETFL, ::fcntl(dstDup, F_GETFL) | O_NONBLOCK);
+    d.srcWait   = std::make_unique<Descriptor>(service_->service(), srcDup);
+    d.dstWait   = std::make_unique<Descriptor>(service_->service(), dstDup);
+    d.dstSocket = is_socket(dstFd);
+    return true;
+}
+
+void Bridge::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(started_ || closed_) {
+            return;
+        }
+        started_ = true;
+    }
+    this->start_direction(forward_);
+    this->start_direction(backward_);
+}
+
+void Bridge::start_direction(Direction& d)
+{
+    if(this->setup_splice(d)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            d.stats.mode = Splice;
+        }
+        service_->post(std::bind(&Bridge::splice_pump, this->shared_from_this(), &d),
+                       PostTag(this, "bridge"));
+    }
+    else {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            d.stats.mode = Buffered;
+        }
+        d.buffer.resize(parameters_.chunkSize);
+        this->buffered_read(&d);
+    }
+}
+
+void Bridge::stop()
+{
+    this->close(boost::asio::error::operation_aborted);
+}
+
+/**
+ * Called from the service thread only.
+ */
+void Bridge::splice_pump(Direction* d)
+{
+    const unsigned int flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+    std::unique_ptr<SigPipeGuard> guard;
+    if(d->dstSocket) {
+        guard = std::make_unique<SigPipeGuard>();
+    }
+    for(unsigned int chunks = 0; chunks < MaxChunksPerHandler; ) {
+        if(this->is_closed()) {
+            return;
+        }
+        if(d->inPipe > 0) {
+            ssize_t count = ::splice(d->pipe[0], nullptr, d->dstWait->native_handle(),
+                                     nullptr, d->inPipe, flags);
+            if(count > 0) {
+                d->inPipe -= count;
+                this->record(*d, count);
+                chunks++;
+                continue;
+            }
+            if(count < 0 && errno == EINTR) {
+                continue;
+            }
+            if(count < 0 && errno == EAGAIN) {
+                d->dstWait->async_wait(Descriptor::wait_write,
+                    std::bind(&Bridge::splice_ready, this->shared_from_this(), d, _1));
+                return;
+            }
+            this->close(count < 0 ? errno_code() : ErrorCode(boost::asio::error::eof));
+            return;
+        }
+        if(d->eof) {
+            this->direction_ended(d);
+            return;
+        }
+        // The pipe is empty : the source is read only once the previous
+        // chunk was written (backpressure).
+        ssize_t count = ::splice(d->srcWait->native_handle(), nullptr, d->pipe[1],
+                                 nullptr, parameters_.chunkSize, flags);
+        if(count > 0) {
+            d->inPipe = count;
+            continue;
+        }
+        if(count == 0) {
+            d->eof = true;
+            continue;
+        }
+        if(errno == EINTR) {
+            continue;
+        }
+        if(errno == EAGAIN) {
+            d->srcWait->async_wait(Descriptor::wait_read,
+                std::bind(&Bridge::splice_ready, this->shared_from_this(), d, _1));
+            return;
+        }
+        if(errno == EINVAL && d->stats.bytes == 0) {
+            // The device does not support splice (some ttys).
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                d->stats.mode = Buffered;
+            }
+            d->buffer.resize(parameters_.chunkSize);
+            this->buffered_read(d);
+            return;
+        }
+        this->close(errno_code());
+        return;
+    }
+    // Continuous traffic, the other handlers of the service get a chance to
+    // run.
+    service_->post(std::bind(&Bridge::splice_pump, this->shared_from_this(), d),
+                   PostTag(this, "bridge"));
+}
+
+void Bridge::splice_ready(Direction* d, const ErrorCode& err)
+{
+    if(err) {
+        if(err != boost::asio::error::operation_aborted) {
+            this->close(err);
+        }
+        return;
+    }
+    this->splice_pump(d);
+}
+
+void Bridge::buffered_read(Direction* d)
+{
+    d->src->async_read_some(d->buffer.size(), d->buffer.data(),
+        std::bind(&Bridge::buffered_read_done, this->shared_from_this(), d, _1, _2));
+}
+
+void Bridge::buffered_read_done(Direction* d, const ErrorCode& err, std::size_t count)
+{
+    if(this->is_closed()) {
+        return;
+    }
+    if(count > 0) {
+        d->pending = count;
+        d->written = 0;
+        this->buffered_write(d);
+    }
+    else if(err == boost::asio::error::eof) {
+        d->eof = true;
+        this->direction_ended(d);
+    }
+    else if(!err || (err == boost::asio::error::operation_aborted
+                     && d->src->is_open()))
+    {
+        // cancelled by someone else, read again
+        this->buffered_read(d);
+    }
+    else {
+        this->close(err);
+    }
+}
+
+void Bridge::buffered_write(Direction* d)
+{
+    d->dst->async_write_some(d->pending - d->written, d->buffer.data() + d->written,
+        std::bind(&Bridge::buffered_write_done, this->shared_from_this(), d, _1, _2));
+}
+
+void Bridge::buffered_write_done(Direction* d, const ErrorCode& err, std::size_t count)
+{
+    if(this->is_closed()) {
+        return;
+    }
+    if(count > 0) {
+        d->written += count;
+        this->record(*d, count);
+    }
+    if(d->written >= d->pending) {
+        this->buffered_read(d);
+    }
+    else if(!err || (err == boost::asio::error::operation_aborted
+                     && d->dst->is_open()))
+    {
+        this->buffered_write(d);
+    }
+    else {
+        this->close(err);
+    }
+}
+
+/**
+ * End of stream on the source, all bytes were written on the destination.
+ */
+void Bridge::direction_ended(Direction* d)
+{
+    int dstFd = d->dst->native_fd();
+    if(dstFd >= 0 && is_socket(dstFd)) {
+        ::shutdown(dstFd, SHUT_WR);
+    }
+    bool both;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        d->stats.ended = true;
+        both = forward_.stats.ended && backward_.stats.ended;
+    }
+    if(both) {
+        this->close(ErrorCode());
+    }
+}
+
+void Bridge::close(const ErrorCode& err)
+{
+    ClosedCallback callback;
+    bool buffered;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(closed_) {
+            return;
+        }
+        closed_  = true;
+        callback = closedCallback_;
+        if(!started_) {
+            return;
+        }
+        buffered = forward_.stats.mode  == Buffered
+                || backward_.stats.mode == Buffered;
+    }
+    // The buffered operations end with operation_aborted.
+    if(buffered) {
+        forward_.src->cancel();
+        forward_.dst->cancel();
+    }
+    // The descriptors are only used from the service thread.
+    service_->post(std::bind(&Bridge::close_descriptors, this->shared_from_this(),
+                             err, callback),
+                   PostTag(this, "bridge"));
+}
+
+/**
+ * The duplicated descriptors are released so that they do not keep the
+ * devices open.
+ */
+void Bridge::close_descriptors(const ErrorCode& err, ClosedCallback callback)
+{
+    for(auto d : {&forward_, &backward_}) {
+        ErrorCode ignored;
+        if(d->srcWait) d->srcWait->close(ignored);
+        if(d->dstWait) d->dstWait->close(ignored);
+    }
+    if(callback) {
+        callback(err);
+    }
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,312 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/BroadcastGroup.h>
+
+#include <algorithm>
+
+#include <boost/asio/error.hpp>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+BroadcastGroup::BroadcastGroup(AsyncService::Ptr service, const Parameters& params) :
+    service_(service),
+    parameters_(params)
+{}
+
+BroadcastGroup::Ptr BroadcastGroup::Create(AsyncService::Ptr service,
+                                           const Parameters& params)
+{
+    return Ptr(new BroadcastGroup(service, params));
+}
+
+BroadcastGroup::Buffer BroadcastGroup::make_buffer(const uint8_t* data, std::size_t size)
+{
+    return std::make_shared<const std::vector<uint8_t>>(data, data + size);
+}
+
+BroadcastGroup::Buffer BroadcastGroup::make_buffer(std::vector<uint8_t>&& data)
+{
+    return std::make_shared<const std::vector<uint8_t>>(std::move(data));
+}
+
+bool BroadcastGroup::add(Stream::Ptr stream)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto& m : members_) {
+        if(m->stream == stream) {
+            return false;
+        }
+    }
+    auto member = std::make_shared<Member>();
+    member->stream = stream;
+    members_.push_back(member);
+    return true;
+}
+
+bool BroadcastGroup::remove(Stream::Ptr stream)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto& m : members_) {
+        if(m->stream == stream) {
+            auto member = m; // m is erased below
+            return this->remove_member(member);
+        }
+    }
+    return false;
+}
+
+std::size_t BroadcastGroup::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return members_.size();
+}
+
+void BroadcastGroup::set_removed_callback(const RemovedCallback& callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    removedCallback_ = callback;
+}
+
+BroadcastGroup::Stats BroadcastGroup::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+/**
+ * Must be called with mutex_ locked, once per member of the frame.
+ */
+void BroadcastGroup::frame_done(const FramePtr& frame)
+{
+    if(--frame->remaining > 0 || !frame->callback) {
+        return;
+    }
+    service_->post(std::bind(frame->callback, frame->result),
+                   PostTag(this, "broadcast"));
+}
+
+/**
+ * Must be called with mutex_ locked.
+ */
+void BroadcastGroup::drop(const FramePtr& frame)
+{
+    frame->result.dropped++;
+    stats_.dropped++;
+    this->frame_done(frame);
+}
+
+/**
+ * Removes the member from the group and drops its queued frames (the frame
+ * being written completes in write_done). Must be called with mutex_
+ * locked.
+ */
+bool BroadcastGroup::remove_member(const MemberPtr& member)
+{
+    auto it = std::find(members_.begin(), members_.end(), member);
+    if(it == members_.end()) {
+        return false;
+    }
+    members_.erase(it);
+    member->removed = true;
+    std::size_t keep = member->writing ? 1 : 0;
+    while(member->queue.size() > keep) {
+        this->drop(member->queue.back());
+        member->queue.pop_back();
+    }
+    return true;
+}
+
+/**
+ * Called without mutex_ locked.
+ */
+void BroadcastGroup::disconnect(const MemberPtr& member, const ErrorCode& err,
+                                bool close)
+{
+    RemovedCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(close) {
+            stats_.disconnected++;
+        }
+        callback = removedCallback_;
+    }
+    if(close) {
+        // aborts the write in progress, if any. Not reset(), which would
+        // reconnect the client streams.
+        member->stream->close();
+    }
+    if(callback) {
+        callback(member->stream, err);
+    }
+}
+
+std::size_t BroadcastGroup::broadcast(Buffer buffer, Callback callback)
+{
+    auto frame = std::make_shared<Frame>();
+    frame->buffer   = buffer;
+    frame->callback = callback;
+
+    std::vector<MemberPtr> toStart;
+    std::vector<MemberPtr> toDisconnect;
+    std::size_t submitted = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.frames++;
+        // +1 until all the members were handled, so that the callback is
+        // not called from the loop below.
+        frame->remaining = members_.size() + 1;
+        for(auto& member : members_) {
+            if(!member->writing) {
+                member->queue.push_back(frame);
+                member->writing = true;
+                toStart.push_back(member);
+                submitted++;
+                continue;
+            }
+            // The front of the queue is the frame being written.
+            if(member->queue.size() <= parameters_.maxQueued) {
+                member->queue.push_back(frame);
+                submitted++;
+                continue;
+            }
+            switch(parameters_.policy) {
+                default:
+                case Drop:
+                    this->drop(frame);
+                    break;
+                case DropOldest:
+                    if(member->queue.size() > 1) {
+                        this->drop(member->queue[1]);
+                        member->queue.erase(member->queue.begin() + 1);
+                        member->queue.push_back(frame);
+                        submitted++;
+                    }
+                    else {
+                        this->drop(frame);
+                    }
+                    break;
+                case Disconnect:
+                    this->drop(frame);
+                    toDisconnect.push_back(member);
+                    break;
+            }
+        }
+        for(auto& member : toDisconnect) {
+            this->remove_member(member);
+        }
+        this->frame_done(frame);
+    }
+
+    for(auto& member : toDisconnect) {
+        this->disconnect(member, boost::asio::error::no_buffer_space, true);
+    }
+    for(auto& member : toStart) {
+        this->start_write(member);
+    }
+    return submitted;
+}
+
+void BroadcastGroup::start_write(const MemberPtr& member)
+{
+    while(true) {
+        FramePtr frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(member->queue.size() == 0) {
+                member->writing = false;
+                return;
+            }
+            frame = member->queue.front();
+        }
+        // The frame (and its buffer) is kept alive by the callback, even if
+        // the member is removed and its queue dropped meanwhile.
+        if(member->stream->async_write(frame->buffer->size(), frame->buffer->data(),
+            std::bind(&BroadcastGroup::write_done, this->shared_from_this(),
+                      member, frame, _1, _2),
+            parameters_.timeoutMillis))
+        {
+            return;
+        }
+        // The writer of the member is used outside of the group. The frame
+        // is skipped.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(member->queue.size() > 0 && member->queue.front() == frame) {
+            this->drop(frame);
+            member->queue.pop_front();
+        }
+    }
+}
+
+void BroadcastGroup::write_done(MemberPtr member, FramePtr written,
+                                const ErrorCode& err, std::size_t count)
+{
+    bool failed = false;
+    bool removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(member->queue.size() == 0 || member->queue.front() != written) {
+            member->writing = false;
+            return;
+        }
+        member->queue.pop_front();
+        if(!err && count == written->buffer->size()) {
+            written->result.delivered++;
+            stats_.delivered++;
+        }
+        else {
+            written->result.failed++;
+            stats_.failed++;
+            failed = true;
+        }
+        this->frame_done(written);
+
+        removed = member->removed;
+        if(failed && !removed) {
+            this->remove_member(member);
+        }
+        if(failed || removed) {
+            member->writing = false;
+            while(member->queue.size() > 0) {
+                this->drop(member->queue.front());
+                member->queue.pop_front();
+            }
+        }
+    }
+    if(failed && !removed) {
+        this->disconnect(member, err ? err : ErrorCode(boost::asio::error::eof), false);
+    }
+    else if(!failed && !removed) {
+        this->start_write(member);
+    }
+}
+
+} //namespace asio
+} //namespace rtac
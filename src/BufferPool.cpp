@@ -0,0 +1,363 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/BufferPool.h>
+
+#include <iostream>
+#include <unordered_map>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+
+namespace rtac { namespace asio {
+
+namespace {
+
+std::atomic<uint64_t> poolCounter(0);
+
+// Pools alive, by id. A thread cache holding blocks of a destroyed pool drops
+// them without touching them.
+std::mutex                                 registryMutex;
+std::unordered_map<uint64_t, BufferPool*>  registry;
+
+constexpr std::size_t HugePageSize = 2*1024*1024;
+
+/**
+ * Free blocks kept by a thread for a single pool (the last one the thread
+ * used). Blocks are exchanged with the pool by batches of half the cache
+ * size.
+ */
+struct ThreadCache
+{
+    uint64_t     poolId   = 0;
+    unsigned int capacity = 0;
+    std::array<std::vector<void*>, BufferPool::MaxClasses> blocks;
+
+    ~ThreadCache() { this->flush(); }
+
+    void flush()
+    {
+        if(poolId == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto it = registry.find(poolId);
+        for(unsigned int c = 0; c < blocks.size(); c++) {
+            if(it != registry.end() && blocks[c].size() > 0) {
+                it->second->push_free(c, blocks[c].data(), blocks[c].size());
+            }
+            blocks[c].clear();
+        }
+        poolId = 0;
+    }
+
+    void attach(BufferPool* pool)
+    {
+        if(poolId == pool->id()) {
+            return;
+        }
+        this->flush();
+        poolId   = pool->id();
+        capacity = pool->parameters().threadCacheSize;
+        for(auto& b : blocks) {
+            b.reserve(capacity);
+        }
+    }
+};
+
+thread_local ThreadCache threadCache;
+
+} //namespace
+
+BufferPool::BufferPool(const Parameters& params) :
+    parameters_(params),
+    id_(++poolCounter),
+    minShift_(0),
+    classCount_(0),
+    arena_(nullptr),
+    arenaSize_(0),
+    arenaUsed_(0),
+    mapped_(false),
+    hugePages_(false),
+    locked_(false),
+    heapBytes_(0),
+    inUse_(0),
+    unpooled_(0)
+{
+    while((std::size_t(1) << minShift_) < parameters_.minBlockSize) {
+        minShift_++;
+    }
+    while(classCount_ < MaxClasses
+          && (std::size_t(1) << (minShift_ + classCount_)) <= parameters_.maxBlockSize)
+    {
+        classCount_++;
+    }
+    if(classCount_ == 0) {
+        throw std::runtime_error("rtac::asio::BufferPool : maxBlockSize must be "
+                                 "larger than minBlockSize");
+    }
+
+    this->map_arena();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry[id_] = this;
+}
+
+BufferPool::~BufferPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.erase(id_);
+    }
+    if(threadCache.poolId == id_) {
+        threadCache.flush();
+    }
+    if(inUse_ > 0) {
+        std::cerr << "rtac::asio::BufferPool : destroyed with " << inUse_
+                  << " blocks still in use." << std::endl;
+    }
+    for(auto block : heapBlocks_) {
+        ::operator delete(block);
+    }
+    if(mapped_) {
+        if(locked_) {
+            ::munlock(arena_, arenaSize_);
+        }
+        ::munmap(arena_, arenaSize_);
+    }
+}
+
+BufferPool::Ptr BufferPool::Create(const Parameters& params)
+{
+    return Ptr(new BufferPool(params));
+}
+
+void BufferPool::map_arena()
+{
+    if(parameters_.arenaSize == 0) {
+        return;
+    }
+
+    // The arena is populated right away : the resident memory of the pool
+    // is known from the start.
+    void* arena = MAP_FAILED;
+    if(parameters_.hugePages) {
+        std::size_t size = HugePageSize
+                         * ((parameters_.arenaSize + HugePageSize - 1) / HugePageSize);
+        arena = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_HUGETLB, -1, 0);
+        if(arena != MAP_FAILED) {
+            arenaSize_ = size;
+            hugePages_ = true;
+        }
+        else {
+            std::cerr << "rtac::asio::BufferPool : could not map huge pages ("
+                      << std::strerror(errno) << "), using regular pages."
+                      << std::endl;
+        }
+    }
+    if(arena == MAP_FAILED) {
+        arena = ::mmap(nullptr, parameters_.arenaSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(arena == MAP_FAILED) {
+            throw std::runtime_error("rtac::asio::BufferPool : could not map arena");
+        }
+        arenaSize_ = parameters_.arenaSize;
+        #ifdef MADV_HUGEPAGE
+        if(parameters_.hugePages) {
+            // transparent huge pages, if enabled on the system.
+            ::madvise(arena, arenaSize_, MADV_HUGEPAGE);
+        }
+        #endif
+    }
+    arena_  = (uint8_t*)arena;
+    mapped_ = true;
+
+    if(parameters_.lockMemory) {
+        if(::mlock(arena_, arenaSize_) == 0) {
+            locked_ = true;
+        }
+        else {
+            std::cerr << "rtac::asio::BufferPool : could not lock arena in RAM ("
+                      << std::strerror(errno) << ")." << std::endl;
+        }
+    }
+}
+
+int BufferPool::size_class(std::size_t size) const
+{
+    unsigned int c = 0;
+    while(c < classCount_ && (std::size_t(1) << (minShift_ + c)) < size) {
+        c++;
+    }
+    if(c >= classCount_) {
+        return -1;
+    }
+    return c;
+}
+
+std::size_t BufferPool::capacity(std::size_t size) const
+{
+    int c = this->size_class(size);
+    if(c < 0) {
+        return size;
+    }
+    return std::size_t(1) << (minShift_ + c);
+}
+
+/**
+ * Carves a new block in the arena, or takes it from the heap when the arena
+ * is used up. Called with mutex_ held.
+ */
+void* BufferPool::new_block(unsigned int sizeClass)
+{
+    std::size_t size = std::size_t(1) << (minShift_ + sizeClass);
+    // blocks are aligned on a cache line at least
+    std::size_t alignment = std::min<std::size_t>(size, 64);
+    std::size_t offset    = (arenaUsed_ + alignment - 1) & ~(alignment - 1);
+    if(offset + size <= arenaSize_) {
+        arenaUsed_ = offset + size;
+        return arena_ + offset;
+    }
+    void* block = ::operator new(size);
+    heapBlocks_.push_back(block);
+    heapBytes_ += size;
+    return block;
+}
+
+void* BufferPool::allocate(std::size_t size)
+{
+    int c = this->size_class(size);
+    if(c < 0) {
+        unpooled_++;
+        return ::operator new(size);
+    }
+    inUse_++;
+
+    if(parameters_.threadCacheSize > 0) {
+        threadCache.attach(this);
+        auto& cached = threadCache.blocks[c];
+        if(cached.size() == 0) {
+            cached.resize(std::max(1u, parameters_.threadCacheSize / 2));
+            cached.resize(this->pop_free(c, cached.data(), cached.size()));
+        }
+        if(cached.size() > 0) {
+            void* block = cached.back();
+            cached.pop_back();
+            return block;
+        }
+    }
+    else {
+        void* block;
+        if(this->pop_free(c, &block, 1) == 1) {
+            return block;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return this->new_block(c);
+}
+
+void BufferPool::deallocate(void* block, std::size_t size)
+{
+    if(!block) {
+        return;
+    }
+    int c = this->size_class(size);
+    if(c < 0) {
+        ::operator delete(block);
+        return;
+    }
+    inUse_--;
+
+    if(parameters_.threadCacheSize > 0) {
+        threadCache.attach(this);
+        auto& cached = threadCache.blocks[c];
+        if(cached.size() >= parameters_.threadCacheSize) {
+            // giving back half of the cache to the pool
+            std::size_t count = cached.size() / 2;
+            this->push_free(c, cached.data() + cached.size() - count, count);
+            cached.resize(cached.size() - count);
+        }
+        cached.push_back(block);
+    }
+    else {
+        this->push_free(c, &block, 1);
+    }
+}
+
+void BufferPool::push_free(unsigned int sizeClass, void** blocks, std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_[sizeClass].insert(free_[sizeClass].end(), blocks, blocks + count);
+}
+
+std::size_t BufferPool::pop_free(unsigned int sizeClass, void** blocks, std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& list = free_[sizeClass];
+    count = std::min(count, list.size());
+    if(count == 0) {
+        return 0;
+    }
+    std::memcpy(blocks, list.data() + list.size() - count, count*sizeof(void*));
+    list.resize(list.size() - count);
+    return count;
+}
+
+void BufferPool::reserve(std::size_t blockSize, std::size_t count)
+{
+    int c = this->size_class(blockSize);
+    if(c < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& list = free_[c];
+    list.reserve(list.size() + count);
+    for(std::size_t i = 0; i < count; i++) {
+        list.push_back(this->new_block(c));
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats res;
+    res.arenaSize = arenaSize_;
+    res.arenaUsed = arenaUsed_;
+    res.heapBytes = heapBytes_;
+    res.inUse     = inUse_;
+    res.unpooled  = unpooled_;
+    res.hugePages = hugePages_;
+    res.locked    = locked_;
+    return res;
+}
+
+} //namespace asio
+} //namespace rtac
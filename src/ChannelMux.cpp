@@ -0,0 +1,571 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/ChannelMux.h>
+
+#include <cstring>
+#include <algorithm>
+
+#include <boost/asio/error.hpp>
+
+namespace rtac { namespace asio {
+
+ChannelMux::Channel::Channel(const std::shared_ptr<ChannelMux>& mux, uint8_t id,
+                             unsigned int priority) :
+    StreamInterface(mux->service()),
+    mux_(mux),
+    id_(id),
+    priority_(priority),
+    rxHead_(0),
+    consumed_(0),
+    txCredit_(mux->parameters().window),
+    inFlight_(0)
+{}
+
+void ChannelMux::Channel::async_read_some(std::size_t bufferSize,
+                                          uint8_t* buffer,
+                                          Callback callback)
+{
+    auto mux = mux_.lock();
+    if(!mux) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::bad_descriptor, 0), PostTag(this, "channel"));
+        return;
+    }
+    mux->channel_read(*this, bufferSize, buffer, callback);
+}
+
+void ChannelMux::Channel::async_write_some(std::size_t count,
+                                           const uint8_t* data,
+                                           Callback callback)
+{
+    auto mux = mux_.lock();
+    if(!mux) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::bad_descriptor, 0), PostTag(this, "channel"));
+        return;
+    }
+    mux->channel_write(*this, count, data, callback);
+}
+
+void ChannelMux::Channel::flush()
+{
+    if(auto mux = mux_.lock()) {
+        mux->channel_flush(*this);
+    }
+}
+
+void ChannelMux::Channel::reset()
+{
+    this->cancel();
+    this->flush();
+}
+
+bool ChannelMux::Channel::is_open() const
+{
+    auto mux = mux_.lock();
+    return mux && !mux->stopped_ && mux->transport_->is_open();
+}
+
+bool ChannelMux::Channel::cancel()
+{
+    auto mux = mux_.lock();
+    if(!mux) {
+        return true;
+    }
+    return mux->channel_cancel(*this);
+}
+
+ChannelMux::ChannelMux(Stream::Ptr transport, const Parameters& params) :
+    transport_(transport),
+    parameters_(params),
+    stopped_(false),
+    rxChunk_(std::make_shared<std::vector<uint8_t>>()),
+    headerFill_(0),
+    remaining_(0),
+    creditFill_(0),
+    reading_(false),
+    txFrame_(std::make_shared<std::vector<uint8_t>>()),
+    writing_(false)
+{
+    if(parameters_.maxPayload == 0 || parameters_.maxPayload > 0xffff) {
+        throw std::runtime_error(
+            "rtac::asio::ChannelMux : maxPayload must be in [1,65535]");
+    }
+    if(parameters_.window == 0 || parameters_.readChunk == 0) {
+        throw std::runtime_error(
+            "rtac::asio::ChannelMux : window and readChunk must not be 0");
+    }
+    rxChunk_->resize(parameters_.readChunk);
+    txFrame_->reserve(parameters_.maxPayload + 8*HeaderSize);
+}
+
+ChannelMux::~ChannelMux()
+{
+    this->stop();
+}
+
+ChannelMux::Ptr ChannelMux::Create(Stream::Ptr transport, const Parameters& params)
+{
+    return Ptr(new ChannelMux(transport, params));
+}
+
+ChannelMux::Channel::Ptr ChannelMux::open_channel(uint8_t id, unsigned int priority)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = channels_.find(id);
+    if(it != channels_.end()) {
+        return it->second;
+    }
+    Channel::Ptr channel(new Channel(this->shared_from_this(), id, priority));
+    channels_[id] = channel;
+    levels_[priority].channels.push_back(channel);
+    return channel;
+}
+
+ChannelMux::Channel::Ptr ChannelMux::channel(uint8_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = channels_.find(id);
+    if(it == channels_.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+ChannelMux::Stats ChannelMux::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ChannelMux::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(reading_ || stopped_) {
+            return;
+        }
+        reading_    = true;
+        headerFill_ = 0;
+        remaining_  = 0;
+    }
+    this->read_transport();
+}
+
+/**
+ * Stops the mux : the transport operations in progress are cancelled and the
+ * pending channel operations end with operation_aborted. Operations started
+ * on the channels afterwards fail with bad_descriptor.
+ */
+void ChannelMux::stop()
+{
+    if(stopped_.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reading_ = false;
+        // A write already copied in txFrame_ ends in transport_write_continue.
+        this->fail_operations(boost::asio::error::operation_aborted, true, true);
+    }
+    transport_->cancel();
+}
+
+/**
+ * Ends the pending channel operations with err. Writes already copied in
+ * the transport frame are left to transport_write_continue. Called with
+ * mutex_ held.
+ */
+void ChannelMux::fail_operations(const ErrorCode& err, bool reads, bool writes)
+{
+    for(auto& c : channels_) {
+        auto& channel = *c.second;
+        if(reads && channel.pendingRead_) {
+            auto op = std::move(channel.pendingRead_);
+            this->service()->post(std::bind(op->callback, err, 0),
+                                  PostTag(&channel, "channel"));
+        }
+        if(writes && channel.pendingWrite_ && channel.inFlight_ == 0) {
+            auto op = std::move(channel.pendingWrite_);
+            this->service()->post(std::bind(op->callback, err, 0),
+                                  PostTag(&channel, "channel"));
+        }
+    }
+}
+
+void ChannelMux::read_transport()
+{
+    // The handler keeps the chunk alive, the mux may be released while the
+    // read is in progress.
+    std::weak_ptr<ChannelMux> weak = this->shared_from_this();
+    Buffer chunk = rxChunk_;
+    if(!transport_->async_read_some(chunk->size(), chunk->data(),
+            [weak, chunk](const ErrorCode& err, std::size_t count) {
+                if(auto mux = weak.lock()) {
+                    mux->transport_read_continue(err, count);
+                }
+            }))
+    {
+        std::cerr << "rtac::asio::ChannelMux : the transport is already being "
+                  << "read. The transport must only be read by the mux."
+                  << std::endl;
+        std::lock_guard<std::mutex> lock(mutex_);
+        reading_ = false;
+    }
+}
+
+void ChannelMux::transport_read_continue(const ErrorCode& err, std::size_t count)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    this->parse(rxChunk_->data(), count);
+    if(err) {
+        // The frame in progress is lost, the mux has to be restarted.
+        reading_ = false;
+        this->fail_operations(err, true, false);
+    }
+    bool reading = reading_;
+    this->send_next(lock);
+    if(reading) {
+        this->read_transport();
+    }
+}
+
+void ChannelMux::parse(const uint8_t* data, std::size_t count)
+{
+    while(count > 0) {
+        if(headerFill_ < HeaderSize) {
+            std::size_t n = std::min(HeaderSize - headerFill_, count);
+            std::memcpy(rxHeader_ + headerFill_, data, n);
+            headerFill_ += n;
+            data  += n;
+            count -= n;
+            if(headerFill_ == HeaderSize) {
+                stats_.framesIn++;
+                remaining_  = rxHeader_[2] | (rxHeader_[3] << 8);
+                creditFill_ = 0;
+                if(remaining_ == 0) {
+                    headerFill_ = 0;
+                }
+            }
+            continue;
+        }
+
+        std::size_t n = std::min(remaining_, count);
+        if(rxHeader_[1] == Data) {
+            this->deliver(data, n);
+        }
+        else if(rxHeader_[1] == Credit) {
+            std::size_t c = std::min(n, sizeof(creditBytes_) - creditFill_);
+            std::memcpy(creditBytes_ + creditFill_, data, c);
+            creditFill_ += c;
+        }
+        // payload of unknown frame types is skipped.
+        remaining_ -= n;
+        data       += n;
+        count      -= n;
+        if(remaining_ == 0) {
+            if(rxHeader_[1] == Credit && creditFill_ == sizeof(creditBytes_)) {
+                this->credit_received((uint32_t)creditBytes_[0]
+                                    | ((uint32_t)creditBytes_[1] << 8)
+                                    | ((uint32_t)creditBytes_[2] << 16)
+                                    | ((uint32_t)creditBytes_[3] << 24));
+            }
+            headerFill_ = 0;
+        }
+    }
+}
+
+/**
+ * Payload of a data frame received for the channel rxHeader_[0]. Called with
+ * mutex_ held.
+ */
+void ChannelMux::deliver(const uint8_t* data, std::size_t count)
+{
+    uint8_t id = rxHeader_[0];
+    auto it = channels_.find(id);
+    if(it == channels_.end()) {
+        // The window is given back so that the peer channel is not blocked.
+        stats_.dropped += count;
+        creditsToSend_[id] += count;
+        return;
+    }
+    auto& channel = *it->second;
+    std::size_t room = parameters_.window - std::min(parameters_.window,
+                                                     channel.rx_size());
+    if(count > room) {
+        // The peer did not respect the window.
+        stats_.overruns += count - room;
+        count = room;
+    }
+    stats_.bytesIn += count;
+    if(channel.rxHead_ > 0 && channel.rxHead_ >= channel.rxData_.size() / 2) {
+        channel.rxData_.erase(channel.rxData_.begin(),
+                              channel.rxData_.begin() + channel.rxHead_);
+        channel.rxHead_ = 0;
+    }
+    channel.rxData_.insert(channel.rxData_.end(), data, data + count);
+    this->serve_read(channel);
+}
+
+void ChannelMux::credit_received(uint32_t credit)
+{
+    auto it = channels_.find(rxHeader_[0]);
+    if(it != channels_.end()) {
+        it->second->txCredit_ += credit;
+    }
+}
+
+/**
+ * Completes the pending read of channel with the received data. Called with
+ * mutex_ held.
+ */
+void ChannelMux::serve_read(Channel& channel)
+{
+    if(!channel.pendingRead_ || channel.rx_size() == 0) {
+        return;
+    }
+    auto op = std::move(channel.pendingRead_);
+    std::size_t count = std::min(op->size, channel.rx_size());
+    std::memcpy(op->buffer, channel.rxData_.data() + channel.rxHead_, count);
+    channel.rxHead_ += count;
+    if(channel.rxHead_ == channel.rxData_.size()) {
+        channel.rxData_.clear();
+        channel.rxHead_ = 0;
+    }
+    this->give_back(channel, count);
+    this->service()->post(std::bind(op->callback, ErrorCode(), count),
+                          PostTag(&channel, "channel"));
+}
+
+/**
+ * Bytes read (or discarded) from the receive buffer of channel. The window
+ * is given back to the peer by halves to limit the number of Credit frames.
+ */
+void ChannelMux::give_back(Channel& channel, std::size_t count)
+{
+    channel.consumed_ += count;
+    if(channel.consumed_ >= std::max<std::size_t>(1, parameters_.window / 2)) {
+        creditsToSend_[channel.id_] += channel.consumed_;
+        channel.consumed_ = 0;
+    }
+}
+
+void ChannelMux::channel_read(Channel& channel, std::size_t bufferSize,
+                              uint8_t* buffer, Callback callback)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(stopped_) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::bad_descriptor, 0), PostTag(&channel, "channel"));
+        return;
+    }
+    if(channel.pendingRead_) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::already_started, 0), PostTag(&channel, "channel"));
+        return;
+    }
+    channel.pendingRead_ = std::unique_ptr<Channel::Operation>(new Channel::Operation{
+        bufferSize, buffer, nullptr, channel.record_read(bufferSize, callback)});
+    this->serve_read(channel);
+    this->send_next(lock);
+}
+
+void ChannelMux::channel_write(Channel& channel, std::size_t count,
+                               const uint8_t* data, Callback callback)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(stopped_) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::bad_descriptor, 0), PostTag(&channel, "channel"));
+        return;
+    }
+    if(channel.pendingWrite_) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::already_started, 0), PostTag(&channel, "channel"));
+        return;
+    }
+    channel.pendingWrite_ = std::unique_ptr<Channel::Operation>(new Channel::Operation{
+        count, nullptr, data, channel.record_write(count, callback)});
+    this->send_next(lock);
+}
+
+void ChannelMux::channel_flush(Channel& channel)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t discarded = channel.rx_size();
+    channel.rxData_.clear();
+    channel.rxHead_ = 0;
+    this->give_back(channel, discarded);
+    this->send_next(lock);
+}
+
+/**
+ * A write already copied in the transport frame cannot be cancelled. It
+ * completes normally, the user buffer is not accessed anymore.
+ */
+bool ChannelMux::channel_cancel(Channel& channel)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(channel.pendingRead_) {
+        auto op = std::move(channel.pendingRead_);
+        this->service()->post(std::bind(op->callback,
+            boost::asio::error::operation_aborted, 0), PostTag(&channel, "channel"));
+    }
+    if(channel.pendingWrite_ && channel.inFlight_ == 0) {
+        auto op = std::move(channel.pendingWrite_);
+        this->service()->post(std::bind(op->callback,
+            boost::asio::error::operation_aborted, 0), PostTag(&channel, "channel"));
+    }
+    return true;
+}
+
+void ChannelMux::append_header(uint8_t id, FrameType type, std::size_t length)
+{
+    txFrame_->push_back(id);
+    txFrame_->push_back(type);
+    txFrame_->push_back(length & 0xff);
+    txFrame_->push_back((length >> 8) & 0xff);
+    stats_.framesOut++;
+}
+
+/**
+ * Channel with the most urgent priority which has data to send and credit to
+ * send it. Round-robin between the channels of a same priority.
+ */
+ChannelMux::Channel* ChannelMux::next_sender()
+{
+    for(auto& l : levels_) {
+        auto& level = l.second;
+        std::size_t count = level.channels.size();
+        for(std::size_t k = 0; k < count; k++) {
+            std::size_t i = (level.next + k) % count;
+            if(level.channels[i]->can_send()) {
+                level.next = (i + 1) % count;
+                return level.channels[i].get();
+            }
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Builds the next transport write (all the pending Credit frames and at
+ * most one data frame) and starts it if the transport writer is idle.
+ * Called with mutex_ held, which is released before writing on the
+ * transport (its callback may be called inline).
+ */
+void ChannelMux::send_next(std::unique_lock<std::mutex>& lock)
+{
+    if(writing_ || stopped_) {
+        lock.unlock();
+        return;
+    }
+    txFrame_->clear();
+    // The credits are kept until the write succeeds.
+    txCredits_ = std::move(creditsToSend_);
+    creditsToSend_.clear();
+    for(auto& c : txCredits_) {
+        std::size_t credit = c.second;
+        while(credit > 0) {
+            uint32_t value = std::min<std::size_t>(credit, 0xffffffff);
+            this->append_header(c.first, Credit, 4);
+            for(int i = 0; i < 4; i++) {
+                txFrame_->push_back((value >> (8*i)) & 0xff);
+            }
+            credit -= value;
+        }
+    }
+
+    if(auto channel = this->next_sender()) {
+        auto& op = *channel->pendingWrite_;
+        std::size_t size = std::min(std::min(op.size, parameters_.maxPayload),
+                                    channel->txCredit_);
+        this->append_header(channel->id_, Data, size);
+        txFrame_->insert(txFrame_->end(), op.data, op.data + size);
+        channel->inFlight_  = size;
+        channel->txCredit_ -= size;
+        txChannel_ = channels_[channel->id_];
+        stats_.bytesOut += size;
+    }
+    if(txFrame_->size() == 0) {
+        lock.unlock();
+        return;
+    }
+    writing_ = true;
+    lock.unlock();
+
+    std::weak_ptr<ChannelMux> weak = this->shared_from_this();
+    Buffer frame = txFrame_;
+    if(!transport_->async_write(frame->size(), frame->data(),
+            [weak, frame](const ErrorCode& err, std::size_t count) {
+                if(auto mux = weak.lock()) {
+                    mux->transport_write_continue(err, count);
+                }
+            }))
+    {
+        std::cerr << "rtac::asio::ChannelMux : the transport is already being "
+                  << "written. The transport must only be written by the mux."
+                  << std::endl;
+        this->transport_write_continue(boost::asio::error::already_started, 0);
+    }
+}
+
+void ChannelMux::transport_write_continue(const ErrorCode& err, std::size_t)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    writing_ = false;
+    if(txChannel_) {
+        auto& channel = *txChannel_;
+        auto op   = std::move(channel.pendingWrite_);
+        auto size = channel.inFlight_;
+        channel.inFlight_ = 0;
+        txChannel_ = nullptr;
+        if(op) {
+            this->service()->post(std::bind(op->callback, err, err ? 0 : size),
+                                  PostTag(&channel, "channel"));
+        }
+    }
+    if(err) {
+        // The transport is not usable. The writes of the other channels
+        // fail as well, and the credits of the lost frame are sent again
+        // with the next frame.
+        this->fail_operations(err, false, true);
+        for(auto& c : txCredits_) {
+            creditsToSend_[c.first] += c.second;
+        }
+        txCredits_.clear();
+        lock.unlock();
+        return;
+    }
+    txCredits_.clear();
+    this->send_next(lock);
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,84 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/ReadBlockPool.h>
+
+namespace rtac { namespace asio {
+
+BorrowedBuffer::Lease::~Lease()
+{
+    pool->release(index);
+}
+
+ReadBlockPool::ReadBlockPool(std::size_t blockCount, std::size_t blockSize) :
+    blockSize_(blockSize),
+    storage_(blockCount*blockSize)
+{
+    free_.reserve(blockCount);
+    for(std::size_t i = 0; i < blockCount; i++) {
+        // last block first so blocks are taken in memory order.
+        free_.push_back(blockCount - 1 - i);
+    }
+}
+
+ReadBlockPool::Ptr ReadBlockPool::Create(std::size_t blockCount, std::size_t blockSize)
+{
+    return Ptr(new ReadBlockPool(blockCount, blockSize));
+}
+
+std::shared_ptr<BorrowedBuffer::Lease> ReadBlockPool::acquire()
+{
+    std::size_t index;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(free_.size() == 0) {
+            return nullptr;
+        }
+        index = free_.back();
+        free_.pop_back();
+    }
+    auto lease = std::make_shared<BorrowedBuffer::Lease>();
+    lease->pool  = this->shared_from_this();
+    lease->index = index;
+    return lease;
+}
+
+void ReadBlockPool::release(std::size_t index)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(index);
+}
+
+std::size_t ReadBlockPool::available() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_.size();
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,281 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/ReadQueue.h>
+
+#include <cstring>
+
+#include <rtac_asio/tracepoints.h>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+ReadQueue::ReadQueue(StreamInterface::Ptr stream, std::size_t maxQueued,
+                     std::size_t ringSize, std::ofstream* rxDump,
+                     OperationCounters::Ptr counters) :
+    stream_(stream),
+    maxQueued_(maxQueued),
+    requestCounter_(0),
+    ring_(ringSize, 0, stream->service()->buffer_pool().allocator<uint8_t>()),
+    ringHead_(0),
+    ringCount_(0),
+    reading_(false),
+    stopped_(false),
+    rxDump_(rxDump),
+    counters_(counters)
+{}
+
+ReadQueue::Ptr ReadQueue::Create(StreamInterface::Ptr stream,
+                                 std::size_t maxQueued,
+                                 std::size_t ringSize,
+                                 std::ofstream* rxDump,
+                                 OperationCounters::Ptr counters)
+{
+    return Ptr(new ReadQueue(stream, maxQueued, ringSize, rxDump, counters));
+}
+
+bool ReadQueue::async_read(std::size_t count, uint8_t* data, Callback callback,
+                           bool exact, unsigned int timeoutMillis)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(stopped_ || requests_.size() >= maxQueued_) {
+            if(counters_) {
+                counters_->add(counters_->busy);
+            }
+            return false;
+        }
+
+        Request request;
+        request.id        = ++requestCounter_;
+        request.size      = count;
+        request.data      = data;
+        request.callback  = callback;
+        request.exact     = exact;
+        request.processed = 0;
+        if(counters_) {
+            request.start = OperationCounters::Clock::now();
+        }
+        if(timeoutMillis > 0) {
+            request.timeout = stream_->service()->timer_wheel().arm(timeoutMillis,
+                std::bind(&ReadQueue::timeout_reached, this->shared_from_this(),
+                          request.id));
+        }
+        requests_.push_back(std::move(request));
+        this->serve();
+    }
+    this->start_read();
+    return true;
+}
+
+/**
+ * Delivers the data of the ring to the queued requests, in order. Must be
+ * called with mutex_ locked.
+ */
+void ReadQueue::serve()
+{
+    bool errorDelivered = false;
+    while(requests_.size() > 0) {
+        auto& request = requests_.front();
+        if(ringCount_ > 0) {
+            std::size_t count = std::min(request.size - request.processed, ringCount_);
+            std::size_t first = std::min(count, ring_.size() - ringHead_);
+            std::memcpy(request.data + request.processed, ring_.data() + ringHead_, first);
+            std::memcpy(request.data + request.processed + first, ring_.data(), count - first);
+            ringHead_  = (ringHead_ + count) % ring_.size();
+            ringCount_ -= count;
+            request.processed += count;
+            if(ringCount_ == 0 && !reading_) {
+                // keeps the free space contiguous (a pending read writes
+                // right after the last byte of the ring, so not if reading)
+                ringHead_ = 0;
+            }
+        }
+        if(request.processed == request.size || (!request.exact && request.processed > 0)) {
+            this->complete_front(ErrorCode());
+        }
+        else if(error_ && ringCount_ == 0) {
+            this->complete_front(error_);
+            errorDelivered = true;
+        }
+        else {
+            break; // waiting for more data
+        }
+    }
+    if(errorDelivered) {
+        // The reads queued after this will restart the read loop.
+        error_ = ErrorCode();
+    }
+}
+
+void ReadQueue::complete_front(const ErrorCode& err)
+{
+    Request request = std::move(requests_.front());
+    requests_.pop_front();
+    stream_->service()->timer_wheel().cancel(request.timeout);
+    stream_->service()->post(this->completion(request, err),
+                             PostTag(stream_.get(), "queued read"));
+}
+
+std::function<void()> ReadQueue::completion(const Request& request,
+                                            const ErrorCode& err)
+{
+    if(counters_) {
+        return OperationCounters::complete(counters_, request.callback, err,
+                                           request.processed, request.start);
+    }
+    return std::bind(request.callback, err, request.processed);
+}
+
+void ReadQueue::start_read()
+{
+    uint8_t*    dst;
+    std::size_t size;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(reading_ || stopped_ || error_ || ringCount_ == ring_.size()) {
+            return;
+        }
+        std::size_t tail = (ringHead_ + ringCount_) % ring_.size();
+        dst  = ring_.data() + tail;
+        size = (tail >= ringHead_) ? ring_.size() - tail : ringHead_ - tail;
+        reading_ = true;
+    }
+    // Outside of the lock, some streams may call the handler right away.
+    stream_->async_read_some(size, dst,
+        std::bind(&ReadQueue::read_continue, this->shared_from_this(), _1, _2));
+}
+
+void ReadQueue::read_continue(const ErrorCode& err, std::size_t readCount)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reading_ = false;
+        if(stopped_) {
+            return;
+        }
+        if(readCount > 0) {
+            if(rxDump_ && rxDump_->is_open()) {
+                std::size_t tail = (ringHead_ + ringCount_) % ring_.size();
+                rxDump_->write((const char*)ring_.data() + tail, readCount);
+                rxDump_->flush();
+            }
+            ringCount_ += readCount;
+        }
+        if(err && !(err == boost::asio::error::operation_aborted && stream_->is_open())) {
+            // An aborted read while the stream is still open was cancelled
+            // for another reason than this queue (write timeout...). It is
+            // simply restarted.
+            error_ = err;
+        }
+        this->serve();
+    }
+    this->start_read();
+}
+
+void ReadQueue::timeout_reached(unsigned int id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto it = requests_.begin(); it != requests_.end(); it++) {
+        if(it->id == id) {
+            RTAC_ASIO_TRACE(queued_timeout, stream_.get(), id);
+            stream_->service()->post(this->completion(*it,
+                boost::asio::error::timed_out), PostTag(stream_.get(), "queued read"));
+            requests_.erase(it);
+            return;
+        }
+    }
+}
+
+/**
+ * Inserts data before the content of the ring (used for the data already
+ * received by the StreamReader when the queue is created).
+ */
+void ReadQueue::push_front(ReadBuffer& buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t count = std::min(buffer.size(), ring_.size() - ringCount_);
+    ringHead_  = (ringHead_ + ring_.size() - count) % ring_.size();
+    std::size_t first = std::min(count, ring_.size() - ringHead_);
+    buffer.sgetn((char*)ring_.data() + ringHead_, first);
+    buffer.sgetn((char*)ring_.data(), count - first);
+    ringCount_ += count;
+}
+
+/**
+ * Stops the queue. Queued reads are aborted and the data remaining in the
+ * ring is moved to leftover. Data received by the pending read on the stream
+ * (if any) is lost.
+ */
+void ReadQueue::stop(ReadBuffer& leftover)
+{
+    bool reading;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        while(requests_.size() > 0) {
+            this->complete_front(boost::asio::error::operation_aborted);
+        }
+        std::size_t first = std::min(ringCount_, ring_.size() - ringHead_);
+        leftover.sputn((const char*)ring_.data() + ringHead_, first);
+        leftover.sputn((const char*)ring_.data(), ringCount_ - first);
+        ringHead_  = 0;
+        ringCount_ = 0;
+        reading    = reading_;
+    }
+    if(reading) {
+        stream_->cancel();
+    }
+}
+
+void ReadQueue::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // a pending read writes after the last byte of the ring.
+        ringHead_  = (ringHead_ + ringCount_) % ring_.size();
+        ringCount_ = 0;
+    }
+    this->start_read(); // in case the ring was full
+}
+
+std::size_t ReadQueue::queued() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_.size();
+}
+
+std::size_t ReadQueue::available() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ringCount_;
+}
+
+} //namespace asio
+} //namespace rtac
@@ -27,6 +27,9 @@
 
 
 #include <rtac_asio/SerialStream.h>
+#include <rtac_asio/serial_utils.h>
+
+#include <cmath>
 
 namespace rtac { namespace asio {
 
@@ -82,12 +85,29 @@ void SerialStream::reset()
 
     serial_ = std::make_unique<SerialPort>(this->service()->service(), device_);
 
-    serial_->set_option(parameters_.baudrate);
+    // boost only handles standard baudrates. Others are set afterwards.
+    ErrorCode baudErr;
+    serial_->set_option(parameters_.baudrate, baudErr);
     serial_->set_option(parameters_.characterSize);
     serial_->set_option(parameters_.parity);
     serial_->set_option(parameters_.flowControl);
     serial_->set_option(parameters_.stopBits);
 
+    this->apply_low_latency_settings();
+
+    // termios2 must be set last, the termios calls above would not preserve
+    // a non-standard baudrate.
+    if(baudErr) {
+        if(auto err = set_custom_baudrate(this->native_handle(),
+                                          parameters_.baudrate.value()))
+        {
+            std::ostringstream oss;
+            oss << "Could not set baudrate " << parameters_.baudrate.value()
+                << " on " << device_ << " : " << err.message();
+            throw std::runtime_error(oss.str());
+        }
+    }
+
     if(auto err = this->flush(FlushBoth)) {
         std::ostringstream oss;
         oss << "Error on serial port flushing : " << err;
@@ -95,6 +115,29 @@ void SerialStream::reset()
     }
 }
 
+void SerialStream::apply_low_latency_settings()
+{
+    if(parameters_.rawMode) {
+        if(auto err = set_raw_mode(this->native_handle(),
+                                   parameters_.vmin, parameters_.vtime))
+        {
+            std::cerr << "rtac::asio::SerialStream : could not set raw mode on "
+                      << device_ << " : " << err.message() << std::endl;
+        }
+    }
+    if(parameters_.lowLatency) {
+        if(auto err = set_low_latency(this->native_handle(), true)) {
+            // Some drivers do not implement TIOCSSERIAL but still expose
+            // their latency timer through sysfs (FTDI).
+            if(set_usb_latency_timer(device_, 1)) {
+                std::cerr << "rtac::asio::SerialStream : could not set "
+                          << "ASYNC_LOW_LATENCY on " << device_ << " : "
+                          << err.message() << std::endl;
+            }
+        }
+    }
+}
+
 SerialStream::ErrorCode SerialStream::flush(FlushType flushType)
 {
     if(::tcflush(serial_->lowest_layer().native_handle(), flushType) == 0) {
@@ -113,19 +156,84 @@ bool SerialStream::is_open() const
     return false;
 }
 
+bool SerialStream::cancel()
+{
+    if(!this->is_open()) {
+        return false;
+    }
+    ErrorCode err;
+    serial_->cancel(err);
+    return !err;
+}
+
+int SerialStream::native_handle()
+{
+    return serial_->lowest_layer().native_handle();
+}
+
+int SerialStream::native_fd() const
+{
+    if(!this->is_open()) {
+        return -1;
+    }
+    return serial_->native_handle();
+}
+
+unsigned int SerialStream::frame_gap_micros() const
+{
+    if(parameters_.frameGapMicros > 0) {
+        return parameters_.frameGapMicros;
+    }
+    unsigned int bauds = parameters_.baudrate.value();
+    if(bauds == 0) {
+        return 0;
+    }
+    if(bauds > 19200) {
+        // Fixed value from the Modbus specification. Computing it would give
+        // a gap too short to be reliably detected at high baudrates.
+        return 1750;
+    }
+
+    // start bit + data bits + parity bit + stop bits
+    float bits = 1.0f + parameters_.characterSize.value();
+    if(parameters_.parity.value() != SerialPort::parity::none) {
+        bits += 1.0f;
+    }
+    switch(parameters_.stopBits.value()) {
+        default:
+        case SerialPort::stop_bits::one:          bits += 1.0f; break;
+        case SerialPort::stop_bits::onepointfive: bits += 1.5f; break;
+        case SerialPort::stop_bits::two:          bits += 2.0f; break;
+    }
+    return (unsigned int)std::ceil(3.5e6f * bits / bauds);
+}
 
 void SerialStream::async_read_some(std::size_t bufferSize,
                                    uint8_t* buffer,
                                    Callback callback)
 {
-    serial_->async_read_some(boost::asio::buffer(buffer, bufferSize), callback);
+    serial_->async_read_some(boost::asio::buffer(buffer, bufferSize),
+        this->record_read(bufferSize, callback));
+}
+
+std::size_t SerialStream::try_read_some(std::size_t bufferSize,
+                                        uint8_t* buffer,
+                                        ErrorCode& err)
+{
+    if(!this->is_open()) {
+        err = boost::asio::error::bad_descriptor;
+        return 0;
+    }
+    return this->native_try_read(serial_->native_handle(), false,
+                                 bufferSize, buffer, err);
 }
 
 void SerialStream::async_write_some(std::size_t count,
                                     const uint8_t* data,
                                     Callback callback)
 {
-    serial_->async_write_some(boost::asio::buffer(data, count), callback);
+    serial_->async_write_some(boost::asio::buffer(data, count),
+        this->record_write(count, callback));
 }
 
 } //namespace asio
@@ -0,0 +1,270 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/ServiceMonitor.h>
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace rtac { namespace asio {
+
+namespace {
+
+uint64_t to_nanos(ServiceMonitor::Duration d)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    return ns > 0 ? ns : 0;
+}
+
+struct Timed
+{
+    ServiceMonitor*                   monitor;
+    std::function<void()>             function;
+    PostTag                           tag;
+    ServiceMonitor::Clock::time_point posted;
+};
+
+} //namespace
+
+ServiceMonitor::ServiceMonitor(unsigned int topN) :
+    posted_(0),
+    executed_(0),
+    maxQueueDepth_(0),
+    topN_(topN)
+{}
+
+void ServiceMonitor::set_top_n(unsigned int topN)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    topN_ = topN;
+    auto greater = [](const Slow& a, const Slow& b) { return a.nanos > b.nanos; };
+    while(slowest_.size() > topN_) {
+        std::pop_heap(slowest_.begin(), slowest_.end(), greater);
+        slowest_.pop_back();
+    }
+}
+
+void ServiceMonitor::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // posted_ and executed_ are kept : their difference is the queue depth.
+    maxQueueDepth_ = posted_ - executed_;
+    queueDelay_.reset();
+    handlerTime_.reset();
+    loopLag_.reset();
+    totals_.clear();
+    slowest_.clear();
+}
+
+std::function<void()> ServiceMonitor::wrap(const std::function<void()>& function,
+                                           const PostTag& tag)
+{
+    uint64_t depth = posted_.fetch_add(1, std::memory_order_relaxed) + 1
+                   - executed_.load(std::memory_order_relaxed);
+    uint64_t current = maxQueueDepth_.load(std::memory_order_relaxed);
+    while(depth > current
+          && !maxQueueDepth_.compare_exchange_weak(current, depth, std::memory_order_relaxed));
+
+    Timed timed{this, function, tag, Clock::now()};
+    return [timed]() {
+        // Recorded even if the handler throws, executed_ would drift from
+        // posted_ otherwise.
+        struct Recorder {
+            const Timed&      timed;
+            Clock::time_point start;
+            ~Recorder() {
+                timed.monitor->record(timed.tag, timed.posted, start, Clock::now());
+            }
+        } recorder{timed, Clock::now()};
+        timed.function();
+    };
+}
+
+void ServiceMonitor::record(const PostTag& tag, Clock::time_point posted,
+                            Clock::time_point start, Clock::time_point end)
+{
+    executed_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t queued = to_nanos(start - posted);
+    uint64_t nanos  = to_nanos(end - start);
+    queueDelay_.record(queued);
+    handlerTime_.record(nanos);
+
+    Key key{tag.source, tag.operation};
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& totals = totals_[key];
+    totals.count++;
+    totals.totalNanos += nanos;
+    totals.maxNanos    = std::max(totals.maxNanos, nanos);
+
+    if(topN_ == 0) {
+        return;
+    }
+    auto greater = [](const Slow& a, const Slow& b) { return a.nanos > b.nanos; };
+    if(slowest_.size() < topN_) {
+        slowest_.push_back(Slow{key, nanos, queued, start});
+        std::push_heap(slowest_.begin(), slowest_.end(), greater);
+    }
+    else if(nanos > slowest_.front().nanos) {
+        std::pop_heap(slowest_.begin(), slowest_.end(), greater);
+        slowest_.back() = Slow{key, nanos, queued, start};
+        std::push_heap(slowest_.begin(), slowest_.end(), greater);
+    }
+}
+
+void ServiceMonitor::name_source(const void* source, const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    names_[source] = name;
+}
+
+/**
+ * Called when source is destroyed. Its name and totals are dropped so that
+ * they are not attributed to a new source allocated at the same address. Its
+ * entries in the slowest handlers are kept as untagged.
+ */
+void ServiceMonitor::forget_source(const void* source)
+{
+    if(!source) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    names_.erase(source);
+    auto it = totals_.lower_bound(Key{source, nullptr});
+    while(it != totals_.end() && it->first.source == source) {
+        it = totals_.erase(it);
+    }
+    for(auto& s : slowest_) {
+        if(s.key.source == source) {
+            s.key.source = nullptr;
+        }
+    }
+}
+
+ServiceMonitor::Snapshot ServiceMonitor::snapshot() const
+{
+    Snapshot res;
+    res.executed      = executed_.load(std::memory_order_relaxed);
+    res.posted        = posted_.load(std::memory_order_relaxed);
+    res.queueDepth    = res.posted > res.executed ? res.posted - res.executed : 0;
+    res.maxQueueDepth = maxQueueDepth_.load(std::memory_order_relaxed);
+    res.queueDelay    = queueDelay_.snapshot();
+    res.handlerTime   = handlerTime_.snapshot();
+    res.loopLag       = loopLag_.snapshot();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto name_of = [&](const void* source) {
+        auto it = names_.find(source);
+        if(it != names_.end()) {
+            return it->second;
+        }
+        if(!source) {
+            return std::string("untagged");
+        }
+        std::ostringstream oss;
+        oss << source;
+        return oss.str();
+    };
+    for(auto& t : totals_) {
+        res.sources.push_back(SourceStats{t.first.source, name_of(t.first.source),
+            t.first.operation ? t.first.operation : "-",
+            t.second.count, t.second.totalNanos, t.second.maxNanos});
+    }
+    std::sort(res.sources.begin(), res.sources.end(),
+        [](const SourceStats& a, const SourceStats& b) {
+            return a.totalNanos > b.totalNanos;
+        });
+    for(auto& s : slowest_) {
+        res.slowest.push_back(SlowHandler{s.key.source, name_of(s.key.source),
+            s.key.operation ? s.key.operation : "-",
+            s.nanos, s.queuedNanos, s.start});
+    }
+    std::sort(res.slowest.begin(), res.slowest.end(),
+        [](const SlowHandler& a, const SlowHandler& b) {
+            return a.nanos > b.nanos;
+        });
+    return res;
+}
+
+namespace {
+
+void text_histogram(std::ostream& os, const std::string& label,
+                    const LatencyHistogram::Snapshot& h)
+{
+    os << label << " (us) : ";
+    if(h.count == 0) {
+        os << "-\n";
+        return;
+    }
+    os << h.count << " samples, mean " << h.mean() / 1000.0
+       << ", p50 "   << h.percentile(50.0) / 1000.0
+       << ", p99 "   << h.percentile(99.0) / 1000.0
+       << ", max "   << h.max / 1000.0 << '\n';
+}
+
+} //namespace
+
+std::string ServiceMonitor::Snapshot::to_text() const
+{
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1);
+    oss << "handlers : " << executed << "/" << posted << " executed, queue depth "
+        << queueDepth << " (max " << maxQueueDepth << ")\n";
+    text_histogram(oss, "queue delay ", queueDelay);
+    text_histogram(oss, "handler time", handlerTime);
+    text_histogram(oss, "loop lag    ", loopLag);
+    if(sources.size() > 0) {
+        oss << "by source :\n";
+        for(auto& s : sources) {
+            oss << "  " << std::setw(20) << std::left << s.name << std::right
+                << " " << std::setw(12) << std::left << s.operation << std::right
+                << " : " << s.count << " handlers, total "
+                << s.totalNanos / 1000.0 << "us, max "
+                << s.maxNanos / 1000.0 << "us\n";
+        }
+    }
+    if(slowest.size() > 0) {
+        oss << "slowest handlers :\n";
+        for(auto& s : slowest) {
+            oss << "  " << std::setw(20) << std::left << s.name << std::right
+                << " " << std::setw(12) << std::left << s.operation << std::right
+                << " : " << s.nanos / 1000.0 << "us (queued "
+                << s.queuedNanos / 1000.0 << "us)\n";
+        }
+    }
+    return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const ServiceMonitor::Snapshot& snapshot)
+{
+    os << snapshot.to_text();
+    return os;
+}
+
+} //namespace asio
+} //namespace rtac
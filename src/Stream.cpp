@@ -56,11 +56,24 @@ Stream::Ptr Stream::CreateUDPClient(const std::string& remoteIP,
                                                   remoteIP, remotePort)));
 }
 
-Stream::Ptr Stream::CreateTCPClient(const std::string& remoteIP,
-                                    uint16_t remotePort)
+Stream::Ptr Stream::CreateTCPClient(const std::string& remoteHost,
+                                    uint16_t remotePort,
+                                    const TCPClientStream::Parameters& params)
 {
     return Ptr(new Stream(TCPClientStream::Create(AsyncService::Create(),
-                                                  remoteIP, remotePort)));
+                                                  remoteHost, remotePort, params)));
+}
+
+Stream::Ptr Stream::CreateUnix(const std::string& path)
+{
+    return Ptr(new Stream(UnixStream::Create(AsyncService::Create(), path)));
+}
+
+Stream::Ptr Stream::CreateUnixDatagram(const std::string& path,
+                                       UnixDatagramStream::Mode mode)
+{
+    return Ptr(new Stream(UnixDatagramStream::Create(AsyncService::Create(),
+                                                     path, mode)));
 }
 
 void Stream::start()
@@ -105,12 +118,69 @@ void Stream::reset()
     reader_.reset();
 }
 
+/**
+ * Ends the read and write in progress with operation_aborted. Unlike
+ * reset(), the transport is left open (and not reconnected).
+ */
+void Stream::cancel()
+{
+    reader_.cancel();
+    writer_.cancel();
+}
+
+/**
+ * Ends the read and write in progress with operation_aborted and closes the
+ * transport, which is not reconnected.
+ */
+void Stream::close()
+{
+    this->cancel();
+    reader_.stream()->close();
+}
+
+StreamStats Stream::stats() const
+{
+    StreamStats res;
+    res.reader    = reader_.stats();
+    res.writer    = writer_.stats();
+    res.transport = reader_.stream()->counters();
+    return res;
+}
+
+void Stream::set_name(const std::string& name)
+{
+    this->service()->monitor().name_source(reader_.stream().get(), name);
+}
+
+void Stream::set_sync_spin(unsigned int micros)
+{
+    reader_.set_sync_spin(micros);
+    writer_.set_sync_spin(micros);
+}
+
+void Stream::set_inline_completion(bool enable)
+{
+    reader_.set_inline_completion(enable);
+    writer_.set_inline_completion(enable);
+}
+
 bool Stream::async_read_some(std::size_t count, uint8_t* data,
                              Callback callback, unsigned int timeoutMillis)
 {
     return reader_.async_read_some(count, data, callback, timeoutMillis);
 }
 
+bool Stream::async_read_borrowed(StreamReader::BorrowedCallback callback,
+                                 unsigned int timeoutMillis)
+{
+    return reader_.async_read_borrowed(callback, timeoutMillis);
+}
+
+void Stream::set_block_pool(ReadBlockPool::Ptr pool)
+{
+    reader_.set_block_pool(pool);
+}
+
 bool Stream::async_write_some(std::size_t count, const uint8_t* data,
                               Callback callback, unsigned int timeoutMillis)
 {
@@ -153,6 +223,65 @@ std::size_t Stream::read_until(std::size_t maxSize, uint8_t* data,
     return reader_.read_until(maxSize, data, delimiter, timeoutMillis);
 }
 
+bool Stream::async_read_frame(std::size_t maxSize, uint8_t* data,
+                              Callback callback, unsigned int timeoutMillis,
+                              unsigned int gapMicros)
+{
+    return reader_.async_read_frame(maxSize, data, callback,
+                                    timeoutMillis, gapMicros);
+}
+
+std::size_t Stream::read_frame(std::size_t maxSize, uint8_t* data,
+                               unsigned int timeoutMillis,
+                               unsigned int gapMicros)
+{
+    return reader_.read_frame(maxSize, data, timeoutMillis, gapMicros);
+}
+
+bool Stream::async_write_priority(unsigned int priority,
+                                  std::size_t count, const uint8_t* data,
+                                  Callback callback, unsigned int timeoutMillis)
+{
+    return writer_.async_write_priority(priority, count, data, callback, timeoutMillis);
+}
+
+std::size_t Stream::write_priority(unsigned int priority,
+                                   std::size_t count, const uint8_t* data,
+                                   unsigned int timeoutMillis)
+{
+    return writer_.write_priority(priority, count, data, timeoutMillis);
+}
+
+bool Stream::enable_scheduled_writes(const WriteScheduler::Parameters& params)
+{
+    return writer_.enable_scheduled_writes(params);
+}
+
+void Stream::disable_scheduled_writes()
+{
+    writer_.disable_scheduled_writes();
+}
+
+bool Stream::enable_pacing(double bytesPerSecond, std::size_t burst)
+{
+    return writer_.enable_pacing(bytesPerSecond, burst);
+}
+
+void Stream::disable_pacing()
+{
+    writer_.disable_pacing();
+}
+
+bool Stream::enable_queued_reads(std::size_t maxQueued, std::size_t ringSize)
+{
+    return reader_.enable_queued_reads(maxQueued, ringSize);
+}
+
+void Stream::disable_queued_reads()
+{
+    reader_.disable_queued_reads();
+}
+
 void Stream::enable_io_dump(const std::string& rxFile,
                             const std::string& txFile,
                             bool appendMode)
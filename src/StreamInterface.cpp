@@ -0,0 +1,108 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <rtac_asio/StreamInterface.h>
+
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <boost/asio/error.hpp>
+
+namespace rtac { namespace asio {
+
+StreamInterface::~StreamInterface()
+{
+    // The transport is the source of the handlers it posts (see PostTag).
+    if(service_) {
+        service_->monitor().forget_source(this);
+    }
+}
+
+/**
+ * Waits for the handlers currently using the stream and makes the later ones
+ * skip it. Called first in the destructor of the implementations, before
+ * their members are destroyed.
+ */
+void StreamInterface::invalidate_handlers()
+{
+    std::lock_guard<std::mutex> lock(handlerToken_->mutex);
+    handlerToken_->valid = false;
+}
+
+std::size_t StreamInterface::try_read_some(std::size_t, uint8_t*, ErrorCode& err)
+{
+    err = boost::asio::error::would_block;
+    return 0;
+}
+
+std::size_t StreamInterface::native_try_read(int fd, bool isSocket,
+                                             std::size_t bufferSize,
+                                             uint8_t* buffer, ErrorCode& err)
+{
+    err = ErrorCode();
+    if(fd < 0) {
+        err = boost::asio::error::bad_descriptor;
+        return 0;
+    }
+    if(!isSocket) {
+        // A tty may be in blocking mode until its first asynchronous
+        // operation. read() is only called if data is ready.
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 0);
+        if(ready == 0 || (ready > 0 && !(pfd.revents & POLLIN))) {
+            err = boost::asio::error::would_block;
+            return 0;
+        }
+    }
+    ssize_t count;
+    do {
+        count = isSocket ? ::recv(fd, buffer, bufferSize, MSG_DONTWAIT)
+                         : ::read(fd, buffer, bufferSize);
+    } while(count < 0 && errno == EINTR);
+
+    if(count < 0) {
+        if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            err = boost::asio::error::would_block;
+        }
+        else {
+            err = ErrorCode(errno, boost::system::system_category());
+        }
+        return 0;
+    }
+    if(count == 0) {
+        err = boost::asio::error::eof;
+        return 0;
+    }
+    counters_->rx.submit(bufferSize);
+    counters_->rx.complete(ErrorCode(), count);
+    return count;
+}
+
+} //namespace asio
+} //namespace rtac
@@ -28,19 +28,41 @@
 
 #include <rtac_asio/StreamReader.h>
 
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+#include <rtac_asio/tracepoints.h>
+
 using namespace std::placeholders;
 
 namespace rtac { namespace asio {
 
 StreamReader::StreamReader(StreamInterface::Ptr stream) :
     stream_(stream),
-    readCounter_(0),
+    state_(0),
     readId_(0),
-    timer_(stream_->service()->service())
+    counters_(OperationCounters::Create()),
+    inlineCompletion_(false),
+    waiterNotified_(false),
+    waiterSleeping_(false),
+    spinMicros_(0),
+    syncCount_(0),
+    readBuffer_(std::numeric_limits<std::size_t>::max(),
+                stream_->service()->buffer_pool().allocator<char>()),
+    rxChunk_(stream_->service()->buffer_pool().allocator<uint8_t>()),
+    rxPending_(false),
+    frameReadId_(0),
+    frameGap_(0),
+    gapTimer_(stream_->service()->service()),
+    gapCounter_(0),
+    dumpBuffer_(stream_->service()->buffer_pool().allocator<uint8_t>())
 {}
 
 StreamReader::~StreamReader()
 {
+    stream_->service()->timer_wheel().cancel(timeout_);
+    this->disable_queued_reads();
     this->disable_dump();
 }
 
@@ -51,6 +73,10 @@ StreamReader::Ptr StreamReader::Create(StreamInterface::Ptr stream)
 
 void StreamReader::flush()
 {
+    if(readQueue_) {
+        readQueue_->flush();
+    }
+    std::lock_guard<std::mutex> lock(rxMutex_);
     readBuffer_.consume(readBuffer_.size());
     stream_->flush();
 }
@@ -60,6 +86,38 @@ void StreamReader::reset()
     stream_->reset();
 }
 
+bool StreamReader::enable_queued_reads(std::size_t maxQueued, std::size_t ringSize)
+{
+    if(readQueue_) {
+        return true;
+    }
+    if(state_.load() & Busy) {
+        std::cerr << "rtac::asio::StreamReader : cannot enable queued reads "
+                  << "while a read is in progress." << std::endl;
+        return false;
+    }
+    auto queue = ReadQueue::Create(stream_, maxQueued, ringSize,
+                                   &rxDump_, counters_);
+    {
+        std::lock_guard<std::mutex> lock(rxMutex_);
+        queue->push_front(readBuffer_);
+    }
+    readQueue_ = queue;
+    return true;
+}
+
+void StreamReader::disable_queued_reads()
+{
+    if(!readQueue_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(rxMutex_);
+        readQueue_->stop(readBuffer_);
+    }
+    readQueue_ = nullptr;
+}
+
 void StreamReader::enable_dump(const std::string& filename, bool appendMode)
 {
     if(rxDump_.is_open()) {
@@ -71,6 +129,11 @@ void StreamReader::enable_dump(const std::string& filename, bool appendMode)
     if(appendMode) {
         mode = std::ofstream::app;
     }
+    if(dumpBuffer_.size() == 0) {
+        // see StreamWriter::enable_dump
+        dumpBuffer_.resize(DumpBufferSize);
+        rxDump_.rdbuf()->pubsetbuf((char*)dumpBuffer_.data(), dumpBuffer_.size());
+    }
     rxDump_.open(filename, mode);
     if(!rxDump_.is_open()) {
         std::cerr << "rtac_asio : Could not open file "
@@ -98,48 +161,102 @@ void StreamReader::dump_callback(Callback callback, uint8_t* data,
     callback(err, readCount);
 }
 
-bool StreamReader::new_read(std::size_t requestedSize, uint8_t* data, Callback callback,
-                            unsigned int timeoutMillis)
+bool StreamReader::new_read(std::size_t requestedSize, uint8_t* data,
+                            Callback callback, unsigned int timeoutMillis)
 {
-    std::lock_guard<std::mutex> lock(readMutex_);
-    if(readId_ != 0) {
+    uint64_t state = state_.load();
+    if(state & Busy) {
         // device busy
+        counters_->add(counters_->busy);
         return false;
     }
-    
-    readCounter_++;
-    readId_        = readCounter_;
+    uint64_t next = ((state >> 32) + 1) << 32;
+    if(!state_.compare_exchange_strong(state, next | Busy)) {
+        // another read was started in the meantime
+        counters_->add(counters_->busy);
+        return false;
+    }
+    startTime_ = OperationCounters::Clock::now();
+
+    readId_        = next >> 32;
     requestedSize_ = requestedSize;
     processed_     = 0;
     dst_           = data;
     callback_      = callback;
+    RTAC_ASIO_TRACE(read_start, stream_.get(), readId_, requestedSize);
 
-    if(timeoutMillis > 0) {
-        timer_.expires_from_now(Millis(timeoutMillis));
-        timer_.async_wait(std::bind(&StreamReader::timeout_reached, this, readId_, _1));
-    }
+    this->arm_timeout(timeoutMillis);
 
     return true;
 }
 
-void StreamReader::finish_read(const ErrorCode& err)
+void StreamReader::arm_timeout(unsigned int timeoutMillis)
 {
-    std::lock_guard<std::mutex> lock(readMutex_);
-    if(readId_ == 0) {
-        // No read to end (should not happend)
-        return;
+    if(timeoutMillis > 0) {
+        timeout_ = stream_->service()->timer_wheel().arm(timeoutMillis,
+            std::bind(&StreamReader::timeout_reached, this, readId_, ErrorCode()));
     }
-    readId_ = 0;
-    // This calls the user callback in an executor loop (avoid potential
-    // deadlock with the readMutex_if the user callback asks for another read).
-    stream_->service()->post(std::bind(callback_, err, processed_));
+}
+
+void StreamReader::finish_read(const ErrorCode& err)
+{
+    // The Finishing flag keeps the read busy while the callback and the
+    // processed count are retrieved. It also ensures the read is ended only
+    // once.
+    uint64_t state = state_.load();
+    do {
+        if(!(state & Busy) || (state & Finishing)) {
+            // No read to end (should not happend)
+            return;
+        }
+    } while(!state_.compare_exchange_weak(state, state | Finishing));
+
+    stream_->service()->timer_wheel().cancel(timeout_);
+    Callback    callback = std::move(callback_);
+    std::size_t processed = processed_;
+    auto        start     = startTime_;
+    callback_ = nullptr;
+
     // from this moment, requestedSize_, processed_, dst_ and callback_ are
     // devalidated and available for a new read.
+    state_.store(state & ~(Busy | TimedOut | Cancelled | Finishing));
+    RTAC_ASIO_TRACE(read_done, stream_.get(), (unsigned int)(state >> 32),
+                    processed, err.value());
+
+    // This calls the user callback in an executor loop (the user callback
+    // may ask for another read). No lock is held here, the callback may also
+    // be called inline.
+    auto handler = OperationCounters::complete(counters_, callback,
+                                               err, processed, start);
+    if(inlineCompletion_) {
+        stream_->service()->dispatch(handler, PostTag(stream_.get(), "read"));
+    }
+    else {
+        stream_->service()->post(handler, PostTag(stream_.get(), "read"));
+    }
 }
 
 /**
- * Checks if the readId associated with the caller checks out with the current
- * one saved in the readId_ attribute.
+ * Ends a read completed on the calling thread by the synchronous fast path
+ * (see read_now). No timeout was armed and the callback is not called.
+ */
+std::size_t StreamReader::finish_read_sync()
+{
+    uint64_t    state     = state_.load();
+    std::size_t processed = processed_;
+    callback_ = nullptr;
+    state_.store(state & ~(Busy | TimedOut | Cancelled | Finishing));
+    RTAC_ASIO_TRACE(read_done, stream_.get(), (unsigned int)(state >> 32),
+                    processed, 0);
+
+    OperationCounters::complete(counters_, nullptr, ErrorCode(),
+                                processed, startTime_)();
+    return processed;
+}
+
+/**
+ * Checks if the readId associated with the caller is the one of the read
+ * in progress.
  *
  * This allows to potentially detect callbacks which are no longer relevant.
  * (For example a read callback might be called after a timeout already
@@ -147,20 +264,76 @@ void StreamReader::finish_read(const ErrorCode& err)
  */
 bool StreamReader::readid_ok(unsigned int readId) const
 {
-    std::lock_guard<std::mutex> lock(readMutex_);
-    return readId == readId_;
+    uint64_t state = state_.load();
+    return (state >> 32) == readId && (state & Busy) && !(state & Finishing);
 }
 
+/**
+ * The pending operation on the stream is cancelled. The read ends with a
+ * timed_out error in its continuation, once the stream is done with the user
+ * buffer.
+ */
 void StreamReader::timeout_reached(unsigned int readId, const ErrorCode& err)
 {
-    if(!readid_ok(readId)) {
-        return;
+    uint64_t state = state_.load();
+    do {
+        if((state >> 32) != readId || !(state & Busy)
+        || (state & (Finishing | Cancelled))) {
+            return;
+        }
+    } while(!state_.compare_exchange_weak(state, state | TimedOut));
+    RTAC_ASIO_TRACE(read_timeout, stream_.get(), readId);
+
+    if(!stream_->cancel()) {
+        // The stream cannot cancel its operations. The read is ended right
+        // away, but the stream might still write in the user buffer later.
+        this->finish_read(boost::asio::error::timed_out);
     }
-    // If timeout was reached, a waiter might have been set
-    waiterNotified_ = true;
-    waiter_.notify_all();
-    this->finish_read(ErrorCode()); // error should be timeout but could not
-                                    // find how to make one.
+}
+
+/**
+ * Cancels the read in progress started by this reader. It ends with
+ * operation_aborted once the stream is done with the user buffer. Returns
+ * false if there is no read to cancel.
+ */
+bool StreamReader::cancel()
+{
+    uint64_t state = state_.load();
+    do {
+        if(!(state & Busy) || (state & (Finishing | TimedOut | Cancelled))) {
+            return false;
+        }
+    } while(!state_.compare_exchange_weak(state, state | Cancelled));
+
+    if(!stream_->cancel()) {
+        // Same limitation as timeout_reached.
+        this->finish_read(boost::asio::error::operation_aborted);
+    }
+    return true;
+}
+
+// The read was ended by its timeout or by cancel().
+bool StreamReader::aborted() const
+{
+    return state_.load() & (TimedOut | Cancelled);
+}
+
+StreamInterface::ErrorCode StreamReader::abort_error() const
+{
+    if(state_.load() & TimedOut) {
+        return boost::asio::error::timed_out;
+    }
+    return boost::asio::error::operation_aborted;
+}
+
+/**
+ * An operation aborted while its timeout was not reached was cancelled for
+ * another reason (for example the timeout of a write on the same stream).
+ * It must be started again.
+ */
+bool StreamReader::must_reissue(const ErrorCode& err) const
+{
+    return err == boost::asio::error::operation_aborted && stream_->is_open();
 }
 
 /**
@@ -177,21 +350,24 @@ void StreamReader::timeout_reached(unsigned int readId, const ErrorCode& err)
 void StreamReader::do_read_some(std::size_t count, uint8_t* data,
                                 Callback callback)
 {
+    std::unique_lock<std::mutex> lock(rxMutex_);
     if(readBuffer_.size() > 0) {
-        // readBuffer_ not empty
-        std::istream is(&readBuffer_);
-        char c = is.get();
-        int readCount = 0;
-        while(!is.eof() && readCount < count) {
-            data[readCount] = c;
-            readCount++;
-            c = is.get();
-        }
-        //readBuffer_.consume(readCount); // must not use this when using streams
-                                          // @#(&*@^$*@$% boost doc
-        stream_->service()->post(std::bind(callback, ErrorCode(), readCount));
+        // readBuffer_ not empty. Its input sequence is contiguous, it is
+        // copied in one go.
+        std::size_t readCount = readBuffer_.sgetn((char*)data, count);
+        counters_->add(counters_->buffered, readCount);
+        stream_->service()->post(std::bind(callback, ErrorCode(), readCount),
+                                 PostTag(stream_.get(), "read"));
+    }
+    else if(rxPending_) {
+        // A read started by a previous frame read is still pending. Its data
+        // comes first. This read is resumed when it completes.
+        deferredRead_ = std::bind(&StreamReader::do_read_some, this,
+                                  count, data, callback);
+        deferredCallback_ = callback;
     }
     else {
+        lock.unlock();
         if(!this->dump_enabled()) {
             stream_->async_read_some(count, data, callback);
         }
@@ -205,6 +381,9 @@ void StreamReader::do_read_some(std::size_t count, uint8_t* data,
 bool StreamReader::async_read_some(std::size_t count, uint8_t* data,
                                    Callback callback, unsigned int timeoutMillis)
 {
+    if(readQueue_) {
+        return readQueue_->async_read(count, data, callback, false, timeoutMillis);
+    }
     if(!this->new_read(count, data, callback, timeoutMillis)) {
         return false;
     }
@@ -222,12 +401,62 @@ void StreamReader::async_read_some_continue(unsigned int readId,
         return;
     }
     processed_ = readCount;
-    this->finish_read(err);
+    if(readCount > 0) {
+        this->finish_read(err);
+    }
+    else if(this->aborted()) {
+        this->finish_read(this->abort_error());
+    }
+    else if(this->must_reissue(err)) {
+        this->do_read_some(requestedSize_, dst_,
+            std::bind(&StreamReader::async_read_some_continue, this, readId, _1, _2));
+    }
+    else {
+        this->finish_read(err);
+    }
+}
+
+bool StreamReader::async_read_borrowed(BorrowedCallback callback,
+                                       unsigned int timeoutMillis)
+{
+    if(!blockPool_) {
+        blockPool_ = ReadBlockPool::Create();
+    }
+    auto lease = blockPool_->acquire();
+    if(!lease) {
+        // all blocks are still held by the user.
+        return false;
+    }
+    uint8_t* block = blockPool_->block(lease->index);
+    // If the read cannot be started, the lease is released with the bound
+    // callback and the block goes back to the pool.
+    return this->async_read_some(blockPool_->block_size(), block,
+        std::bind(&StreamReader::borrowed_read_continue, this,
+                  lease, block, callback, _1, _2),
+        timeoutMillis);
+}
+
+void StreamReader::borrowed_read_continue(std::shared_ptr<BorrowedBuffer::Lease>& lease,
+                                          const uint8_t* block,
+                                          BorrowedCallback callback,
+                                          const ErrorCode& err,
+                                          std::size_t readCount)
+{
+    // lease refers to the copy stored in the bound handler. It is moved out
+    // so that the block only belongs to the user from now on (the handler
+    // may be destroyed long after the user released the buffer).
+    BorrowedBuffer buffer(std::move(lease), block, readCount);
+    if(callback) {
+        callback(err, std::move(buffer));
+    }
 }
 
 bool StreamReader::async_read(std::size_t count, uint8_t* data,
                               Callback callback, unsigned int timeoutMillis)
 {
+    if(readQueue_) {
+        return readQueue_->async_read(count, data, callback, true, timeoutMillis);
+    }
     if(!this->new_read(count, data, callback, timeoutMillis)) {
         return false;
     }
@@ -247,7 +476,13 @@ void StreamReader::async_read_continue(unsigned int readId, const ErrorCode& err
     }
 
     processed_ += readCount;
-    if(!err && processed_ < requestedSize_) {
+    if(processed_ >= requestedSize_) {
+        this->finish_read(err);
+    }
+    else if(this->aborted()) {
+        this->finish_read(this->abort_error());
+    }
+    else if(!err || this->must_reissue(err)) {
         this->do_read_some(requestedSize_ - processed_, dst_ + processed_,
             std::bind(&StreamReader::async_read_continue, this, readId, _1, _2));
     }
@@ -261,57 +496,186 @@ std::size_t StreamReader::read(std::size_t count, uint8_t* data,
 {
     std::unique_lock<std::mutex> lock(mutex_); // will release mutex when out of scope
 
-    if(!this->async_read(count, data,
-                         std::bind(&StreamReader::read_callback, this, _1, _2),
-                         timeoutMillis))
+    // reset before starting the operation, which might complete before the
+    // wait below. This also protects against spurious wakeups.
+    waiterNotified_ = false;
+    waiterSleeping_ = false;
+    if(readQueue_) {
+        if(!this->async_read(count, data,
+                             std::bind(&StreamReader::read_callback, this, _1, _2),
+                             timeoutMillis))
+        {
+            // device probably busy
+            return 0;
+        }
+        this->wait_sync(lock);
+        return syncCount_;
+    }
+
+    if(!this->new_read(count, data,
+                       std::bind(&StreamReader::read_callback, this, _1, _2)))
     {
         // device probably busy
         return 0;
     }
+    if(this->read_now()) {
+        return this->finish_read_sync();
+    }
+
+    // Not enough data yet, the read continues in the service.
+    this->arm_timeout(timeoutMillis);
+    this->do_read_some(requestedSize_ - processed_, dst_ + processed_,
+        std::bind(&StreamReader::async_read_continue, this, readId_, _1, _2));
 
-    waiterNotified_ = false; // this protects against spurious wakeups.
-    waiter_.wait(lock, [&]{ return waiterNotified_; });
+    this->wait_sync(lock);
 
-    return processed_;
+    return syncCount_;
 }
 
 void StreamReader::read_callback(const ErrorCode& err, std::size_t readCount)
 {
     // finish read was already called through the async_read primitive
+    syncCount_ = readCount;
     waiterNotified_ = true;
-    waiter_.notify_all();
+    if(waiterSleeping_) {
+        // The lock ensures the reader is either before checking
+        // waiterNotified_ or waiting on waiter_.
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        waiter_.notify_all();
+    }
+}
+
+/**
+ * Synchronous fast path of read and read_until.
+ *
+ * Going through the service costs two thread handoffs (the completion is
+ * posted to the service thread, which then wakes up the reader) even when
+ * the leftovers in readBuffer_ already hold the requested data. The read
+ * started with new_read is first fulfilled on the calling thread from the
+ * leftovers, then from the data already available on the stream
+ * (StreamInterface::try_read_some, without blocking).
+ *
+ * Returns true if the read is complete (requested size reached or, with a
+ * delimiter, delimiter found). Otherwise processed_ bytes were already
+ * written in the user buffer and the read must be continued asynchronously.
+ * Errors of the non-blocking read are left to the asynchronous read.
+ */
+bool StreamReader::read_now(bool untilDelimiter, char delimiter)
+{
+    std::lock_guard<std::mutex> lock(rxMutex_);
+    if(rxPending_) {
+        // A read started by a previous frame read is still pending. Its data
+        // comes first.
+        return false;
+    }
+    if(untilDelimiter) {
+        if(this->read_buffered_until(delimiter)) {
+            return true;
+        }
+    }
+    else if(readBuffer_.size() > 0) {
+        processed_ = readBuffer_.sgetn((char*)dst_, requestedSize_);
+        counters_->add(counters_->buffered, processed_);
+    }
+    if(processed_ >= requestedSize_) {
+        return true;
+    }
+
+    ErrorCode   err;
+    uint8_t*    data      = dst_ + processed_;
+    std::size_t readCount = stream_->try_read_some(requestedSize_ - processed_,
+                                                   data, err);
+    if(readCount == 0) {
+        return false;
+    }
+    if(this->dump_enabled()) {
+        rxDump_.write((const char*)data, readCount);
+        rxDump_.flush();
+    }
+    if(untilDelimiter) {
+        auto found = (const uint8_t*)std::memchr(data, delimiter, readCount);
+        if(found) {
+            // remaining data kept for the next read.
+            std::size_t count = found - data + 1;
+            readBuffer_.sputn((const char*)data + count, readCount - count);
+            processed_ += count;
+            return true;
+        }
+    }
+    processed_ += readCount;
+    return processed_ >= requestedSize_;
+}
+
+/**
+ * Copies the leftovers of readBuffer_ in the user buffer, up to the
+ * delimiter or the requested size. Returns true if the delimiter was found.
+ * Called with rxMutex_ held.
+ */
+bool StreamReader::read_buffered_until(char delimiter)
+{
+    if(readBuffer_.size() == 0) {
+        return false;
+    }
+    auto buffered = readBuffer_.data();
+    const char* begin = boost::asio::buffer_cast<const char*>(buffered);
+    std::size_t size  = std::min(boost::asio::buffer_size(buffered),
+                                 requestedSize_);
+    const char* found = (const char*)std::memchr(begin, delimiter, size);
+    if(found) {
+        size = found - begin + 1;
+    }
+    processed_ = readBuffer_.sgetn((char*)dst_, size);
+    counters_->add(counters_->buffered, processed_);
+    return found != nullptr;
+}
+
+/**
+ * Waits for read_callback, called with mutex_ held. A spinning reader does
+ * not need the callback to take mutex_, the callback does not have to wait
+ * for the reader thread to be scheduled.
+ */
+void StreamReader::wait_sync(std::unique_lock<std::mutex>& lock)
+{
+    if(spinMicros_ > 0) {
+        auto deadline = std::chrono::steady_clock::now()
+                      + std::chrono::microseconds(spinMicros_);
+        for(unsigned int i = 1; !waiterNotified_; i++) {
+            if(i % 64 == 0 && std::chrono::steady_clock::now() > deadline) {
+                break;
+            }
+            spin_pause();
+        }
+    }
+    waiterSleeping_ = true;
+    waiter_.wait(lock, [&]{ return waiterNotified_.load(); });
 }
 
 bool StreamReader::async_read_until(std::size_t maxSize, uint8_t* data, char delimiter,
                                     Callback callback, unsigned int timeoutMillis)
 {
+    if(readQueue_) {
+        std::cerr << "rtac::asio::StreamReader : async_read_until is not "
+                  << "available in queued read mode." << std::endl;
+        return false;
+    }
     if(!this->new_read(maxSize, data, callback, timeoutMillis)) {
         return false;
     }
     
     // First checking if delimiter in buffer
-    if(readBuffer_.size() > 0) {
-        // readBuffer_ not empty
-        std::istream is(&readBuffer_);
-        char c = is.get();
-        while(!is.eof()) {
-            dst_[processed_] = c;
-            processed_++;
-            if(c == delimiter || processed_ >= requestedSize_) {
-                // delimiter found or maximum user buffer size reached
-                //readBuffer_.consume(processed_); // must not use this when using streams
-                                                   // @#(&*@^$*@$% boost doc
-                this->finish_read(ErrorCode());
-                return true;
-            }
-            c = is.get();
-        }
-        //readBuffer_.consume(processed_); // must not use this when using streams
-                                           // @#(&*@^$*@$% boost doc
+    bool found;
+    {
+        std::lock_guard<std::mutex> lock(rxMutex_);
+        found = this->read_buffered_until(delimiter);
+    }
+    if(found || processed_ >= requestedSize_) {
+        // delimiter found or maximum user buffer size reached
+        this->finish_read(ErrorCode());
+        return true;
     }
     
     // if reaching here, readBuffer_ is empty
-    this->do_read_some(requestedSize_, dst_ + processed_,
+    this->do_read_some(requestedSize_ - processed_, dst_ + processed_,
         std::bind(&StreamReader::async_read_until_continue, this,
                   readId_, delimiter, _1, _2));
 
@@ -329,28 +693,28 @@ void StreamReader::async_read_until_continue(unsigned int readId,
     }
 
     const uint8_t* data = dst_ + processed_;
-    int i = 0;
-    for(; i < readCount; i++) {
-        if(data[i] == delimiter) {
-            // delimiter was found. Saving remaining data in readBuffer_
-            i++;
-            std::ostream os(&readBuffer_);
-            unsigned int toBeCommited = 0;
-            for(int j = i; j < readCount; j++) {
-                os << data[j];
-                toBeCommited++;
-            }
-            //readBuffer_.commit(toBeCommited); // must not use this when using streams
-                                                // @#(&*@^$*@$% boost doc
-            processed_ += i;
-            this->finish_read(err);
-            return;
+    const uint8_t* found = (const uint8_t*)std::memchr(data, delimiter, readCount);
+    if(found) {
+        // delimiter was found. Saving remaining data in readBuffer_
+        std::size_t count = found - data + 1;
+        {
+            std::lock_guard<std::mutex> lock(rxMutex_);
+            readBuffer_.sputn((const char*)data + count, readCount - count);
         }
+        processed_ += count;
+        this->finish_read(err);
+        return;
     }
 
     // delimiter was not found.
-    processed_ += i;
-    if(err || processed_ >= requestedSize_) {
+    processed_ += readCount;
+    if(processed_ >= requestedSize_) {
+        this->finish_read(err);
+    }
+    else if(this->aborted()) {
+        this->finish_read(this->abort_error());
+    }
+    else if(err && !this->must_reissue(err)) {
         this->finish_read(err);
     }
     else {
@@ -366,18 +730,224 @@ std::size_t StreamReader::read_until(std::size_t maxSize, uint8_t* data,
 {
     std::unique_lock<std::mutex> lock(mutex_); // will release mutex when out of scope
 
-    if(!this->async_read_until(maxSize, data, delimiter,
-                               std::bind(&StreamReader::read_callback, this, _1, _2),
-                               timeoutMillis))
+    // reset before starting the operation, which might complete before the
+    // wait below. This also protects against spurious wakeups.
+    waiterNotified_ = false;
+    waiterSleeping_ = false;
+    if(readQueue_) {
+        std::cerr << "rtac::asio::StreamReader : read_until is not "
+                  << "available in queued read mode." << std::endl;
+        return 0;
+    }
+    if(!this->new_read(maxSize, data,
+                       std::bind(&StreamReader::read_callback, this, _1, _2)))
     {
         // device probably busy
         return 0;
     }
+    if(this->read_now(true, delimiter)) {
+        return this->finish_read_sync();
+    }
+
+    // delimiter not found yet, the read continues in the service.
+    this->arm_timeout(timeoutMillis);
+    this->do_read_some(requestedSize_ - processed_, dst_ + processed_,
+        std::bind(&StreamReader::async_read_until_continue, this,
+                  readId_, delimiter, _1, _2));
+
+    this->wait_sync(lock);
+
+    return syncCount_;
+}
+
+bool StreamReader::async_read_frame(std::size_t maxSize, uint8_t* data,
+                                    Callback callback,
+                                    unsigned int timeoutMillis,
+                                    unsigned int gapMicros)
+{
+    if(readQueue_) {
+        std::cerr << "rtac::asio::StreamReader : async_read_frame is not "
+                  << "available in queued read mode." << std::endl;
+        return false;
+    }
+    if(gapMicros == 0) {
+        gapMicros = stream_->frame_gap_micros();
+    }
+    if(gapMicros == 0) {
+        std::cerr << "rtac::asio::StreamReader : no inter-frame gap given and "
+                  << "the stream does not define one." << std::endl;
+        return false;
+    }
+    if(!this->new_read(maxSize, data, callback, timeoutMillis)) {
+        return false;
+    }
+    frameGap_ = Micros(gapMicros);
+
+    // The frame state (gap timer and rxChunk_) is only handled from the
+    // service thread.
+    stream_->service()->post(std::bind(&StreamReader::start_frame, this, readId_),
+                             PostTag(stream_.get(), "frame"));
+
+    return true;
+}
+
+void StreamReader::start_frame(unsigned int readId)
+{
+    if(!readid_ok(readId)) {
+        // timeout already reached
+        return;
+    }
+    if(this->aborted()) {
+        this->finish_read(this->abort_error());
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(rxMutex_);
+        frameReadId_ = readId;
+        // data received after the end of the previous frame
+        if(readBuffer_.size() > 0) {
+            processed_ = readBuffer_.sgetn((char*)dst_, requestedSize_);
+            counters_->add(counters_->buffered, processed_);
+        }
+    }
+    if(processed_ >= requestedSize_) {
+        this->finish_read(ErrorCode());
+        return;
+    }
+    if(processed_ > 0) {
+        this->arm_gap_timer(readId);
+    }
+    this->read_frame_chunk();
+}
+
+void StreamReader::read_frame_chunk()
+{
+    std::lock_guard<std::mutex> lock(rxMutex_);
+    if(rxPending_) {
+        // A read is already pending (started by a previous frame).
+        return;
+    }
+    if(rxChunk_.size() == 0) {
+        rxChunk_.resize(FrameChunkSize);
+    }
+    rxPending_ = true;
+    stream_->async_read_some(rxChunk_.size(), rxChunk_.data(),
+        std::bind(&StreamReader::frame_chunk_received, this, _1, _2));
+}
+
+void StreamReader::frame_chunk_received(const ErrorCode& err, std::size_t readCount)
+{
+    if(!err && this->dump_enabled()) {
+        rxDump_.write((const char*)rxChunk_.data(), readCount);
+        rxDump_.flush();
+    }
+
+    unsigned int readId;
+    std::function<void()> deferred;
+    Callback              deferredCallback;
+    {
+        std::lock_guard<std::mutex> lock(rxMutex_);
+        rxPending_ = false;
+        readId     = frameReadId_;
+    }
+    bool inFrame = readid_ok(readId);
+    {
+        std::lock_guard<std::mutex> lock(rxMutex_);
+        std::size_t count = 0;
+        if(inFrame) {
+            count = std::min(readCount, requestedSize_ - processed_);
+            std::memcpy(dst_ + processed_, rxChunk_.data(), count);
+            processed_ += count;
+        }
+        if(count < readCount) {
+            // end of a truncated frame or data received outside of a frame
+            // read. Kept for the next read.
+            readBuffer_.sputn((const char*)rxChunk_.data() + count,
+                              readCount - count);
+        }
+        if(!inFrame) {
+            deferred         = std::move(deferredRead_);
+            deferredCallback = std::move(deferredCallback_);
+            deferredRead_     = nullptr;
+            deferredCallback_ = nullptr;
+        }
+    }
+
+    if(!inFrame) {
+        if(deferred && err && readCount == 0) {
+            // The deferred read shares the fate of the read it waited for
+            // (a cancelled read must not start a new operation).
+            deferredCallback(err, 0);
+        }
+        else if(deferred) {
+            deferred();
+        }
+        return;
+    }
+
+    ErrorCode status = err;
+    if(processed_ < requestedSize_ && this->aborted()) {
+        status = this->abort_error();
+    }
+    else if(this->must_reissue(err)) {
+        // the frame read continues.
+        this->read_frame_chunk();
+        return;
+    }
+    if(status || processed_ >= requestedSize_) {
+        ErrorCode ignored;
+        gapTimer_.cancel(ignored);
+        this->finish_read(status);
+        return;
+    }
+    if(readCount > 0) {
+        this->arm_gap_timer(readId);
+    }
+    this->read_frame_chunk();
+}
+
+void StreamReader::arm_gap_timer(unsigned int readId)
+{
+    // expires_from_now cancels the previous wait.
+    gapCounter_++;
+    gapTimer_.expires_from_now(frameGap_);
+    gapTimer_.async_wait(std::bind(&StreamReader::gap_reached, this,
+                                   readId, gapCounter_, _1));
+}
+
+void StreamReader::gap_reached(unsigned int readId, unsigned int gapId,
+                               const ErrorCode& err)
+{
+    // gapId detects a wait which completed before being cancelled by a new
+    // chunk.
+    if(err || gapId != gapCounter_ || !readid_ok(readId)) {
+        return;
+    }
+    // The read started on rxChunk_ is left pending for the next frame.
+    this->finish_read(ErrorCode());
+}
+
+std::size_t StreamReader::read_frame(std::size_t maxSize, uint8_t* data,
+                                     unsigned int timeoutMillis,
+                                     unsigned int gapMicros)
+{
+    std::unique_lock<std::mutex> lock(mutex_); // will release mutex when out of scope
+
+    // reset before starting the operation, which might complete before the
+    // wait below. This also protects against spurious wakeups.
+    waiterNotified_ = false;
+    waiterSleeping_ = false;
+    if(!this->async_read_frame(maxSize, data,
+                               std::bind(&StreamReader::read_callback, this, _1, _2),
+                               timeoutMillis, gapMicros))
+    {
+        // device probably busy or no gap
+        return 0;
+    }
 
-    waiterNotified_ = false; // this protects against spurious wakeups.
-    waiter_.wait(lock, [&]{ return waiterNotified_; });
+    this->wait_sync(lock);
 
-    return processed_;
+    return syncCount_;
 }
 
 } //namespace asio
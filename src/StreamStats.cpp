@@ -0,0 +1,350 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/StreamStats.h>
+
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+#include <boost/asio/error.hpp>
+
+#include <rtac_asio/tracepoints.h>
+
+namespace rtac { namespace asio {
+
+LatencyHistogram::LatencyHistogram() :
+    count_(0),
+    sum_(0),
+    min_(std::numeric_limits<uint64_t>::max()),
+    max_(0)
+{
+    for(auto& b : buckets_) {
+        b.store(0, std::memory_order_relaxed);
+    }
+}
+
+unsigned int LatencyHistogram::bucket_index(uint64_t value)
+{
+    if(value < SubBuckets) {
+        return value;
+    }
+    unsigned int exponent = 63 - __builtin_clzll(value);
+    if(exponent > MaxExponent) {
+        return BucketCount - 1;
+    }
+    return (exponent - SubBits + 1) * SubBuckets
+         + ((value >> (exponent - SubBits)) & (SubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(unsigned int index)
+{
+    if(index < SubBuckets) {
+        return index;
+    }
+    unsigned int exponent = index / SubBuckets + SubBits - 1;
+    uint64_t     sub      = index % SubBuckets;
+    uint64_t     width    = uint64_t(1) << (exponent - SubBits);
+    return (SubBuckets + sub) * width + width - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanos)
+{
+    buckets_[bucket_index(nanos)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(nanos, std::memory_order_relaxed);
+
+    // min and max are rarely updated once the histogram is warm.
+    uint64_t current = min_.load(std::memory_order_relaxed);
+    while(nanos < current
+          && !min_.compare_exchange_weak(current, nanos, std::memory_order_relaxed));
+    current = max_.load(std::memory_order_relaxed);
+    while(nanos > current
+          && !max_.compare_exchange_weak(current, nanos, std::memory_order_relaxed));
+}
+
+void LatencyHistogram::reset()
+{
+    for(auto& b : buckets_) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    count_ = 0;
+    sum_   = 0;
+    min_   = std::numeric_limits<uint64_t>::max();
+    max_   = 0;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot res;
+    res.count = count_.load(std::memory_order_relaxed);
+    if(res.count == 0) {
+        return res;
+    }
+    res.sum = sum_.load(std::memory_order_relaxed);
+    res.min = min_.load(std::memory_order_relaxed);
+    res.max = max_.load(std::memory_order_relaxed);
+    res.buckets.resize(BucketCount);
+    for(unsigned int i = 0; i < BucketCount; i++) {
+        res.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const
+{
+    if(buckets.size() == 0) {
+        return 0;
+    }
+    // The buckets and count are read while recording goes on, the total of
+    // the buckets is used as the reference.
+    uint64_t total = 0;
+    for(auto b : buckets) total += b;
+    uint64_t target = std::max<uint64_t>(1, std::ceil(p / 100.0 * total));
+    uint64_t seen = 0;
+    for(unsigned int i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if(seen >= target) {
+            return std::min(bucket_upper_bound(i), max);
+        }
+    }
+    return max;
+}
+
+OperationCounters::OperationCounters() :
+    ops(0),
+    bytes(0),
+    timeouts(0),
+    errors(0),
+    busy(0),
+    buffered(0),
+    paced(0)
+{}
+
+namespace {
+
+struct Dispatch
+{
+    OperationCounters::Ptr      counters;
+    OperationCounters::Callback callback;
+    OperationCounters::ErrorCode err;
+    std::size_t                  count;
+    OperationCounters::Clock::time_point completed;
+
+    void operator()() const {
+        counters->dispatch.record(OperationCounters::Clock::now() - completed);
+        if(callback) {
+            callback(err, count);
+        }
+    }
+};
+
+} //namespace
+
+std::function<void()> OperationCounters::complete(const Ptr& counters,
+                                                  const Callback& callback,
+                                                  const ErrorCode& err,
+                                                  std::size_t count,
+                                                  Clock::time_point start)
+{
+    auto now = Clock::now();
+    counters->add(counters->ops);
+    counters->add(counters->bytes, count);
+    if(err == boost::asio::error::timed_out) {
+        counters->add(counters->timeouts);
+    }
+    else if(err) {
+        counters->add(counters->errors);
+    }
+    counters->latency.record(now - start);
+    return Dispatch{counters, callback, err, count, now};
+}
+
+OperationCounters::Snapshot OperationCounters::snapshot() const
+{
+    Snapshot res;
+    res.ops      = ops.load(std::memory_order_relaxed);
+    res.bytes    = bytes.load(std::memory_order_relaxed);
+    res.timeouts = timeouts.load(std::memory_order_relaxed);
+    res.errors   = errors.load(std::memory_order_relaxed);
+    res.busy     = busy.load(std::memory_order_relaxed);
+    res.buffered = buffered.load(std::memory_order_relaxed);
+    res.paced    = paced.load(std::memory_order_relaxed);
+    res.latency  = latency.snapshot();
+    res.dispatch = dispatch.snapshot();
+    res.pacing   = pacing.snapshot();
+    return res;
+}
+
+void TransportCounters::Direction::submit(std::size_t size)
+{
+    uint64_t seq = submitted.fetch_add(1, std::memory_order_relaxed) + 1;
+    RTAC_ASIO_TRACE(transport_submit, stream, direction, seq, size);
+    (void)seq; (void)size;
+}
+
+void TransportCounters::Direction::complete(const boost::system::error_code& err,
+                                            std::size_t count)
+{
+    uint64_t seq = completed.fetch_add(1, std::memory_order_relaxed) + 1;
+    if(count > 0) bytes.fetch_add(count, std::memory_order_relaxed);
+    if(err)       errors.fetch_add(1, std::memory_order_relaxed);
+    RTAC_ASIO_TRACE(transport_complete, stream, direction, seq, count, err.value());
+    (void)seq;
+}
+
+TransportCounters::Snapshot TransportCounters::snapshot() const
+{
+    Snapshot res;
+    res.rx.submitted = rx.submitted.load(std::memory_order_relaxed);
+    res.rx.completed = rx.completed.load(std::memory_order_relaxed);
+    res.rx.bytes     = rx.bytes.load(std::memory_order_relaxed);
+    res.rx.errors    = rx.errors.load(std::memory_order_relaxed);
+    res.tx.submitted = tx.submitted.load(std::memory_order_relaxed);
+    res.tx.completed = tx.completed.load(std::memory_order_relaxed);
+    res.tx.bytes     = tx.bytes.load(std::memory_order_relaxed);
+    res.tx.errors    = tx.errors.load(std::memory_order_relaxed);
+    return res;
+}
+
+namespace {
+
+void text_histogram(std::ostream& os, const std::string& label,
+                    const LatencyHistogram::Snapshot& h)
+{
+    os << "  " << label << " (us) : ";
+    if(h.count == 0) {
+        os << "-\n";
+        return;
+    }
+    os << std::fixed << std::setprecision(1)
+       << "mean " << h.mean() / 1000.0
+       << ", p50 "   << h.percentile(50.0) / 1000.0
+       << ", p99 "   << h.percentile(99.0) / 1000.0
+       << ", p99.9 " << h.percentile(99.9) / 1000.0
+       << ", max "   << h.max / 1000.0 << '\n';
+}
+
+void text_operations(std::ostream& os, const std::string& label,
+                     const OperationCounters::Snapshot& c, bool reader)
+{
+    os << label << " : " << c.ops << " ops, " << c.bytes << " bytes, "
+       << c.timeouts << " timeouts, " << c.errors << " errors, "
+       << c.busy << " busy";
+    if(reader) {
+        os << ", " << c.buffered << " buffered bytes";
+    }
+    else {
+        os << ", " << c.paced << " paced";
+    }
+    os << '\n';
+    text_histogram(os, "latency ", c.latency);
+    text_histogram(os, "dispatch", c.dispatch);
+    if(!reader && c.paced > 0) {
+        text_histogram(os, "pacing  ", c.pacing);
+    }
+}
+
+void json_histogram(std::ostream& os, const LatencyHistogram::Snapshot& h)
+{
+    os << "{\"count\":" << h.count
+       << ",\"mean\":"  << std::fixed << std::setprecision(1) << h.mean()
+       << ",\"min\":"   << h.min
+       << ",\"p50\":"   << h.percentile(50.0)
+       << ",\"p90\":"   << h.percentile(90.0)
+       << ",\"p99\":"   << h.percentile(99.0)
+       << ",\"p999\":"  << h.percentile(99.9)
+       << ",\"max\":"   << h.max << '}';
+}
+
+void json_operations(std::ostream& os, const OperationCounters::Snapshot& c)
+{
+    os << "{\"ops\":"     << c.ops
+       << ",\"bytes\":"    << c.bytes
+       << ",\"timeouts\":" << c.timeouts
+       << ",\"errors\":"   << c.errors
+       << ",\"busy\":"     << c.busy
+       << ",\"buffered\":" << c.buffered
+       << ",\"paced\":"    << c.paced
+       << ",\"latency_ns\":";
+    json_histogram(os, c.latency);
+    os << ",\"dispatch_ns\":";
+    json_histogram(os, c.dispatch);
+    os << ",\"pacing_ns\":";
+    json_histogram(os, c.pacing);
+    os << '}';
+}
+
+void json_direction(std::ostream& os, const TransportCounters::Snapshot::Direction& d)
+{
+    os << "{\"submitted\":" << d.submitted
+       << ",\"completed\":"  << d.completed
+       << ",\"bytes\":"      << d.bytes
+       << ",\"errors\":"     << d.errors << '}';
+}
+
+} //namespace
+
+std::string StreamStats::to_text() const
+{
+    std::ostringstream oss;
+    text_operations(oss, "reader", reader, true);
+    text_operations(oss, "writer", writer, false);
+    oss << "transport : rx " << transport.rx.completed << "/" << transport.rx.submitted
+        << " ops, " << transport.rx.bytes << " bytes, " << transport.rx.errors
+        << " errors ; tx " << transport.tx.completed << "/" << transport.tx.submitted
+        << " ops, " << transport.tx.bytes << " bytes, " << transport.tx.errors
+        << " errors\n";
+    return oss.str();
+}
+
+std::string StreamStats::to_json() const
+{
+    std::ostringstream oss;
+    oss << "{\"reader\":";
+    json_operations(oss, reader);
+    oss << ",\"writer\":";
+    json_operations(oss, writer);
+    oss << ",\"transport\":{\"rx\":";
+    json_direction(oss, transport.rx);
+    oss << ",\"tx\":";
+    json_direction(oss, transport.tx);
+    oss << "}}";
+    return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const StreamStats& stats)
+{
+    os << stats.to_text();
+    return os;
+}
+
+} //namespace asio
+} //namespace rtac
@@ -28,19 +28,28 @@
 
 #include <rtac_asio/StreamWriter.h>
 
+#include <rtac_asio/tracepoints.h>
+
 using namespace std::placeholders;
 
 namespace rtac { namespace asio {
 
 StreamWriter::StreamWriter(StreamInterface::Ptr stream) :
     stream_(stream),
-    writeCounter_(0),
+    state_(0),
     writeId_(0),
-    timer_(stream_->service()->service())
+    counters_(OperationCounters::Create()),
+    inlineCompletion_(false),
+    waiterNotified_(false),
+    waiterSleeping_(false),
+    spinMicros_(0),
+    dumpBuffer_(stream_->service()->buffer_pool().allocator<uint8_t>())
 {}
 
 StreamWriter::~StreamWriter()
 {
+    stream_->service()->timer_wheel().cancel(timeout_);
+    this->disable_scheduled_writes();
     this->disable_dump();
 }
 
@@ -59,6 +68,59 @@ void StreamWriter::reset()
     stream_->reset();
 }
 
+bool StreamWriter::enable_scheduled_writes(const WriteScheduler::Parameters& params)
+{
+    if(scheduler_) {
+        return true;
+    }
+    if(state_.load() & Busy) {
+        std::cerr << "rtac::asio::StreamWriter : cannot enable scheduled writes "
+                  << "while a write is in progress." << std::endl;
+        return false;
+    }
+    scheduler_ = WriteScheduler::Create(stream_, params, &txDump_, counters_);
+    scheduler_->set_pacer(pacer_);
+    return true;
+}
+
+void StreamWriter::disable_scheduled_writes()
+{
+    if(!scheduler_) {
+        return;
+    }
+    scheduler_->stop();
+    scheduler_ = nullptr;
+}
+
+bool StreamWriter::enable_pacing(double bytesPerSecond, std::size_t burst)
+{
+    if(pacer_) {
+        pacer_->set_rate(bytesPerSecond, burst);
+        return true;
+    }
+    if(state_.load() & Busy) {
+        std::cerr << "rtac::asio::StreamWriter : cannot enable pacing "
+                  << "while a write is in progress." << std::endl;
+        return false;
+    }
+    pacer_ = WritePacer::Create(stream_, bytesPerSecond, burst, counters_);
+    if(scheduler_) {
+        scheduler_->set_pacer(pacer_);
+    }
+    return true;
+}
+
+void StreamWriter::disable_pacing()
+{
+    if(!pacer_) {
+        return;
+    }
+    if(scheduler_) {
+        scheduler_->set_pacer(nullptr);
+    }
+    pacer_ = nullptr;
+}
+
 void StreamWriter::enable_dump(const std::string& filename, bool appendMode)
 {
     if(txDump_.is_open()) {
@@ -70,6 +132,12 @@ void StreamWriter::enable_dump(const std::string& filename, bool appendMode)
     if(appendMode) {
         mode = std::ofstream::app;
     }
+    if(dumpBuffer_.size() == 0) {
+        // Must be set before opening the file. The buffer is kept by the
+        // filebuf after close, so it is kept until destruction.
+        dumpBuffer_.resize(DumpBufferSize);
+        txDump_.rdbuf()->pubsetbuf((char*)dumpBuffer_.data(), dumpBuffer_.size());
+    }
     txDump_.open(filename, mode);
     if(!txDump_.is_open()) {
         std::cerr << "rtac_asio : Could not open file "
@@ -99,22 +167,30 @@ void StreamWriter::dump_callback(Callback callback, const uint8_t* data,
 bool StreamWriter::new_write(std::size_t requestedSize, const uint8_t* data,
                              Callback callback, unsigned int timeoutMillis)
 {
-    std::lock_guard<std::mutex> lock(writeMutex_);
-    if(writeId_ != 0) {
+    uint64_t state = state_.load();
+    if(state & Busy) {
         // device busy
+        counters_->add(counters_->busy);
         return false;
     }
-    
-    writeCounter_++;
-    writeId_        = writeCounter_;
+    uint64_t next = ((state >> 32) + 1) << 32;
+    if(!state_.compare_exchange_strong(state, next | Busy)) {
+        // another write was started in the meantime
+        counters_->add(counters_->busy);
+        return false;
+    }
+    startTime_ = OperationCounters::Clock::now();
+
+    writeId_       = next >> 32;
     requestedSize_ = requestedSize;
     processed_     = 0;
     src_           = data;
     callback_      = callback;
+    RTAC_ASIO_TRACE(write_start, stream_.get(), writeId_, requestedSize);
 
     if(timeoutMillis > 0) {
-        timer_.expires_from_now(Millis(timeoutMillis));
-        timer_.async_wait(std::bind(&StreamWriter::timeout_reached, this, writeId_, _1));
+        timeout_ = stream_->service()->timer_wheel().arm(timeoutMillis,
+            std::bind(&StreamWriter::timeout_reached, this, writeId_, ErrorCode()));
     }
 
     return true;
@@ -122,61 +198,155 @@ bool StreamWriter::new_write(std::size_t requestedSize, const uint8_t* data,
 
 void StreamWriter::finish_write(const ErrorCode& err)
 {
-    std::lock_guard<std::mutex> lock(writeMutex_);
-    if(writeId_ == 0) {
-        // No write to end (should not happend)
-        return;
-    }
-    writeId_ = 0;
-    // This calls the user callback in an executor loop (avoid potential
-    // deadlock with the writeMutex_if the user callback asks for another write).
-    stream_->service()->post(std::bind(callback_, err, processed_));
+    // The Finishing flag keeps the write busy while the callback and the
+    // processed count are retrieved. It also ensures the write is ended only
+    // once.
+    uint64_t state = state_.load();
+    do {
+        if(!(state & Busy) || (state & Finishing)) {
+            // No write to end (should not happend)
+            return;
+        }
+    } while(!state_.compare_exchange_weak(state, state | Finishing));
+
+    stream_->service()->timer_wheel().cancel(timeout_);
+    Callback    callback = std::move(callback_);
+    std::size_t processed = processed_;
+    auto        start     = startTime_;
+    callback_ = nullptr;
+
     // from this moment, requestedSize_, processed_, src_ and callback_ are
     // devalidated and available for a new write.
+    state_.store(state & ~(Busy | TimedOut | Cancelled | Finishing));
+    RTAC_ASIO_TRACE(write_done, stream_.get(), (unsigned int)(state >> 32),
+                    processed, err.value());
+
+    // This calls the user callback in an executor loop (the user callback
+    // may ask for another write). No lock is held here, the callback may also
+    // be called inline.
+    auto handler = OperationCounters::complete(counters_, callback,
+                                               err, processed, start);
+    if(inlineCompletion_) {
+        stream_->service()->dispatch(handler, PostTag(stream_.get(), "write"));
+    }
+    else {
+        stream_->service()->post(handler, PostTag(stream_.get(), "write"));
+    }
 }
 
 /**
- * Checks if the writeId associated with the caller checks out with the current
- * one saved in the writeId_ attribute.
+ * Checks if the writeId associated with the caller is the one of the write
+ * in progress.
  *
  * This allows to potentially detect callbacks which are no longer relevant.
- * (For example a write callback might be called after a timeout alwritey
+ * (For example a write callback might be called after a timeout already
  * happened. This callback needs either to generate an error or to be ignored).
  */
 bool StreamWriter::writeid_ok(unsigned int writeId) const
 {
-    std::lock_guard<std::mutex> lock(writeMutex_);
-    return writeId == writeId_;
+    uint64_t state = state_.load();
+    return (state >> 32) == writeId && (state & Busy) && !(state & Finishing);
 }
 
+/**
+ * The pending operation on the stream is cancelled. The write ends with a
+ * timed_out error in its continuation, once the stream is done with the user
+ * buffer.
+ */
 void StreamWriter::timeout_reached(unsigned int writeId, const ErrorCode& err)
 {
-    if(!writeid_ok(writeId)) {
+    uint64_t state = state_.load();
+    do {
+        if((state >> 32) != writeId || !(state & Busy)
+        || (state & (Finishing | Cancelled))) {
+            return;
+        }
+    } while(!state_.compare_exchange_weak(state, state | TimedOut));
+    RTAC_ASIO_TRACE(write_timeout, stream_.get(), writeId);
+
+    if(pacer_ && pacer_->cancel()) {
+        // The write was waiting for the rate limit, it ends in its
+        // continuation.
         return;
     }
-    // If timeout was reached, a waiter might have been set
-    waiterNotified_ = true;
-    waiter_.notify_all();
-    this->finish_write(ErrorCode()); // error should be timeout but could not
-                                     // find how to make one.
+    if(!stream_->cancel()) {
+        // The stream cannot cancel its operations. The write is ended right
+        // away, but the stream might still read from the user buffer later.
+        this->finish_write(boost::asio::error::timed_out);
+    }
+}
+
+/**
+ * Cancels the write in progress started by this writer. It ends with
+ * operation_aborted once the stream is done with the user buffer. Returns
+ * false if there is no write to cancel.
+ */
+bool StreamWriter::cancel()
+{
+    uint64_t state = state_.load();
+    do {
+        if(!(state & Busy) || (state & (Finishing | TimedOut | Cancelled))) {
+            return false;
+        }
+    } while(!state_.compare_exchange_weak(state, state | Cancelled));
+
+    if(pacer_ && pacer_->cancel()) {
+        // The write was waiting for the rate limit.
+        return true;
+    }
+    if(!stream_->cancel()) {
+        // Same limitation as timeout_reached.
+        this->finish_write(boost::asio::error::operation_aborted);
+    }
+    return true;
+}
+
+// The write was ended by its timeout or by cancel().
+bool StreamWriter::aborted() const
+{
+    return state_.load() & (TimedOut | Cancelled);
+}
+
+StreamInterface::ErrorCode StreamWriter::abort_error() const
+{
+    if(state_.load() & TimedOut) {
+        return boost::asio::error::timed_out;
+    }
+    return boost::asio::error::operation_aborted;
+}
+
+/**
+ * An operation aborted while its timeout was not reached was cancelled for
+ * another reason (for example the timeout of a read on the same stream).
+ * It must be started again.
+ */
+bool StreamWriter::must_reissue(const ErrorCode& err) const
+{
+    return err == boost::asio::error::operation_aborted && stream_->is_open();
 }
 
 void StreamWriter::do_write_some(std::size_t count,
                                  const uint8_t* data, Callback callback)
 {
-    if(!this->dump_enabled()) {
-        stream_->async_write_some(count, data, callback);
+    if(this->dump_enabled()) {
+        callback = std::bind(&StreamWriter::dump_callback, this,
+                             callback, data, _1, _2);
+    }
+    if(pacer_) {
+        pacer_->async_write_some(count, data, callback);
     }
     else {
-        stream_->async_write_some(count, data,
-            std::bind(&StreamWriter::dump_callback, this,
-                      callback, data, _1, _2));
+        stream_->async_write_some(count, data, callback);
     }
 }
 
 bool StreamWriter::async_write_some(std::size_t count, const uint8_t* data,
                                     Callback callback, unsigned int timeoutMillis)
 {
+    if(scheduler_) {
+        return scheduler_->async_write(count, data, callback, false,
+            scheduler_->parameters().defaultPriority, timeoutMillis);
+    }
     if(!this->new_write(count, data, callback, timeoutMillis)) {
         return false;
     }
@@ -195,12 +365,28 @@ void StreamWriter::async_write_some_continue(unsigned int writeId,
         return;
     }
     processed_ = writtenCount;
-    this->finish_write(err);
+    if(writtenCount > 0) {
+        this->finish_write(err);
+    }
+    else if(this->aborted()) {
+        this->finish_write(this->abort_error());
+    }
+    else if(this->must_reissue(err)) {
+        this->do_write_some(requestedSize_, src_,
+            std::bind(&StreamWriter::async_write_some_continue, this, writeId, _1, _2));
+    }
+    else {
+        this->finish_write(err);
+    }
 }
 
 bool StreamWriter::async_write(std::size_t count, const uint8_t* data,
                                Callback callback, unsigned int timeoutMillis)
 {
+    if(scheduler_) {
+        return scheduler_->async_write(count, data, callback, true,
+            scheduler_->parameters().defaultPriority, timeoutMillis);
+    }
     if(!this->new_write(count, data, callback, timeoutMillis)) {
         return false;
     }
@@ -221,7 +407,13 @@ void StreamWriter::async_write_continue(unsigned int writeId,
     }
 
     processed_ += writtenCount;
-    if(!err && processed_ < requestedSize_) {
+    if(processed_ >= requestedSize_) {
+        this->finish_write(err);
+    }
+    else if(this->aborted()) {
+        this->finish_write(this->abort_error());
+    }
+    else if(!err || this->must_reissue(err)) {
         this->do_write_some(requestedSize_ - processed_, src_ + processed_,
             std::bind(&StreamWriter::async_write_continue, this, writeId, _1, _2));
     }
@@ -230,11 +422,30 @@ void StreamWriter::async_write_continue(unsigned int writeId,
     }
 }
 
+bool StreamWriter::async_write_priority(unsigned int priority,
+                                        std::size_t count, const uint8_t* data,
+                                        Callback callback, unsigned int timeoutMillis)
+{
+    if(scheduler_) {
+        return scheduler_->async_write(count, data, callback, true,
+                                       priority, timeoutMillis);
+    }
+    return this->async_write(count, data, callback, timeoutMillis);
+}
+
 std::size_t StreamWriter::write(std::size_t count, const uint8_t* data,
                                 unsigned int timeoutMillis)
 {
+    if(scheduler_) {
+        return this->scheduled_write(scheduler_->parameters().defaultPriority,
+                                     count, data, timeoutMillis);
+    }
     std::unique_lock<std::mutex> lock(mutex_); // will release mutex when out of scope
 
+    // reset before starting the operation, which might complete before the
+    // wait below. This also protects against spurious wakeups.
+    waiterNotified_ = false;
+    waiterSleeping_ = false;
     if(!this->async_write(count, data,
                           std::bind(&StreamWriter::write_callback, this, _1, _2),
                           timeoutMillis))
@@ -243,17 +454,76 @@ std::size_t StreamWriter::write(std::size_t count, const uint8_t* data,
         return 0;
     }
 
-    waiterNotified_ = false; // this protects against spurious wakeups.
-    waiter_.wait(lock, [&]{ return waiterNotified_; });
+    this->wait_sync(lock);
 
     return processed_;
 }
 
+std::size_t StreamWriter::write_priority(unsigned int priority,
+                                         std::size_t count, const uint8_t* data,
+                                         unsigned int timeoutMillis)
+{
+    if(scheduler_) {
+        return this->scheduled_write(priority, count, data, timeoutMillis);
+    }
+    return this->write(count, data, timeoutMillis);
+}
+
+/**
+ * Synchronous write in scheduled mode. Several threads may be waiting for
+ * their write at the same time, each one waits on its own condition.
+ */
+std::size_t StreamWriter::scheduled_write(unsigned int priority, std::size_t count,
+                                          const uint8_t* data,
+                                          unsigned int timeoutMillis)
+{
+    struct Waiter {
+        std::mutex              mutex;
+        std::condition_variable done;
+        bool                    notified = false;
+        std::size_t             count    = 0;
+    };
+    auto waiter = std::make_shared<Waiter>();
+    auto callback = [waiter](const ErrorCode&, std::size_t writtenCount) {
+        std::lock_guard<std::mutex> lock(waiter->mutex);
+        waiter->count    = writtenCount;
+        waiter->notified = true;
+        waiter->done.notify_all();
+    };
+    if(!scheduler_->async_write(count, data, callback, true, priority, timeoutMillis)) {
+        // queue full
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(waiter->mutex);
+    waiter->done.wait(lock, [&]{ return waiter->notified; });
+    return waiter->count;
+}
+
 void StreamWriter::write_callback(const ErrorCode& err, std::size_t writtenCount)
 {
     // finish write was already called through the async_write primitive
     waiterNotified_ = true;
-    waiter_.notify_all();
+    if(waiterSleeping_) {
+        // see StreamReader::read_callback
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        waiter_.notify_all();
+    }
+}
+
+void StreamWriter::wait_sync(std::unique_lock<std::mutex>& lock)
+{
+    if(spinMicros_ > 0) {
+        auto deadline = std::chrono::steady_clock::now()
+                      + std::chrono::microseconds(spinMicros_);
+        for(unsigned int i = 1; !waiterNotified_; i++) {
+            if(i % 64 == 0 && std::chrono::steady_clock::now() > deadline) {
+                break;
+            }
+            spin_pause();
+        }
+    }
+    waiterSleeping_ = true;
+    waiter_.wait(lock, [&]{ return waiterNotified_.load(); });
 }
 
 } //namespace asio
@@ -28,67 +28,406 @@
 
 #include <rtac_asio/TCPClientStream.h>
 
-#include <rtac_asio/ip_utils.h>
-
 namespace rtac { namespace asio {
 
 using namespace std::placeholders;
 
 TCPClientStream::TCPClientStream(AsyncService::Ptr service,
-                                 const std::string& remoteIP,
-                                 uint16_t remotePort) :
+                                 const std::string& remoteHost,
+                                 uint16_t remotePort,
+                                 const Parameters& params) :
     StreamInterface(service),
-    socket_(nullptr)
+    parameters_(params),
+    socket_(nullptr),
+    port_(remotePort),
+    nextCandidate_(0),
+    failedTrials_(0),
+    state_(Disconnected),
+    connectId_(0),
+    attempts_(0),
+    reconnecting_(false),
+    connectTimer_(service->service()),
+    reconnectTimer_(service->service()),
+    trialTimer_(service->service()),
+    rng_(std::random_device()()),
+    txBuffer_(service->buffer_pool().allocator<uint8_t>()),
+    txFlushing_(service->buffer_pool().allocator<uint8_t>())
 {
-    this->reset(EndPoint(make_address(remoteIP), remotePort));
+    Resolver::Address address;
+    if(parse_address(remoteHost, address)) {
+        remote_ = EndPoint(address, remotePort);
+    }
+    else {
+        host_ = remoteHost;
+    }
+    this->reset();
 }
 
 TCPClientStream::~TCPClientStream()
 {
+    // Waits for a resolve or transfer callback in progress.
+    this->invalidate_handlers();
     this->close();
 }
 
 TCPClientStream::Ptr TCPClientStream::Create(AsyncService::Ptr service,
-                                             const std::string& remoteIP,
-                                             uint16_t remotePort)
+                                             const std::string& remoteHost,
+                                             uint16_t remotePort,
+                                             const Parameters& params)
+{
+    return Ptr(new TCPClientStream(service, remoteHost, remotePort, params));
+}
+
+TCPClientStream::State TCPClientStream::state() const
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return state_;
+}
+
+void TCPClientStream::set_connect_handler(const ConnectHandler& handler)
 {
-    return Ptr(new TCPClientStream(service, remoteIP, remotePort));
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    connectHandler_ = handler;
 }
 
 void TCPClientStream::close()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    // invalidating all pending handlers
+    connectId_++;
+    reconnecting_ = false;
+    state_        = Disconnected;
+    ErrorCode ignored;
+    connectTimer_.cancel(ignored);
+    reconnectTimer_.cancel(ignored);
+    trialTimer_.cancel(ignored);
+    this->close_trials();
+    if(pendingRead_) {
+        this->service()->post(std::bind(pendingRead_->callback,
+            boost::asio::error::operation_aborted, 0),
+                              PostTag(this, "transport"));
+        pendingRead_ = nullptr;
+    }
+
     if(this->is_open()) {
         std::cout << "Closing connection" << std::endl;
         try {
             ErrorCode err;
             socket_->shutdown(boost::asio::ip::tcp::socket::shutdown_both, err);
             socket_->cancel();
-            if(err) {
+            if(err && err != boost::asio::error::not_connected) {
                 std::cerr << "Error closing socket : '" << err << "'\n";
-                return;
             }
             socket_->close();
         }
         catch(const std::exception& e) {
             std::cerr << "Error closing connection : " << e.what() << std::endl;
         }
-        socket_ = nullptr;
     }
 }
 
 void TCPClientStream::reset(const EndPoint& remote)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    host_.clear();
     remote_ = remote;
+    port_   = remote.port();
     this->reset();
 }
 
+/**
+ * Closes the current connection (if any) and starts a new connection attempt.
+ * This does not block. Data written while the connection is being
+ * established is buffered.
+ */
 void TCPClientStream::reset()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     this->close();
     this->flush();
-    
-    socket_ = std::make_unique<Socket>(this->service()->service());
-    socket_->connect(remote_);
+
+    attempts_ = 0;
+    this->start_connect();
+}
+
+void TCPClientStream::start_connect()
+{
+    // mutex_ must be held by caller
+    connectId_++;
+    reconnecting_ = false;
+    state_        = Connecting;
+
+    this->close_trials();
+    if(socket_ && socket_->is_open()) {
+        ErrorCode ignored;
+        socket_->close(ignored);
+    }
+
+    if(parameters_.connectTimeoutMillis > 0) {
+        // covers name resolution and all the connection attempts.
+        connectTimer_.expires_from_now(
+            AsyncService::Millis(parameters_.connectTimeoutMillis));
+        connectTimer_.async_wait(
+            std::bind(&TCPClientStream::connect_timeout, this, connectId_, _1));
+    }
+
+    if(host_.empty()) {
+        candidates_.assign(1, remote_);
+        nextCandidate_ = 0;
+        failedTrials_  = 0;
+        this->start_trial();
+    }
+    else {
+        // The Resolver is shared and cannot cancel a lookup. Its callback
+        // reaches the stream through the handler token.
+        auto token     = handlerToken_;
+        auto connectId = connectId_;
+        Resolver::Default()->async_resolve(this->service(), host_,
+            [this, token, connectId](const ErrorCode& err,
+                                     const Resolver::AddressList& addresses)
+            {
+                std::lock_guard<std::mutex> lock(token->mutex);
+                if(token->valid) {
+                    this->resolve_continue(connectId, err, addresses);
+                }
+            });
+    }
+}
+
+void TCPClientStream::resolve_continue(unsigned int connectId,
+                                       const ErrorCode& err,
+                                       const Resolver::AddressList& addresses)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(connectId != connectId_ || state_ != Connecting) {
+        return;
+    }
+    if(err) {
+        ErrorCode ignored;
+        connectTimer_.cancel(ignored);
+        this->connection_failed(err);
+        return;
+    }
+
+    // Interleaving address families, starting with the family of the first
+    // address returned by the resolver (RFC 8305 section 4).
+    std::vector<EndPoint> first, second;
+    for(const auto& address : addresses) {
+        if(address.is_v6() == addresses[0].is_v6())
+            first.push_back(EndPoint(address, port_));
+        else
+            second.push_back(EndPoint(address, port_));
+    }
+    candidates_.clear();
+    for(std::size_t i = 0; i < std::max(first.size(), second.size()); i++) {
+        if(i < first.size())  candidates_.push_back(first[i]);
+        if(i < second.size()) candidates_.push_back(second[i]);
+    }
+    nextCandidate_ = 0;
+    failedTrials_  = 0;
+    this->start_trial();
+}
+
+void TCPClientStream::start_trial()
+{
+    // mutex_ must be held by caller
+    if(nextCandidate_ >= candidates_.size()) {
+        return;
+    }
+    const EndPoint& remote = candidates_[nextCandidate_++];
+
+    auto socket = std::make_unique<Socket>(this->service()->service());
+    // Options are applied before connecting (socket buffer sizes are used to
+    // negotiate the TCP window scaling on connection).
+    ErrorCode err;
+    socket->open(remote.protocol(), err);
+    if(!err) {
+        parameters_.socketOptions.apply(*socket);
+    }
+    socket->async_connect(remote,
+        std::bind(&TCPClientStream::connect_continue, this,
+                  connectId_, trials_.size(), _1));
+    trials_.push_back(std::move(socket));
+
+    if(nextCandidate_ < candidates_.size()) {
+        // Next attempt is started if this one did not succeed in time.
+        trialTimer_.expires_from_now(
+            AsyncService::Millis(parameters_.attemptDelayMillis));
+        trialTimer_.async_wait(std::bind(&TCPClientStream::trial_timer_callback,
+                                         this, connectId_, _1));
+    }
+}
+
+void TCPClientStream::trial_timer_callback(unsigned int connectId, const ErrorCode& err)
+{
+    if(err) {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(connectId != connectId_ || state_ != Connecting) {
+        return;
+    }
+    this->start_trial();
+}
+
+void TCPClientStream::close_trials()
+{
+    // mutex_ must be held by caller
+    ErrorCode ignored;
+    for(auto& socket : trials_) {
+        if(socket) {
+            socket->close(ignored);
+        }
+    }
+    trials_.clear();
+}
+
+void TCPClientStream::connect_continue(unsigned int connectId,
+                                       std::size_t trialIndex,
+                                       const ErrorCode& err)
+{
+    if(err == boost::asio::error::operation_aborted) {
+        // Either closed by the user, timed out or another attempt succeeded.
+        // All cases were already handled (and this might even be destroyed).
+        return;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(connectId != connectId_ || state_ != Connecting) {
+        return;
+    }
+    ErrorCode ignored;
+
+    if(err) {
+        failedTrials_++;
+        trials_[trialIndex]->close(ignored);
+        if(nextCandidate_ < candidates_.size()) {
+            // Not waiting for the attempt delay.
+            trialTimer_.cancel(ignored);
+            this->start_trial();
+        }
+        else if(failedTrials_ >= candidates_.size()) {
+            connectTimer_.cancel(ignored);
+            this->connection_failed(err);
+        }
+        return;
+    }
+
+    connectTimer_.cancel(ignored);
+    trialTimer_.cancel(ignored);
+    socket_ = std::move(trials_[trialIndex]);
+    this->close_trials();
+    remote_ = socket_->remote_endpoint(ignored);
+
+    state_    = Connected;
+    attempts_ = 0;
+    parameters_.socketOptions.rearm(*socket_);
+    if(pendingRead_) {
+        auto read = std::move(pendingRead_);
+        socket_->async_read_some(boost::asio::buffer(read->buffer, read->bufferSize),
+            std::bind(&TCPClientStream::read_continue, this, handlerToken_, connectId_,
+                      Callback(this->record_read(read->bufferSize, read->callback)),
+                      _1, _2));
+    }
+    this->flush_tx_buffer();
+
+    if(connectHandler_) {
+        this->service()->post(std::bind(connectHandler_, ErrorCode()),
+                              PostTag(this, "connect"));
+    }
+}
+
+void TCPClientStream::connect_timeout(unsigned int connectId, const ErrorCode& err)
+{
+    if(err) {
+        // timer cancelled
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(connectId != connectId_ || state_ != Connecting) {
+        return;
+    }
+    // Invalidating the current attempts (including a pending name
+    // resolution). Closing the sockets aborts the connect operations.
+    connectId_++;
+    ErrorCode ignored;
+    trialTimer_.cancel(ignored);
+    this->close_trials();
+    this->connection_failed(boost::asio::error::timed_out);
+}
+
+void TCPClientStream::connection_failed(const ErrorCode& err)
+{
+    // mutex_ must be held by caller
+    state_ = Disconnected;
+    txFlushing_.clear(); // unknown state, cannot be resent safely
+
+    if(parameters_.autoReconnect) {
+        this->schedule_reconnect();
+    }
+    else {
+        if(pendingRead_) {
+            this->service()->post(std::bind(pendingRead_->callback, err, 0),
+                                  PostTag(this, "transport"));
+            pendingRead_ = nullptr;
+        }
+        if(txBuffer_.size() > 0) {
+            std::cerr << "rtac::asio::TCPClientStream : connection to " << remote_
+                      << " failed, dropping " << txBuffer_.size()
+                      << " buffered bytes." << std::endl;
+            txBuffer_.clear();
+        }
+    }
+
+    if(connectHandler_) {
+        this->service()->post(std::bind(connectHandler_, err),
+                              PostTag(this, "connect"));
+    }
+}
+
+void TCPClientStream::schedule_reconnect()
+{
+    // mutex_ must be held by caller
+
+    // exponential backoff with jitter
+    double delay = parameters_.reconnectMinMillis;
+    for(unsigned int i = 0; i < attempts_ && delay < parameters_.reconnectMaxMillis; i++) {
+        delay *= 2.0;
+    }
+    delay = std::min(delay, (double)parameters_.reconnectMaxMillis);
+    std::uniform_real_distribution<double> jitter(0.0, parameters_.reconnectJitter);
+    delay *= 1.0 - jitter(rng_);
+    attempts_++;
+
+    reconnecting_ = true;
+    reconnectTimer_.expires_from_now(AsyncService::Millis((long)delay));
+    reconnectTimer_.async_wait(std::bind(&TCPClientStream::reconnect_callback,
+                                         this, connectId_, _1));
+}
+
+void TCPClientStream::reconnect_callback(unsigned int connectId, const ErrorCode& err)
+{
+    if(err) {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(connectId != connectId_ || !reconnecting_) {
+        return;
+    }
+    this->start_connect();
+}
+
+void TCPClientStream::link_lost(unsigned int connectId, const ErrorCode& err)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(connectId != connectId_ || state_ != Connected) {
+        return;
+    }
+    connectId_++;
+    ErrorCode ignored;
+    socket_->close(ignored);
+    this->connection_failed(err);
 }
 
 void TCPClientStream::flush()
@@ -98,26 +437,213 @@ void TCPClientStream::flush()
 
 bool TCPClientStream::is_open() const
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     if(socket_)
         return socket_->is_open();
     return false;
 }
 
+/**
+ * Cancels the user operations. Writing the internal transmit buffer is not
+ * affected (it is resumed if interrupted by the cancellation of the socket).
+ */
+bool TCPClientStream::cancel()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(pendingRead_) {
+        this->service()->post(std::bind(pendingRead_->callback,
+            boost::asio::error::operation_aborted, 0),
+                              PostTag(this, "transport"));
+        pendingRead_ = nullptr;
+    }
+    if(state_ == Connected) {
+        ErrorCode err;
+        socket_->cancel(err);
+        return !err;
+    }
+    return true;
+}
+
+/**
+ * Bookkeeping of a completed transfer. Called with the handler token held.
+ */
+void TCPClientStream::transfer_continue(unsigned int connectId,
+                                        const ErrorCode& err)
+{
+    if(err && err != boost::asio::error::operation_aborted) {
+        this->link_lost(connectId, err);
+    }
+}
+
+void TCPClientStream::read_continue(TCPClientStream* stream,
+                                    HandlerTokenPtr token,
+                                    unsigned int connectId,
+                                    Callback callback,
+                                    const ErrorCode& err,
+                                    std::size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(token->mutex);
+        if(token->valid) {
+            auto& options = stream->parameters_.socketOptions;
+            if(!err && options.quickAck) {
+                std::lock_guard<std::recursive_mutex> streamLock(stream->mutex_);
+                if(connectId == stream->connectId_) {
+                    options.rearm(*stream->socket_);
+                }
+            }
+            stream->transfer_continue(connectId, err);
+        }
+    }
+    callback(err, count);
+}
+
+void TCPClientStream::write_continue(TCPClientStream* stream,
+                                     HandlerTokenPtr token,
+                                     unsigned int connectId,
+                                     Callback callback,
+                                     const ErrorCode& err,
+                                     std::size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(token->mutex);
+        if(token->valid) {
+            stream->transfer_continue(connectId, err);
+        }
+    }
+    callback(err, count);
+}
+
+void TCPClientStream::flush_tx_buffer()
+{
+    // mutex_ must be held by caller
+    if(state_ != Connected || txFlushing_.size() > 0 || txBuffer_.size() == 0) {
+        return;
+    }
+    std::swap(txBuffer_, txFlushing_);
+    this->write_tx_flushing();
+}
+
+void TCPClientStream::write_tx_flushing()
+{
+    // mutex_ must be held by caller
+    counters_->tx.submit(txFlushing_.size());
+    boost::asio::async_write(*socket_, boost::asio::buffer(txFlushing_),
+        std::bind(&TCPClientStream::flush_continue, this, handlerToken_, connectId_,
+                  _1, _2));
+}
+
+/**
+ * The write is resumed after a cancel() only while the stream is alive (the
+ * destructor also cancels the socket).
+ */
+void TCPClientStream::flush_continue(TCPClientStream* stream,
+                                     HandlerTokenPtr token,
+                                     unsigned int connectId,
+                                     const ErrorCode& err,
+                                     std::size_t written)
+{
+    std::lock_guard<std::mutex> tokenLock(token->mutex);
+    if(!token->valid) {
+        return;
+    }
+    stream->counters_->tx.complete(err, written);
+    if(err && err != boost::asio::error::operation_aborted) {
+        stream->link_lost(connectId, err);
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(stream->mutex_);
+    if(connectId != stream->connectId_) {
+        return;
+    }
+    if(err) {
+        // Interrupted by cancel() while the connection is still up. The
+        // remaining data still has to be sent.
+        stream->txFlushing_.erase(stream->txFlushing_.begin(),
+                                  stream->txFlushing_.begin() + written);
+        stream->write_tx_flushing();
+        return;
+    }
+    stream->txFlushing_.clear();
+    stream->flush_tx_buffer();
+}
+
 void TCPClientStream::async_read_some(std::size_t bufferSize,
                                       uint8_t* buffer,
                                       Callback callback)
 {
-    socket_->async_read_some(boost::asio::buffer(buffer, bufferSize), callback);
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(state_ == Connected) {
+        socket_->async_read_some(boost::asio::buffer(buffer, bufferSize),
+            std::bind(&TCPClientStream::read_continue, this, handlerToken_, connectId_,
+                      Callback(this->record_read(bufferSize, callback)), _1, _2));
+    }
+    else if(state_ == Connecting || reconnecting_) {
+        if(pendingRead_) {
+            this->service()->post(std::bind(callback,
+                boost::asio::error::already_started, 0),
+                                  PostTag(this, "transport"));
+            return;
+        }
+        // will be started when connection is up
+        pendingRead_ = std::unique_ptr<PendingRead>(
+            new PendingRead{bufferSize, buffer, callback});
+    }
+    else {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::not_connected, 0),
+                              PostTag(this, "transport"));
+    }
+}
+
+std::size_t TCPClientStream::try_read_some(std::size_t bufferSize,
+                                           uint8_t* buffer,
+                                           ErrorCode& err)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(state_ != Connected) {
+        // reads are deferred until the connection is up.
+        err = boost::asio::error::would_block;
+        return 0;
+    }
+    return this->native_try_read(socket_->native_handle(), true,
+                                 bufferSize, buffer, err);
 }
 
 void TCPClientStream::async_write_some(std::size_t count,
                                        const uint8_t* data,
                                        Callback callback)
 {
-    socket_->async_write_some(boost::asio::buffer(data, count), callback);
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if(state_ == Connected && txBuffer_.size() == 0 && txFlushing_.size() == 0) {
+        socket_->async_write_some(boost::asio::buffer(data, count),
+            std::bind(&TCPClientStream::write_continue, this, handlerToken_, connectId_,
+                      Callback(this->record_write(count, callback)), _1, _2));
+        return;
+    }
+    if(state_ == Disconnected && !reconnecting_) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::not_connected, 0),
+                              PostTag(this, "transport"));
+        return;
+    }
+
+    // Connection not established or buffered data still being sent.
+    // Data is appended to the transmit buffer to keep the ordering.
+    std::size_t buffered = txBuffer_.size() + txFlushing_.size();
+    if(buffered >= parameters_.writeBufferSize) {
+        this->service()->post(std::bind(callback,
+            boost::asio::error::no_buffer_space, 0),
+                              PostTag(this, "transport"));
+        return;
+    }
+    count = std::min(count, parameters_.writeBufferSize - buffered);
+    txBuffer_.insert(txBuffer_.end(), data, data + count);
+    this->service()->post(std::bind(callback, ErrorCode(), count),
+                          PostTag(this, "transport"));
+
+    this->flush_tx_buffer();
 }
 
 } //namespace asio
 } //namespace rtac
-
-
@@ -0,0 +1,268 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/TCPServer.h>
+
+#include <vector>
+
+#include <rtac_asio/ip_utils.h>
+
+namespace rtac { namespace asio {
+
+TCPServer::TCPServer(AsyncService::Ptr service,
+                     const std::string& localIP,
+                     uint16_t localPort,
+                     const Parameters& params) :
+    service_(service),
+    local_(make_address(localIP), localPort),
+    parameters_(params),
+    acceptor_(nullptr),
+    pending_(nullptr),
+    accepting_(false),
+    idleTimer_(service_->service()),
+    retryTimer_(service_->service())
+{
+    acceptor_ = std::make_unique<Acceptor>(service_->service());
+    acceptor_->open(local_.protocol());
+    acceptor_->set_option(Acceptor::reuse_address(true));
+    acceptor_->bind(local_);
+    parameters_.socketOptions.apply(*acceptor_); // buffer sizes, before listen
+    acceptor_->listen(parameters_.backlog);
+    local_ = acceptor_->local_endpoint(); // in case localPort was 0
+}
+
+TCPServer::~TCPServer()
+{
+    this->stop();
+    this->close_sessions();
+    ErrorCode err;
+    acceptor_->close(err);
+}
+
+TCPServer::Ptr TCPServer::Create(AsyncService::Ptr service,
+                                 const std::string& localIP,
+                                 uint16_t localPort,
+                                 const Parameters& params)
+{
+    return Ptr(new TCPServer(service, localIP, localPort, params));
+}
+
+TCPServer::Ptr TCPServer::Create(const std::string& localIP,
+                                 uint16_t localPort,
+                                 const Parameters& params)
+{
+    return Create(AsyncService::Create(), localIP, localPort, params);
+}
+
+void TCPServer::start(const AcceptCallback& callback)
+{
+    callback_  = callback;
+    accepting_ = true;
+    // accept operations are only handled from the service thread
+    std::weak_ptr<TCPServer> weak = this->shared_from_this();
+    service_->post([weak]() {
+        if(auto server = weak.lock()) server->do_accept();
+    }, PostTag(this, "accept"));
+    this->start_idle_timer();
+}
+
+void TCPServer::stop()
+{
+    accepting_ = false;
+    ErrorCode err;
+    acceptor_->cancel(err);
+    idleTimer_.cancel(err);
+    retryTimer_.cancel(err);
+}
+
+void TCPServer::close_sessions()
+{
+    std::vector<TCPSessionStream::Ptr> sessions;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        sessions.reserve(sessions_.size());
+        for(auto& s : sessions_) {
+            sessions.push_back(s.second.transport);
+        }
+        sessions_.clear();
+    }
+    for(auto& s : sessions) {
+        // sessions were already removed.
+        s->set_close_handler(TCPSessionStream::CloseHandler());
+        s->close();
+    }
+}
+
+std::size_t TCPServer::session_count() const
+{
+    std::lock_guard<std::mutex> lock(sessionsMutex_);
+    return sessions_.size();
+}
+
+void TCPServer::do_accept()
+{
+    if(!accepting_ || pending_) {
+        // stopped or already accepting
+        return;
+    }
+    if(this->session_count() >= parameters_.maxSessions) {
+        // Accept will resume when a session is removed.
+        return;
+    }
+    pending_ = std::make_unique<Socket>(service_->service());
+    std::weak_ptr<TCPServer> weak = this->shared_from_this();
+    acceptor_->async_accept(*pending_, [weak](const ErrorCode& err) {
+        if(auto server = weak.lock()) server->accept_continue(err);
+    });
+}
+
+void TCPServer::accept_continue(const ErrorCode& err)
+{
+    auto socket = std::move(pending_);
+    if(err == boost::asio::error::operation_aborted) {
+        return;
+    }
+    if(err == boost::asio::error::no_descriptors
+    || err == boost::system::errc::too_many_files_open_in_system)
+    {
+        // Accepting again right away would fail the same way and spin on the
+        // service thread. Waiting for sessions to close.
+        std::cerr << "rtac::asio::TCPServer : out of file descriptors, "
+                  << "retrying accept in " << parameters_.acceptRetryMillis
+                  << "ms\n";
+        std::weak_ptr<TCPServer> weak = this->shared_from_this();
+        retryTimer_.expires_from_now(AsyncService::Millis(parameters_.acceptRetryMillis));
+        retryTimer_.async_wait([weak](const ErrorCode& err) {
+            if(auto server = weak.lock()) server->retry_accept(err);
+        });
+        return;
+    }
+    if(err) {
+        std::cerr << "rtac::asio::TCPServer : error on accept : '"
+                  << err << "'\n";
+        this->do_accept();
+        return;
+    }
+
+    parameters_.socketOptions.apply(*socket);
+    // The session may outlive the server if the user keeps its Stream.
+    std::weak_ptr<TCPServer> weak = this->shared_from_this();
+    auto transport = TCPSessionStream::Create(service_, std::move(socket),
+        [weak](TCPSessionStream* session) {
+            if(auto server = weak.lock()) server->session_closed(session);
+        },
+        parameters_.socketOptions);
+    auto stream = Stream::Create(transport);
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        sessions_[transport.get()] = Session{transport, stream};
+    }
+    if(callback_) {
+        callback_(stream);
+    }
+
+    this->do_accept();
+}
+
+void TCPServer::retry_accept(const ErrorCode& err)
+{
+    if(err) {
+        return;
+    }
+    this->do_accept();
+}
+
+void TCPServer::session_closed(TCPSessionStream* session)
+{
+    // The session might be calling this from one of its own methods.
+    // Releasing it is deferred to avoid deleting it while in use.
+    std::weak_ptr<TCPServer> weak = this->shared_from_this();
+    service_->post([weak, session]() {
+        if(auto server = weak.lock()) server->remove_session(session);
+    }, PostTag(this, "session closed"));
+}
+
+void TCPServer::remove_session(const TCPSessionStream* session)
+{
+    Session removed;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        auto it = sessions_.find(session);
+        if(it == sessions_.end()) {
+            return;
+        }
+        removed = std::move(it->second);
+        sessions_.erase(it);
+    }
+    // removed is released here, outside of the lock.
+    this->do_accept();
+}
+
+void TCPServer::start_idle_timer()
+{
+    if(parameters_.idleTimeoutMillis == 0) {
+        return;
+    }
+    // The idle timeout is checked for all sessions at once. A session is
+    // closed between idleTimeoutMillis and 1.25*idleTimeoutMillis after its
+    // last transfer.
+    unsigned int period = std::max(parameters_.idleTimeoutMillis / 4, 1u);
+    idleTimer_.expires_from_now(AsyncService::Millis(period));
+    std::weak_ptr<TCPServer> weak = this->shared_from_this();
+    idleTimer_.async_wait([weak](const ErrorCode& err) {
+        if(auto server = weak.lock()) server->idle_timer_callback(err);
+    });
+}
+
+void TCPServer::idle_timer_callback(const ErrorCode& err)
+{
+    if(err || !accepting_) {
+        return;
+    }
+
+    auto deadline = TCPSessionStream::Clock::now()
+                  - std::chrono::milliseconds(parameters_.idleTimeoutMillis);
+    std::vector<TCPSessionStream::Ptr> idle;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        for(auto& s : sessions_) {
+            if(s.second.transport->last_activity() < deadline) {
+                idle.push_back(s.second.transport);
+            }
+        }
+    }
+    for(auto& s : idle) {
+        // this will trigger the removal of the session through session_closed.
+        s->close();
+    }
+
+    this->start_idle_timer();
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,243 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/TCPSessionStream.h>
+#include <rtac_asio/UringQueue.h>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+TCPSessionStream::TCPSessionStream(AsyncService::Ptr service,
+                                   std::unique_ptr<Socket> socket,
+                                   const CloseHandler& closeHandler,
+                                   const TCPSocketOptions& options) :
+    StreamInterface(service),
+    socket_(std::move(socket)),
+    closeHandler_(closeHandler),
+    options_(options)
+{
+    ErrorCode err;
+    remote_ = socket_->remote_endpoint(err);
+    this->touch();
+    if(auto uring = this->service()->uring()) {
+        uring->register_file(socket_->native_handle());
+    }
+}
+
+TCPSessionStream::~TCPSessionStream()
+{
+    this->invalidate_handlers();
+    closeHandler_ = CloseHandler();
+    this->close();
+}
+
+TCPSessionStream::Ptr TCPSessionStream::Create(AsyncService::Ptr service,
+                                               std::unique_ptr<Socket> socket,
+                                               const CloseHandler& closeHandler,
+                                               const TCPSocketOptions& options)
+{
+    return Ptr(new TCPSessionStream(service, std::move(socket),
+                                    closeHandler, options));
+}
+
+void TCPSessionStream::touch()
+{
+    lastActivity_ = Clock::now().time_since_epoch().count();
+}
+
+TCPSessionStream::Clock::time_point TCPSessionStream::last_activity() const
+{
+    return Clock::time_point(Clock::duration(lastActivity_.load()));
+}
+
+void TCPSessionStream::close()
+{
+    if(!this->is_open()) {
+        return;
+    }
+
+    if(auto uring = this->service()->uring()) {
+        uring->cancel(socket_->native_handle());
+        uring->unregister_file(socket_->native_handle());
+    }
+    ErrorCode err;
+    socket_->shutdown(Socket::shutdown_both, err);
+    socket_->cancel(err);
+    socket_->close(err);
+    if(err) {
+        std::cerr << "Error closing session with " << remote_
+                  << " : '" << err << "'\n";
+    }
+
+    if(closeHandler_) {
+        // The handler is called last because the owner of this session
+        // might release it from there.
+        auto handler = closeHandler_;
+        closeHandler_ = CloseHandler();
+        handler(this);
+    }
+}
+
+/**
+ * An accepted session cannot be reconnected from the server side. Resetting
+ * it closes the connection.
+ */
+void TCPSessionStream::reset()
+{
+    this->close();
+}
+
+void TCPSessionStream::flush()
+{
+    // for compatibility with StreamInterface
+}
+
+int TCPSessionStream::native_fd() const
+{
+    if(!this->is_open()) {
+        return -1;
+    }
+    return socket_->native_handle();
+}
+
+bool TCPSessionStream::is_open() const
+{
+    return socket_->is_open();
+}
+
+bool TCPSessionStream::cancel()
+{
+    if(!this->is_open()) {
+        return false;
+    }
+    if(auto uring = this->service()->uring()) {
+        uring->cancel(socket_->native_handle());
+    }
+    ErrorCode err;
+    socket_->cancel(err);
+    return !err;
+}
+
+/**
+ * Bookkeeping of a completed transfer. Called with the handler token held.
+ */
+void TCPSessionStream::transfer_continue(const ErrorCode& err, std::size_t count)
+{
+    if(count > 0) {
+        this->touch();
+    }
+    if(err && err != boost::asio::error::operation_aborted) {
+        // remote closed the connection or connection lost. There is nothing
+        // to recover on the server side.
+        this->close();
+    }
+}
+
+void TCPSessionStream::read_continue(TCPSessionStream* stream,
+                                     HandlerTokenPtr token,
+                                     Callback callback,
+                                     const ErrorCode& err,
+                                     std::size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(token->mutex);
+        if(token->valid) {
+            if(!err) {
+                stream->options_.rearm(*stream->socket_);
+            }
+            stream->transfer_continue(err, count);
+        }
+    }
+    callback(err, count);
+}
+
+void TCPSessionStream::write_continue(TCPSessionStream* stream,
+                                      HandlerTokenPtr token,
+                                      Callback callback,
+                                      const ErrorCode& err,
+                                      std::size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(token->mutex);
+        if(token->valid) {
+            stream->transfer_continue(err, count);
+        }
+    }
+    callback(err, count);
+}
+
+void TCPSessionStream::async_read_some(std::size_t bufferSize,
+                                       uint8_t* buffer,
+                                       Callback callback)
+{
+    auto handler = std::bind(&TCPSessionStream::read_continue, this, handlerToken_,
+                             Callback(this->record_read(bufferSize, callback)), _1, _2);
+    if(auto uring = this->service()->uring()) {
+        uring->async_read_some(socket_->native_handle(), buffer, bufferSize, handler);
+        return;
+    }
+    socket_->async_read_some(boost::asio::buffer(buffer, bufferSize), handler);
+}
+
+std::size_t TCPSessionStream::try_read_some(std::size_t bufferSize,
+                                            uint8_t* buffer,
+                                            ErrorCode& err)
+{
+    if(!this->is_open()) {
+        err = boost::asio::error::bad_descriptor;
+        return 0;
+    }
+    std::size_t count = this->native_try_read(socket_->native_handle(), true,
+                                              bufferSize, buffer, err);
+    if(count > 0) {
+        // same bookkeeping as read_continue (idle timeout, TCP_QUICKACK).
+        options_.rearm(*socket_);
+        this->touch();
+    }
+    else if(err && err != boost::asio::error::would_block) {
+        this->close();
+    }
+    return count;
+}
+
+void TCPSessionStream::async_write_some(std::size_t count,
+                                        const uint8_t* data,
+                                        Callback callback)
+{
+    auto handler = std::bind(&TCPSessionStream::write_continue, this, handlerToken_,
+                             Callback(this->record_write(count, callback)), _1, _2);
+    if(auto uring = this->service()->uring()) {
+        uring->async_write_some(socket_->native_handle(), data, count, handler);
+        return;
+    }
+    socket_->async_write_some(boost::asio::buffer(data, count), handler);
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,195 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/TCPSocketOptions.h>
+
+#include <iostream>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace rtac { namespace asio {
+
+namespace {
+
+TCPSocketOptions::ErrorCode set_int_option(TCPSocketOptions::Socket& socket,
+                                           int level, int name, int value,
+                                           const char* optionName)
+{
+    if(::setsockopt(socket.native_handle(), level, name, &value, sizeof(value)) == 0) {
+        return TCPSocketOptions::ErrorCode();
+    }
+    TCPSocketOptions::ErrorCode err(errno, boost::asio::error::get_system_category());
+    std::cerr << "rtac::asio : could not set " << optionName
+              << " : '" << err.message() << "'" << std::endl;
+    return err;
+}
+
+template <class SocketT>
+TCPSocketOptions::ErrorCode set_buffer_sizes(SocketT& socket,
+                                             int receiveBufferSize,
+                                             int sendBufferSize)
+{
+    TCPSocketOptions::ErrorCode res, err;
+    if(receiveBufferSize > 0) {
+        socket.set_option(boost::asio::socket_base::receive_buffer_size(receiveBufferSize), err);
+        if(err) {
+            std::cerr << "rtac::asio : could not set SO_RCVBUF : '"
+                      << err.message() << "'" << std::endl;
+            res = err;
+        }
+    }
+    if(sendBufferSize > 0) {
+        socket.set_option(boost::asio::socket_base::send_buffer_size(sendBufferSize), err);
+        if(err) {
+            std::cerr << "rtac::asio : could not set SO_SNDBUF : '"
+                      << err.message() << "'" << std::endl;
+            res = err;
+        }
+    }
+    return res;
+}
+
+#if !defined(TCP_QUICKACK) || !defined(TCP_KEEPIDLE) || !defined(TCP_KEEPINTVL) \
+ || !defined(TCP_KEEPCNT)  || !defined(TCP_USER_TIMEOUT) || !defined(SO_BUSY_POLL)
+void unsupported(const char* optionName)
+{
+    std::cerr << "rtac::asio : " << optionName
+              << " is not supported on this platform." << std::endl;
+}
+#endif
+
+} //namespace
+
+/**
+ * Applies the options to an open socket. Options failing to be applied are
+ * reported on std::cerr but do not prevent the others to be applied. The
+ * last error (if any) is returned.
+ *
+ * Socket buffer sizes must be set before connecting for the TCP window
+ * scaling to take them into account.
+ */
+TCPSocketOptions::ErrorCode TCPSocketOptions::apply(Socket& socket) const
+{
+    ErrorCode res, err;
+
+    if(noDelay) {
+        socket.set_option(boost::asio::ip::tcp::no_delay(true), err);
+        if(err) {
+            std::cerr << "rtac::asio : could not set TCP_NODELAY : '"
+                      << err.message() << "'" << std::endl;
+            res = err;
+        }
+    }
+    if(quickAck) {
+        #ifdef TCP_QUICKACK
+        if(auto e = set_int_option(socket, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK")) res = e;
+        #else
+        unsupported("TCP_QUICKACK");
+        #endif
+    }
+    if(keepAlive) {
+        socket.set_option(Socket::keep_alive(true), err);
+        if(err) {
+            std::cerr << "rtac::asio : could not set SO_KEEPALIVE : '"
+                      << err.message() << "'" << std::endl;
+            res = err;
+        }
+        #if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+        if(keepAliveIdle > 0) {
+            if(auto e = set_int_option(socket, IPPROTO_TCP, TCP_KEEPIDLE,
+                                       keepAliveIdle, "TCP_KEEPIDLE")) res = e;
+        }
+        if(keepAliveInterval > 0) {
+            if(auto e = set_int_option(socket, IPPROTO_TCP, TCP_KEEPINTVL,
+                                       keepAliveInterval, "TCP_KEEPINTVL")) res = e;
+        }
+        if(keepAliveCount > 0) {
+            if(auto e = set_int_option(socket, IPPROTO_TCP, TCP_KEEPCNT,
+                                       keepAliveCount, "TCP_KEEPCNT")) res = e;
+        }
+        #else
+        if(keepAliveIdle > 0 || keepAliveInterval > 0 || keepAliveCount > 0) {
+            unsupported("TCP_KEEPIDLE/TCP_KEEPINTVL/TCP_KEEPCNT");
+        }
+        #endif
+    }
+    if(auto e = set_buffer_sizes(socket, receiveBufferSize, sendBufferSize)) res = e;
+    if(userTimeoutMillis > 0) {
+        #ifdef TCP_USER_TIMEOUT
+        if(auto e = set_int_option(socket, IPPROTO_TCP, TCP_USER_TIMEOUT,
+                                   userTimeoutMillis, "TCP_USER_TIMEOUT")) res = e;
+        #else
+        unsupported("TCP_USER_TIMEOUT");
+        #endif
+    }
+    if(busyPollMicros > 0) {
+        #ifdef SO_BUSY_POLL
+        // Increasing SO_BUSY_POLL above net.core.busy_read requires CAP_NET_ADMIN.
+        if(auto e = set_int_option(socket, SOL_SOCKET, SO_BUSY_POLL,
+                                   busyPollMicros, "SO_BUSY_POLL")) res = e;
+        #else
+        unsupported("SO_BUSY_POLL");
+        #endif
+    }
+
+    return res;
+}
+
+/**
+ * Applies the options inherited by accepted sockets to a listening socket.
+ * This must be called before Acceptor::listen : the window scale is
+ * negotiated during the handshake, before the accepted socket exists, and is
+ * derived from the buffer sizes of the listening socket.
+ *
+ * Only SO_RCVBUF and SO_SNDBUF are applied here. The other options are
+ * applied on each accepted socket with apply(Socket&).
+ */
+TCPSocketOptions::ErrorCode TCPSocketOptions::apply(Acceptor& acceptor) const
+{
+    return set_buffer_sizes(acceptor, receiveBufferSize, sendBufferSize);
+}
+
+/**
+ * Re-applies the options which are not permanent (TCP_QUICKACK). This is
+ * called after each completed read.
+ */
+void TCPSocketOptions::rearm(Socket& socket) const
+{
+    #ifdef TCP_QUICKACK
+    if(quickAck) {
+        int value = 1;
+        ::setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_QUICKACK,
+                     &value, sizeof(value));
+    }
+    #endif
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,359 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/TimerWheel.h>
+
+#include <algorithm>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+TimerWheel::TimerWheel(boost::asio::io_service& service) :
+    timer_(service),
+    origin_(Clock::now()),
+    currentTick_(0),
+    scheduledTick_(0),
+    scheduled_(false),
+    freeList_(Nil),
+    count_(0)
+{
+    for(auto& level : levels_) {
+        level.heads.fill(Nil);
+        level.occupied.fill(0);
+    }
+}
+
+TimerWheel::~TimerWheel()
+{
+    ErrorCode err;
+    timer_.cancel(err);
+}
+
+uint64_t TimerWheel::tick_at(const Clock::time_point& t) const
+{
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        t - origin_).count();
+    if(micros <= 0) {
+        return 0;
+    }
+    // rounded up : a timeout never expires early.
+    return (micros + 999) / 1000;
+}
+
+uint32_t TimerWheel::allocate()
+{
+    uint32_t index;
+    if(freeList_ != Nil) {
+        index     = freeList_;
+        freeList_ = entries_[index].next;
+    }
+    else {
+        index = entries_.size();
+        entries_.push_back(Entry());
+        entries_[index].generation = 0;
+    }
+    if(++entries_[index].generation == 0) {
+        entries_[index].generation = 1; // 0 is reserved for invalid handles
+    }
+    return index;
+}
+
+void TimerWheel::release(uint32_t index)
+{
+    auto& entry = entries_[index];
+    entry.handler = nullptr;
+    entry.generation++; // invalidates handles on this entry
+    entry.next = freeList_;
+    freeList_  = index;
+}
+
+void TimerWheel::link(uint32_t index)
+{
+    auto& entry = entries_[index];
+    if(entry.expiry < currentTick_) {
+        entry.expiry = currentTick_;
+    }
+    uint64_t delta = entry.expiry - currentTick_;
+    unsigned int level = 0;
+    while(level < Levels - 1 && delta >= (1ull << (SlotBits*(level + 1)))) {
+        level++;
+    }
+    if(delta >= (1ull << (SlotBits*Levels))) {
+        // about 50 days. Clamped to the range of the wheel.
+        entry.expiry = currentTick_ + (1ull << (SlotBits*Levels)) - 1;
+    }
+    unsigned int slot = (entry.expiry >> (SlotBits*level)) & SlotMask;
+
+    auto& l = levels_[level];
+    entry.level = level;
+    entry.slot  = slot;
+    entry.prev  = Nil;
+    entry.next  = l.heads[slot];
+    if(entry.next != Nil) {
+        entries_[entry.next].prev = index;
+    }
+    l.heads[slot] = index;
+    l.occupied[slot / 64] |= (1ull << (slot % 64));
+}
+
+void TimerWheel::unlink(uint32_t index)
+{
+    auto& entry = entries_[index];
+    auto& l     = levels_[entry.level];
+    if(entry.prev != Nil) {
+        entries_[entry.prev].next = entry.next;
+    }
+    else {
+        l.heads[entry.slot] = entry.next;
+    }
+    if(entry.next != Nil) {
+        entries_[entry.next].prev = entry.prev;
+    }
+    if(l.heads[entry.slot] == Nil) {
+        l.occupied[entry.slot / 64] &= ~(1ull << (entry.slot % 64));
+    }
+}
+
+void TimerWheel::cascade(unsigned int level, unsigned int slot)
+{
+    auto& l = levels_[level];
+    uint32_t index = l.heads[slot];
+    l.heads[slot] = Nil;
+    l.occupied[slot / 64] &= ~(1ull << (slot % 64));
+    while(index != Nil) {
+        uint32_t next = entries_[index].next;
+        this->link(index); // goes to a lower level
+        index = next;
+    }
+}
+
+void TimerWheel::expire_slot(unsigned int slot, std::vector<Handler>& expired)
+{
+    auto& l = levels_[0];
+    uint32_t index = l.heads[slot];
+    l.heads[slot] = Nil;
+    l.occupied[slot / 64] &= ~(1ull << (slot % 64));
+    while(index != Nil) {
+        uint32_t next = entries_[index].next;
+        expired.push_back(std::move(entries_[index].handler));
+        this->release(index);
+        count_--;
+        index = next;
+    }
+}
+
+/**
+ * Finds the first occupied slot of the first level for ticks in [from, to].
+ * from and to must be in the same turn of the first level.
+ */
+bool TimerWheel::next_level0_tick(uint64_t from, uint64_t to, uint64_t& tick) const
+{
+    const auto& occupied = levels_[0].occupied;
+    unsigned int first = from & SlotMask;
+    unsigned int last  = to   & SlotMask;
+    for(unsigned int w = first / 64; w <= last / 64; w++) {
+        uint64_t word = occupied[w];
+        if(w == first / 64) word &= ~0ull << (first % 64);
+        if(w == last  / 64 && last % 64 != 63) word &= (1ull << (last % 64 + 1)) - 1;
+        if(word) {
+            tick = (from & ~(uint64_t)SlotMask) + 64*w + __builtin_ctzll(word);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Sets the kernel timer on the next tick which has something to do (either
+ * expiring entries or cascading a higher level). Must be called with mutex_
+ * locked.
+ */
+void TimerWheel::schedule()
+{
+    if(count_ == 0) {
+        // Nothing to wait for. The pending wait (if any) is left to expire,
+        // it will find nothing to do.
+        return;
+    }
+
+    uint64_t target;
+    if((currentTick_ & SlotMask) == 0) {
+        target = currentTick_; // cascading is needed
+    }
+    else {
+        uint64_t boundary = (currentTick_ | SlotMask) + 1;
+        if(!this->next_level0_tick(currentTick_, boundary - 1, target)) {
+            target = boundary;
+        }
+    }
+
+    if(scheduled_ && target == scheduledTick_) {
+        return;
+    }
+    scheduled_     = true;
+    scheduledTick_ = target;
+    // expires_at cancels the previous wait.
+    timer_.expires_at(origin_ + std::chrono::milliseconds(target));
+    timer_.async_wait(std::bind(&TimerWheel::timer_callback, this, _1));
+}
+
+void TimerWheel::timer_callback(const ErrorCode& err)
+{
+    if(err == boost::asio::error::operation_aborted) {
+        return;
+    }
+
+    std::vector<Handler> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        scheduled_ = false;
+
+        uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            Clock::now() - origin_).count();
+        while(currentTick_ <= now && count_ > 0) {
+            unsigned int index = currentTick_ & SlotMask;
+            if(index != 0) {
+                // skipping empty slots up to the next cascade.
+                uint64_t last = std::min(now, (currentTick_ | SlotMask));
+                uint64_t next;
+                if(!this->next_level0_tick(currentTick_, last, next)) {
+                    currentTick_ = last + 1;
+                    continue;
+                }
+                currentTick_ = next;
+                index = currentTick_ & SlotMask;
+            }
+            else {
+                for(unsigned int level = 1; level < Levels; level++) {
+                    unsigned int slot = (currentTick_ >> (SlotBits*level)) & SlotMask;
+                    this->cascade(level, slot);
+                    if(slot != 0) {
+                        break;
+                    }
+                }
+            }
+            this->expire_slot(index, expired);
+            currentTick_++;
+        }
+        if(count_ == 0 && currentTick_ <= now) {
+            // wheel is empty, it can be moved forward at no cost.
+            currentTick_ = now + 1;
+        }
+        this->schedule();
+    }
+
+    // called without the lock held, handlers may arm new timeouts.
+    for(auto& handler : expired) {
+        if(handler) {
+            handler();
+        }
+    }
+}
+
+TimerWheel::Handle TimerWheel::arm(unsigned int delayMillis, const Handler& handler)
+{
+    auto now = Clock::now();
+    uint64_t expiry = this->tick_at(now + std::chrono::milliseconds(delayMillis));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(count_ == 0) {
+        // The wheel may have been left behind while empty. Moving it forward
+        // keeps the skipping in timer_callback short.
+        uint64_t nowTick = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - origin_).count();
+        currentTick_ = std::max(currentTick_, nowTick);
+    }
+
+    uint32_t index = this->allocate();
+    entries_[index].expiry  = expiry;
+    entries_[index].handler = handler;
+    this->link(index);
+    count_++;
+
+    if(!scheduled_ || entries_[index].expiry < scheduledTick_) {
+        this->schedule();
+    }
+
+    Handle handle;
+    handle.index      = index;
+    handle.generation = entries_[index].generation;
+    return handle;
+}
+
+bool TimerWheel::cancel(Handle& handle)
+{
+    if(!handle.is_valid()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool cancelled = false;
+    if(handle.index < entries_.size()
+       && entries_[handle.index].generation == handle.generation)
+    {
+        this->unlink(handle.index);
+        this->release(handle.index);
+        count_--;
+        cancelled = true;
+    }
+    // The kernel timer is not updated. If it was waiting for this entry it
+    // will wake up for nothing, which is cheaper than re-arming it on each
+    // cancel.
+    handle = Handle();
+    return cancelled;
+}
+
+void TimerWheel::cancel_all()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto& level : levels_) {
+        for(auto& head : level.heads) {
+            uint32_t index = head;
+            while(index != Nil) {
+                uint32_t next = entries_[index].next;
+                this->release(index);
+                index = next;
+            }
+            head = Nil;
+        }
+        level.occupied.fill(0);
+    }
+    count_     = 0;
+    scheduled_ = false;
+    ErrorCode err;
+    timer_.cancel(err);
+}
+
+std::size_t TimerWheel::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+} //namespace asio
+} //namespace rtac
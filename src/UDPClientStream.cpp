@@ -40,7 +40,7 @@ UDPClientStream::UDPClientStream(AsyncService::Ptr service,
                                  std::size_t bufferSize) :
     StreamInterface(service),
     socket_(nullptr),
-    buffer_(bufferSize),
+    buffer_(bufferSize, 0, service->buffer_pool().allocator<uint8_t>()),
     bufferBegin_(buffer_.begin()),
     bufferEnd_(buffer_.begin())
 {
@@ -49,6 +49,7 @@ UDPClientStream::UDPClientStream(AsyncService::Ptr service,
 
 UDPClientStream::~UDPClientStream()
 {
+    this->invalidate_handlers();
     this->close();
 }
 
@@ -109,52 +110,94 @@ bool UDPClientStream::is_open() const
     return false;
 }
 
+bool UDPClientStream::cancel()
+{
+    if(!this->is_open()) {
+        return false;
+    }
+    ErrorCode err;
+    socket_->cancel(err);
+    return !err;
+}
+
+/**
+ * Copies the data of the internal buffer to buffer.
+ */
+std::size_t UDPClientStream::read_buffered(std::size_t bufferSize, uint8_t* buffer)
+{
+    auto buffered = this->available();
+    if(bufferSize >= buffered) {
+        std::memcpy(buffer, &(*bufferBegin_), buffered);
+        bufferBegin_ = buffer_.begin();
+        bufferEnd_   = buffer_.begin();
+        return buffered;
+    }
+    std::memcpy(buffer, &(*bufferBegin_), bufferSize);
+    bufferBegin_ += bufferSize;
+    return bufferSize;
+}
+
 void UDPClientStream::async_read_some(std::size_t bufferSize,
                                       uint8_t* buffer,
                                       Callback callback)
 {
-    auto buffered = this->available();
-    if(buffered > 0) {
-        if(bufferSize >= buffered) {
-            std::memcpy(buffer, &(*bufferBegin_), buffered);
-            bufferBegin_ = buffer_.begin();
-            bufferEnd_   = buffer_.begin();
-            callback(ErrorCode(), buffered);
-        }
-        else {
-            std::memcpy(buffer, &(*bufferBegin_), bufferSize);
-            bufferBegin_ += bufferSize;
-            callback(ErrorCode(), bufferSize);
-        }
+    if(this->available() > 0) {
+        callback(ErrorCode(), this->read_buffered(bufferSize, buffer));
+    }
+    else if(bufferSize >= buffer_.size()) {
+        // Any datagram fitting in the internal buffer fits in the user
+        // buffer. It is received there directly, without a copy.
+        socket_->async_receive(boost::asio::buffer(buffer, bufferSize),
+            this->record_read(bufferSize, callback));
     }
     else {
         // called only when buffer empty
+        counters_->rx.submit(buffer_.size());
         socket_->async_receive(boost::asio::buffer(buffer_.data(), buffer_.size()),
-            std::bind(&UDPClientStream::receive_continue, this,
+            std::bind(&UDPClientStream::receive_continue, this, handlerToken_,
                 bufferSize, buffer, callback, _1, _2));
     }
 }
 
-void UDPClientStream::receive_continue(std::size_t bufferSize,
+void UDPClientStream::receive_continue(UDPClientStream* stream,
+                                       HandlerTokenPtr token,
+                                       std::size_t bufferSize,
                                        uint8_t* buffer,
                                        Callback callback,
                                        const ErrorCode& err,
                                        std::size_t received)
 {
-    this->bufferEnd_ += received;
-    if(err) {
-        callback(err, 0);
-    }
-    else {
-        this->async_read_some(bufferSize, buffer, callback);
+    ErrorCode   res   = err;
+    std::size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(token->mutex);
+        if(token->valid) {
+            stream->counters_->rx.complete(err, received);
+            stream->bufferEnd_ += received;
+            if(!err && stream->available() == 0) {
+                // empty datagram, nothing is buffered so this does not
+                // complete here.
+                stream->async_read_some(bufferSize, buffer, callback);
+                return;
+            }
+            if(!res) {
+                count = stream->read_buffered(bufferSize, buffer);
+            }
+        }
+        else {
+            // the datagram was received in the buffer of a destroyed stream.
+            res = boost::asio::error::operation_aborted;
+        }
     }
+    callback(res, count);
 }
 
 void UDPClientStream::async_write_some(std::size_t count,
                                        const uint8_t* data,
                                        Callback callback)
 {
-    socket_->async_send(boost::asio::buffer(data, count), callback);
+    socket_->async_send(boost::asio::buffer(data, count),
+        this->record_write(count, callback));
 }
 
 } //namespace asio
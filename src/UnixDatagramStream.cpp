@@ -0,0 +1,255 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/UnixDatagramStream.h>
+
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+UnixDatagramStream::UnixDatagramStream(AsyncService::Ptr service,
+                                       const std::string& path,
+                                       Mode mode,
+                                       std::size_t bufferSize) :
+    StreamInterface(service),
+    socket_(nullptr),
+    path_(path),
+    mode_(mode),
+    buffer_(bufferSize, 0, service->buffer_pool().allocator<uint8_t>()),
+    bufferBegin_(buffer_.begin()),
+    bufferEnd_(buffer_.begin())
+{
+    this->reset();
+}
+
+UnixDatagramStream::~UnixDatagramStream()
+{
+    this->invalidate_handlers();
+    this->close();
+}
+
+UnixDatagramStream::Ptr UnixDatagramStream::Create(AsyncService::Ptr service,
+                                                   const std::string& path,
+                                                   Mode mode,
+                                                   std::size_t bufferSize)
+{
+    return Ptr(new UnixDatagramStream(service, path, mode, bufferSize));
+}
+
+void UnixDatagramStream::close()
+{
+    if(this->is_open()) {
+        ErrorCode err;
+        socket_->shutdown(Socket::shutdown_both, err);
+        socket_->cancel(err);
+        socket_->close(err);
+        if(err) {
+            std::cerr << "Error closing socket : '" << err << "'\n";
+        }
+    }
+}
+
+/**
+ * The socket is created by hand because boost::asio does not provide a
+ * SOCK_SEQPACKET local protocol. It is then given to a generic datagram
+ * socket.
+ */
+void UnixDatagramStream::reset()
+{
+    this->close();
+    this->flush();
+
+    sockaddr_un remote;
+    if(path_.size() >= sizeof(remote.sun_path)) {
+        throw std::runtime_error("rtac::asio::UnixDatagramStream : path too long : " + path_);
+    }
+    std::memset(&remote, 0, sizeof(remote));
+    remote.sun_family = AF_UNIX;
+    std::memcpy(remote.sun_path, path_.c_str(), path_.size());
+
+    int type = SOCK_SEQPACKET;
+    if(mode_ == Datagram) {
+        type = SOCK_DGRAM;
+    }
+    int fd = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        throw boost::system::system_error(ErrorCode(errno,
+            boost::asio::error::get_system_category()), "socket");
+    }
+    if(mode_ == Datagram) {
+        // autobind : the kernel chooses an unique abstract address.
+        sa_family_t family = AF_UNIX;
+        if(::bind(fd, (const sockaddr*)&family, sizeof(family)) != 0) {
+            ErrorCode err(errno, boost::asio::error::get_system_category());
+            ::close(fd);
+            throw boost::system::system_error(err, "bind");
+        }
+    }
+    if(::connect(fd, (const sockaddr*)&remote, sizeof(remote)) != 0) {
+        ErrorCode err(errno, boost::asio::error::get_system_category());
+        ::close(fd);
+        throw boost::system::system_error(err, "connect to " + path_);
+    }
+
+    socket_ = std::make_unique<Socket>(this->service()->service());
+    socket_->assign(boost::asio::generic::datagram_protocol(AF_UNIX, 0), fd);
+}
+
+void UnixDatagramStream::flush()
+{
+    bufferBegin_ = buffer_.begin();
+    bufferEnd_   = buffer_.begin();
+}
+
+bool UnixDatagramStream::is_open() const
+{
+    if(socket_)
+        return socket_->is_open();
+    return false;
+}
+
+bool UnixDatagramStream::cancel()
+{
+    if(!this->is_open()) {
+        return false;
+    }
+    ErrorCode err;
+    socket_->cancel(err);
+    return !err;
+}
+
+/**
+ * Copies the data of the internal buffer to buffer.
+ */
+std::size_t UnixDatagramStream::read_buffered(std::size_t bufferSize, uint8_t* buffer)
+{
+    auto buffered = this->available();
+    if(bufferSize >= buffered) {
+        std::memcpy(buffer, &(*bufferBegin_), buffered);
+        bufferBegin_ = buffer_.begin();
+        bufferEnd_   = buffer_.begin();
+        return buffered;
+    }
+    std::memcpy(buffer, &(*bufferBegin_), bufferSize);
+    bufferBegin_ += bufferSize;
+    return bufferSize;
+}
+
+void UnixDatagramStream::async_read_some(std::size_t bufferSize,
+                                         uint8_t* buffer,
+                                         Callback callback)
+{
+    if(this->available() > 0) {
+        callback(ErrorCode(), this->read_buffered(bufferSize, buffer));
+    }
+    else if(bufferSize >= buffer_.size()) {
+        // Any datagram fitting in the internal buffer fits in the user
+        // buffer. It is received there directly, without a copy.
+        socket_->async_receive(boost::asio::buffer(buffer, bufferSize),
+            std::bind(&UnixDatagramStream::receive_direct_continue, mode_,
+                Callback(this->record_read(bufferSize, callback)), _1, _2));
+    }
+    else {
+        // called only when buffer empty
+        counters_->rx.submit(buffer_.size());
+        socket_->async_receive(boost::asio::buffer(buffer_.data(), buffer_.size()),
+            std::bind(&UnixDatagramStream::receive_continue, this, handlerToken_,
+                bufferSize, buffer, callback, _1, _2));
+    }
+}
+
+void UnixDatagramStream::receive_continue(UnixDatagramStream* stream,
+                                          HandlerTokenPtr token,
+                                          std::size_t bufferSize,
+                                          uint8_t* buffer,
+                                          Callback callback,
+                                          const ErrorCode& err,
+                                          std::size_t received)
+{
+    ErrorCode   res   = err;
+    std::size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(token->mutex);
+        if(token->valid) {
+            stream->counters_->rx.complete(err, received);
+            stream->bufferEnd_ += received;
+            if(!err && received == 0 && stream->mode_ == SeqPacket) {
+                // zero length read on a SOCK_SEQPACKET socket means end of
+                // connection
+                res = boost::asio::error::eof;
+            }
+            else if(!err && stream->available() == 0) {
+                // empty datagram, nothing is buffered so this does not
+                // complete here.
+                stream->async_read_some(bufferSize, buffer, callback);
+                return;
+            }
+            if(!res) {
+                count = stream->read_buffered(bufferSize, buffer);
+            }
+        }
+        else {
+            // the datagram was received in the buffer of a destroyed stream.
+            res = boost::asio::error::operation_aborted;
+        }
+    }
+    callback(res, count);
+}
+
+/**
+ * Does not use the stream, which may have been destroyed.
+ */
+void UnixDatagramStream::receive_direct_continue(Mode mode,
+                                                 Callback callback,
+                                                 const ErrorCode& err,
+                                                 std::size_t received)
+{
+    if(!err && received == 0 && mode == SeqPacket) {
+        callback(boost::asio::error::eof, 0);
+    }
+    else {
+        callback(err, received);
+    }
+}
+
+void UnixDatagramStream::async_write_some(std::size_t count,
+                                          const uint8_t* data,
+                                          Callback callback)
+{
+    socket_->async_send(boost::asio::buffer(data, count),
+        this->record_write(count, callback));
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,176 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/UnixStream.h>
+#include <rtac_asio/UringQueue.h>
+
+namespace rtac { namespace asio {
+
+UnixStream::UnixStream(AsyncService::Ptr service, const std::string& path) :
+    StreamInterface(service),
+    socket_(nullptr)
+{
+    this->reset(EndPoint(path));
+}
+
+UnixStream::UnixStream(AsyncService::Ptr service, int nativeSocket) :
+    StreamInterface(service),
+    socket_(std::make_unique<Socket>(service->service(),
+                                     boost::asio::local::stream_protocol(),
+                                     nativeSocket))
+{
+    if(auto uring = this->service()->uring()) {
+        uring->register_file(socket_->native_handle());
+    }
+}
+
+UnixStream::~UnixStream()
+{
+    this->close();
+}
+
+UnixStream::Ptr UnixStream::Create(AsyncService::Ptr service, const std::string& path)
+{
+    return Ptr(new UnixStream(service, path));
+}
+
+UnixStream::Ptr UnixStream::Create(AsyncService::Ptr service, int nativeSocket)
+{
+    return Ptr(new UnixStream(service, nativeSocket));
+}
+
+void UnixStream::close()
+{
+    if(this->is_open()) {
+        if(auto uring = this->service()->uring()) {
+            uring->cancel(socket_->native_handle());
+            uring->unregister_file(socket_->native_handle());
+        }
+        ErrorCode err;
+        socket_->shutdown(Socket::shutdown_both, err);
+        socket_->cancel(err);
+        socket_->close(err);
+        if(err) {
+            std::cerr << "Error closing socket : '" << err << "'\n";
+        }
+    }
+}
+
+void UnixStream::reset(const EndPoint& remote)
+{
+    remote_ = remote;
+    this->reset();
+}
+
+void UnixStream::reset()
+{
+    this->close();
+    if(remote_.path().empty()) {
+        return; // created from a connected socket, nowhere to reconnect.
+    }
+    
+    socket_ = std::make_unique<Socket>(this->service()->service());
+    socket_->connect(remote_);
+    if(auto uring = this->service()->uring()) {
+        uring->register_file(socket_->native_handle());
+    }
+}
+
+void UnixStream::flush()
+{
+    // for compatibility with StreamInterface
+}
+
+bool UnixStream::is_open() const
+{
+    if(socket_)
+        return socket_->is_open();
+    return false;
+}
+
+int UnixStream::native_fd() const
+{
+    if(!this->is_open()) {
+        return -1;
+    }
+    return socket_->native_handle();
+}
+
+bool UnixStream::cancel()
+{
+    if(!this->is_open()) {
+        return false;
+    }
+    if(auto uring = this->service()->uring()) {
+        uring->cancel(socket_->native_handle());
+    }
+    ErrorCode err;
+    socket_->cancel(err);
+    return !err;
+}
+
+void UnixStream::async_read_some(std::size_t bufferSize,
+                                 uint8_t* buffer,
+                                 Callback callback)
+{
+    if(auto uring = this->service()->uring()) {
+        uring->async_read_some(socket_->native_handle(), buffer, bufferSize,
+                               this->record_read(bufferSize, callback));
+        return;
+    }
+    socket_->async_read_some(boost::asio::buffer(buffer, bufferSize),
+        this->record_read(bufferSize, callback));
+}
+
+std::size_t UnixStream::try_read_some(std::size_t bufferSize,
+                                      uint8_t* buffer,
+                                      ErrorCode& err)
+{
+    if(!this->is_open()) {
+        err = boost::asio::error::bad_descriptor;
+        return 0;
+    }
+    return this->native_try_read(socket_->native_handle(), true,
+                                 bufferSize, buffer, err);
+}
+
+void UnixStream::async_write_some(std::size_t count,
+                                  const uint8_t* data,
+                                  Callback callback)
+{
+    if(auto uring = this->service()->uring()) {
+        uring->async_write_some(socket_->native_handle(), data, count,
+                                this->record_write(count, callback));
+        return;
+    }
+    socket_->async_write_some(boost::asio::buffer(data, count),
+        this->record_write(count, callback));
+}
+
+} //namespace asio
+} //namespace rtac
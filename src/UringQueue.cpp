@@ -0,0 +1,612 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/UringQueue.h>
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/error.hpp>
+
+#ifdef RTAC_ASIO_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+#ifdef RTAC_ASIO_IO_URING
+
+namespace {
+
+int uring_setup(unsigned int entries, io_uring_params* params)
+{
+    return ::syscall(__NR_io_uring_setup, entries, params);
+}
+
+int uring_enter(int fd, unsigned int toSubmit,
+                unsigned int minComplete = 0, unsigned int flags = 0)
+{
+    return ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+// user_data of the timeout bounding drain(). Cancellations use 0.
+const uint64_t DrainTimeoutId = ~(uint64_t)0;
+
+int uring_register(int fd, unsigned int opcode, const void* arg, unsigned int count)
+{
+    return ::syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+} //namespace
+
+UringQueue::UringQueue(boost::asio::io_service& service,
+                       unsigned int entries,
+                       unsigned int fileSlots) :
+    service_(service),
+    ringFd_(-1),
+    sqRing_(nullptr),
+    sqRingSize_(0),
+    cqRing_(nullptr),
+    cqRingSize_(0),
+    sqes_(nullptr),
+    sqesSize_(0),
+    eventFd_(service),
+    eventValue_(0),
+    nextId_(1),
+    pending_(0),
+    flushPosted_(false),
+    fixedBuffer_(nullptr),
+    fixedBufferSize_(0)
+{
+    this->map_rings(entries);
+
+    int efd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(efd < 0 || uring_register(ringFd_, IORING_REGISTER_EVENTFD, &efd, 1) < 0) {
+        int error = errno;
+        if(efd >= 0) ::close(efd);
+        this->unmap_rings();
+        throw std::runtime_error(std::string("rtac::asio::UringQueue : could not "
+                                 "register completion eventfd (")
+                                 + std::strerror(error) + ")");
+    }
+    eventFd_.assign(efd);
+
+    this->setup_files(fileSlots);
+    this->wait_completions();
+}
+
+UringQueue::~UringQueue()
+{
+    // The callbacks of the operations still in flight are destroyed without
+    // being called, like the handlers of a destroyed io_service.
+    this->drain();
+    ErrorCode err;
+    eventFd_.close(err);
+    this->unmap_rings();
+}
+
+bool UringQueue::is_supported()
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = uring_setup(1, &params);
+    if(fd < 0) {
+        return false;
+    }
+    ::close(fd);
+    return true;
+}
+
+void UringQueue::map_rings(unsigned int entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd_ = uring_setup(entries, &params);
+    if(ringFd_ < 0) {
+        throw std::runtime_error(std::string("rtac::asio::UringQueue : io_uring "
+                                 "is not available (") + std::strerror(errno) + ")");
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes  + params.cq_entries*sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(singleMap) {
+        sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        cqRingSize_ = 0;
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if(sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        this->unmap_rings();
+        throw std::runtime_error("rtac::asio::UringQueue : could not map submission ring");
+    }
+    if(singleMap) {
+        cqRing_ = sqRing_;
+    }
+    else {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if(cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            this->unmap_rings();
+            throw std::runtime_error("rtac::asio::UringQueue : could not map completion ring");
+        }
+    }
+    sqesSize_ = params.sq_entries*sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        this->unmap_rings();
+        throw std::runtime_error("rtac::asio::UringQueue : could not map submission entries");
+    }
+    sqes_ = (io_uring_sqe*)sqes;
+
+    uint8_t* sq = (uint8_t*)sqRing_;
+    sqHead_    = (unsigned*)(sq + params.sq_off.head);
+    sqTail_    = (unsigned*)(sq + params.sq_off.tail);
+    sqArray_   = (unsigned*)(sq + params.sq_off.array);
+    sqMask_    = *(unsigned*)(sq + params.sq_off.ring_mask);
+    sqEntries_ = *(unsigned*)(sq + params.sq_off.ring_entries);
+
+    uint8_t* cq = (uint8_t*)cqRing_;
+    cqHead_ = (unsigned*)(cq + params.cq_off.head);
+    cqTail_ = (unsigned*)(cq + params.cq_off.tail);
+    cqMask_ = *(unsigned*)(cq + params.cq_off.ring_mask);
+    cqes_   = (io_uring_cqe*)(cq + params.cq_off.cqes);
+}
+
+void UringQueue::unmap_rings()
+{
+    if(sqes_) {
+        ::munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if(cqRing_ && cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = nullptr;
+    if(sqRing_) {
+        ::munmap(sqRing_, sqRingSize_);
+        sqRing_ = nullptr;
+    }
+    if(ringFd_ >= 0) {
+        ::close(ringFd_);
+        ringFd_ = -1;
+    }
+}
+
+/**
+ * Registers an empty (sparse) file table. Files are added to it by
+ * register_file. Fixed files are not used if the kernel refuses the table.
+ */
+void UringQueue::setup_files(unsigned int fileSlots)
+{
+    if(fileSlots == 0) {
+        return;
+    }
+    std::vector<int> files(fileSlots, -1);
+    if(uring_register(ringFd_, IORING_REGISTER_FILES, files.data(), fileSlots) < 0) {
+        std::cerr << "rtac::asio::UringQueue : could not register a file table ("
+                  << std::strerror(errno) << "), fixed files are disabled." << std::endl;
+        return;
+    }
+    files_ = std::move(files);
+}
+
+bool UringQueue::register_buffer(uint8_t* data, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(fixedBuffer_ || !data || size == 0) {
+        return false;
+    }
+    iovec vec;
+    vec.iov_base = data;
+    vec.iov_len  = size;
+    if(uring_register(ringFd_, IORING_REGISTER_BUFFERS, &vec, 1) < 0) {
+        std::cerr << "rtac::asio::UringQueue : could not register buffer ("
+                  << std::strerror(errno) << ")." << std::endl;
+        return false;
+    }
+    fixedBuffer_     = data;
+    fixedBufferSize_ = size;
+    return true;
+}
+
+bool UringQueue::register_file(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(fileSlots_.count(fd) > 0) {
+        return true;
+    }
+    for(unsigned int slot = 0; slot < files_.size(); slot++) {
+        if(files_[slot] >= 0) {
+            continue;
+        }
+        io_uring_files_update update;
+        std::memset(&update, 0, sizeof(update));
+        update.offset = slot;
+        update.fds    = (uint64_t)(uintptr_t)&fd;
+        if(uring_register(ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1) {
+            return false;
+        }
+        files_[slot]   = fd;
+        fileSlots_[fd] = slot;
+        return true;
+    }
+    return false; // table full, fd is used directly.
+}
+
+void UringQueue::unregister_file(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = fileSlots_.find(fd);
+    if(it == fileSlots_.end()) {
+        return;
+    }
+    int none = -1;
+    io_uring_files_update update;
+    std::memset(&update, 0, sizeof(update));
+    update.offset = it->second;
+    update.fds    = (uint64_t)(uintptr_t)&none;
+    uring_register(ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1);
+    files_[it->second] = -1;
+    fileSlots_.erase(it);
+}
+
+/**
+ * Returns the next free submission entry. If the ring is full the queued
+ * entries are submitted first. Called with mutex_ held.
+ */
+io_uring_sqe* UringQueue::get_sqe()
+{
+    unsigned tail = *sqTail_;
+    if(tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        this->submit();
+        if(tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+            return nullptr;
+        }
+    }
+    unsigned index = tail & sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    return sqe;
+}
+
+void UringQueue::queue(uint8_t opcode, int fd, const uint8_t* buffer, std::size_t size,
+                       const Callback& callback)
+{
+    bool read = opcode == IORING_OP_READ;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        io_uring_sqe* sqe = this->get_sqe();
+        if(!sqe) {
+            boost::asio::post(service_, std::bind(callback,
+                ErrorCode(boost::asio::error::no_buffer_space), 0));
+            return;
+        }
+        uint64_t id = nextId_++;
+        sqe->opcode    = opcode;
+        sqe->fd        = fd;
+        sqe->addr      = (uint64_t)(uintptr_t)buffer;
+        sqe->len       = size;
+        sqe->off       = (uint64_t)-1; // current position (sockets ignore it)
+        sqe->user_data = id;
+
+        auto slot = fileSlots_.find(fd);
+        if(slot != fileSlots_.end()) {
+            sqe->fd     = slot->second;
+            sqe->flags |= IOSQE_FIXED_FILE;
+            stats_.fixedFiles++;
+        }
+        if(fixedBuffer_ && buffer >= fixedBuffer_
+           && buffer + size <= fixedBuffer_ + fixedBufferSize_)
+        {
+            sqe->opcode    = read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+            sqe->buf_index = 0;
+            stats_.fixedBuffers++;
+        }
+        __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+        pending_++;
+        stats_.submitted++;
+
+        operations_.emplace(id, Operation{fd, callback, read && size > 0});
+
+        if(flushPosted_) {
+            return;
+        }
+        flushPosted_ = true;
+    }
+    // All the operations queued by the handlers already waiting in the
+    // io_service are submitted together. The submission is always done from
+    // the io_service thread, which reaps the operations completed inline.
+    boost::asio::post(service_, std::bind(&UringQueue::flush, this));
+}
+
+/**
+ * Hands the queued entries to the kernel. Called with mutex_ held.
+ */
+void UringQueue::submit()
+{
+    while(pending_ > 0) {
+        int res = uring_enter(ringFd_, pending_);
+        stats_.enters++;
+        if(res < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            // EAGAIN or EBUSY : the kernel is short of resources or the
+            // completion queue is full. Retried at the next flush.
+            if(!flushPosted_) {
+                flushPosted_ = true;
+                boost::asio::post(service_, std::bind(&UringQueue::flush, this));
+            }
+            return;
+        }
+        pending_ -= std::min<unsigned int>(res, pending_);
+        if(res == 0) {
+            return;
+        }
+    }
+}
+
+void UringQueue::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flushPosted_ = false;
+        this->submit();
+    }
+    // Operations which could complete during the submission (such as most
+    // socket writes) are handled without waiting for the eventfd.
+    this->reap();
+}
+
+void UringQueue::wait_completions()
+{
+    eventFd_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+        std::bind(&UringQueue::completions_ready, this, _1));
+}
+
+void UringQueue::completions_ready(const ErrorCode& err)
+{
+    if(err == boost::asio::error::operation_aborted) {
+        return;
+    }
+    // The wait is armed again before the eventfd is drained : a completion
+    // signaled after the drain is seen by the new wait. async_wait does not
+    // make a speculative read of the eventfd like async_read_some would.
+    this->wait_completions();
+    ::read(eventFd_.native_handle(), &eventValue_, sizeof(eventValue_));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.wakeups++;
+    }
+    this->reap();
+}
+
+void UringQueue::reap()
+{
+    struct Completion {
+        Callback    callback;
+        ErrorCode   err;
+        std::size_t count;
+    };
+    std::vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        if(head == tail) {
+            return;
+        }
+        completions.reserve(tail - head);
+        for(; head != tail; head++) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            auto it = operations_.find(cqe.user_data);
+            if(it == operations_.end()) {
+                continue; // cancellation request
+            }
+            Completion completion{std::move(it->second.callback), ErrorCode(), 0};
+            if(cqe.res == -ECANCELED) {
+                completion.err = boost::asio::error::operation_aborted;
+            }
+            else if(cqe.res < 0) {
+                completion.err = ErrorCode(-cqe.res, boost::system::system_category());
+            }
+            else if(cqe.res == 0 && it->second.read) {
+                completion.err = boost::asio::error::eof;
+            }
+            else {
+                completion.count = cqe.res;
+            }
+            completions.push_back(std::move(completion));
+            operations_.erase(it);
+            stats_.completed++;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+    for(auto& c : completions) {
+        c.callback(c.err, c.count);
+    }
+}
+
+/**
+ * Cancels the operations in flight and waits for their completion. Closing
+ * the ring does not wait for them : the kernel could still write in the
+ * buffers (the BufferPool arena, the buffers of the streams) after they are
+ * released. The wait is bounded in case an operation cannot be cancelled.
+ */
+void UringQueue::drain()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(operations_.empty()) {
+        return;
+    }
+    for(auto& op : operations_) {
+        io_uring_sqe* sqe = this->get_sqe();
+        if(!sqe) {
+            break;
+        }
+        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe->fd        = -1;
+        sqe->addr      = op.first;
+        sqe->user_data = 0;
+        __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+        pending_++;
+    }
+
+    __kernel_timespec timeout;
+    timeout.tv_sec  = 1;
+    timeout.tv_nsec = 0;
+    io_uring_sqe* sqe = this->get_sqe();
+    if(!sqe) {
+        std::cerr << "rtac::asio::UringQueue : could not wait for the "
+                  << operations_.size() << " operations in flight." << std::endl;
+        return;
+    }
+    sqe->opcode    = IORING_OP_TIMEOUT;
+    sqe->fd        = -1;
+    sqe->addr      = (uint64_t)(uintptr_t)&timeout; // copied at submission
+    sqe->len       = 1;
+    sqe->user_data = DrainTimeoutId;
+    __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+    pending_++;
+
+    while(!operations_.empty()) {
+        int res = uring_enter(ringFd_, pending_, 1, IORING_ENTER_GETEVENTS);
+        if(res < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(errno != EAGAIN && errno != EBUSY) {
+                std::cerr << "rtac::asio::UringQueue : could not wait for the "
+                          << "operations in flight (" << std::strerror(errno)
+                          << ")." << std::endl;
+                return;
+            }
+            res = 0; // completion queue full, reaped below
+        }
+        pending_ -= std::min<unsigned int>(res, pending_);
+
+        bool expired = false;
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            if(cqe.user_data == DrainTimeoutId) {
+                expired = true;
+            }
+            else {
+                operations_.erase(cqe.user_data);
+            }
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        if(expired && !operations_.empty()) {
+            std::cerr << "rtac::asio::UringQueue : " << operations_.size()
+                      << " operations still in flight at destruction." << std::endl;
+            return;
+        }
+    }
+}
+
+void UringQueue::async_read_some(int fd, uint8_t* buffer, std::size_t size,
+                                 const Callback& callback)
+{
+    this->queue(IORING_OP_READ, fd, buffer, size, callback);
+}
+
+void UringQueue::async_write_some(int fd, const uint8_t* data, std::size_t size,
+                                  const Callback& callback)
+{
+    this->queue(IORING_OP_WRITE, fd, data, size, callback);
+}
+
+void UringQueue::cancel(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto& op : operations_) {
+        if(op.second.fd != fd) {
+            continue;
+        }
+        io_uring_sqe* sqe = this->get_sqe();
+        if(!sqe) {
+            break;
+        }
+        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe->fd        = -1;
+        sqe->addr      = op.first;
+        sqe->user_data = 0;
+        __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+        pending_++;
+    }
+    this->submit();
+}
+
+#else //RTAC_ASIO_IO_URING
+
+UringQueue::UringQueue(boost::asio::io_service& service, unsigned int, unsigned int) :
+    service_(service),
+    eventFd_(service)
+{
+    throw std::runtime_error("rtac::asio::UringQueue : rtac_asio was built "
+                             "without io_uring support");
+}
+
+UringQueue::~UringQueue() {}
+bool UringQueue::is_supported() { return false; }
+bool UringQueue::register_buffer(uint8_t*, std::size_t) { return false; }
+bool UringQueue::register_file(int) { return false; }
+void UringQueue::unregister_file(int) {}
+void UringQueue::async_read_some(int, uint8_t*, std::size_t, const Callback&) {}
+void UringQueue::async_write_some(int, const uint8_t*, std::size_t, const Callback&) {}
+void UringQueue::cancel(int) {}
+
+#endif //RTAC_ASIO_IO_URING
+
+UringQueue::Stats UringQueue::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+} //namespace asio
+} //namespace rtac
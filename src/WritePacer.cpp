@@ -0,0 +1,191 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/WritePacer.h>
+
+#include <cmath>
+#include <algorithm>
+
+#include <boost/asio/error.hpp>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+namespace {
+
+double checked_rate(double bytesPerSecond)
+{
+    // also rejects NaN
+    if(!(bytesPerSecond > 0.0) || !std::isfinite(bytesPerSecond)) {
+        throw std::runtime_error(
+            "rtac::asio::WritePacer : the rate must be positive and finite.");
+    }
+    return bytesPerSecond;
+}
+
+} //namespace
+
+WritePacer::WritePacer(StreamInterface::Ptr stream, double bytesPerSecond,
+                       std::size_t burst, OperationCounters::Ptr counters) :
+    stream_(stream),
+    rate_(checked_rate(bytesPerSecond)),
+    burst_(std::max<std::size_t>(1, burst)),
+    tokens_(burst_),
+    refilled_(Clock::now()),
+    waiting_(false),
+    waitId_(0),
+    counters_(counters)
+{}
+
+WritePacer::Ptr WritePacer::Create(StreamInterface::Ptr stream, double bytesPerSecond,
+                                   std::size_t burst, OperationCounters::Ptr counters)
+{
+    return Ptr(new WritePacer(stream, bytesPerSecond, burst, counters));
+}
+
+void WritePacer::set_rate(double bytesPerSecond, std::size_t burst)
+{
+    checked_rate(bytesPerSecond);
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->refill(Clock::now());
+    rate_   = bytesPerSecond;
+    burst_  = std::max<std::size_t>(1, burst);
+    tokens_ = std::min(tokens_, burst_);
+}
+
+/**
+ * Must be called with mutex_ locked.
+ */
+void WritePacer::refill(const Clock::time_point& now)
+{
+    double elapsed = std::chrono::duration<double>(now - refilled_).count();
+    tokens_   = std::min(burst_, tokens_ + rate_*elapsed);
+    refilled_ = now;
+}
+
+std::size_t WritePacer::available() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    double elapsed = std::chrono::duration<double>(Clock::now() - refilled_).count();
+    return std::min(burst_, tokens_ + rate_*elapsed);
+}
+
+void WritePacer::async_write_some(std::size_t count, const uint8_t* data,
+                                  Callback callback)
+{
+    this->start_write(count, data, callback, 0);
+}
+
+void WritePacer::start_write(std::size_t count, const uint8_t* data,
+                             Callback callback, unsigned int waitId)
+{
+    bool delayed = waitId > 0;
+    std::size_t granted = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(delayed && (!waiting_ || waitId != waitId_)) {
+            // cancelled in the meantime
+            return;
+        }
+        auto now = Clock::now();
+        this->refill(now);
+
+        // Waits for the whole write or a full burst, so that a large write
+        // is sent in bursts instead of one millisecond worth of bytes at a
+        // time.
+        double needed = std::min<double>(count, burst_);
+        if(tokens_ >= needed || (delayed && tokens_ >= 1.0)) {
+            granted = std::min<std::size_t>(count, tokens_);
+            tokens_ -= granted;
+            if(waiting_) {
+                waiting_ = false;
+                waitingCallback_ = nullptr;
+                if(counters_) {
+                    counters_->pacing.record(now - delayStart_);
+                }
+            }
+        }
+        else {
+            if(!waiting_) {
+                waiting_    = true;
+                delayStart_ = now;
+                waitId_     = std::max(1u, waitId_ + 1);
+                if(counters_) {
+                    counters_->add(counters_->paced);
+                }
+            }
+            waitingCallback_ = callback;
+            unsigned int delayMillis = std::max(1.0,
+                std::ceil(1000.0*(needed - tokens_) / rate_));
+            timer_ = stream_->service()->timer_wheel().arm(delayMillis,
+                std::bind(&WritePacer::start_write, this->shared_from_this(),
+                          count, data, callback, waitId_));
+            return;
+        }
+    }
+    stream_->async_write_some(granted, data,
+        std::bind(&WritePacer::write_continue, this->shared_from_this(),
+                  granted, callback, _1, _2));
+}
+
+void WritePacer::write_continue(std::size_t granted, Callback callback,
+                                const ErrorCode& err, std::size_t writtenCount)
+{
+    if(writtenCount < granted) {
+        // bytes not sent are given back to the bucket
+        std::lock_guard<std::mutex> lock(mutex_);
+        tokens_ = std::min(burst_, tokens_ + granted - writtenCount);
+    }
+    callback(err, writtenCount);
+}
+
+bool WritePacer::cancel()
+{
+    Callback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!waiting_) {
+            return false;
+        }
+        stream_->service()->timer_wheel().cancel(timer_);
+        waiting_ = false;
+        callback = std::move(waitingCallback_);
+        waitingCallback_ = nullptr;
+        if(counters_) {
+            counters_->pacing.record(Clock::now() - delayStart_);
+        }
+    }
+    stream_->service()->post(std::bind(callback,
+        ErrorCode(boost::asio::error::operation_aborted), 0),
+        PostTag(stream_.get(), "paced write"));
+    return true;
+}
+
+} //namespace asio
+} //namespace rtac
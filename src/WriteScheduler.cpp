@@ -0,0 +1,336 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/WriteScheduler.h>
+
+#include <algorithm>
+
+#include <boost/asio/error.hpp>
+
+#include <rtac_asio/tracepoints.h>
+
+namespace rtac { namespace asio {
+
+using namespace std::placeholders;
+
+WriteScheduler::WriteScheduler(StreamInterface::Ptr stream, const Parameters& params,
+                               std::ofstream* txDump, OperationCounters::Ptr counters) :
+    stream_(stream),
+    parameters_(params),
+    systemTime_(0.0),
+    requestCounter_(0),
+    writing_(false),
+    current_(0),
+    sliceLeft_(0),
+    stopped_(false),
+    txDump_(txDump),
+    counters_(counters)
+{
+    if(parameters_.weights.size() == 0) {
+        throw std::runtime_error(
+            "rtac::asio::WriteScheduler : at least one priority class is needed.");
+    }
+    for(auto& w : parameters_.weights) {
+        // a null weight would never be served.
+        w = std::max(1u, w);
+    }
+    classes_.resize(parameters_.weights.size());
+    virtualTime_.resize(parameters_.weights.size(), 0.0);
+}
+
+WriteScheduler::Ptr WriteScheduler::Create(StreamInterface::Ptr stream,
+                                           const Parameters& params,
+                                           std::ofstream* txDump,
+                                           OperationCounters::Ptr counters)
+{
+    return Ptr(new WriteScheduler(stream, params, txDump, counters));
+}
+
+bool WriteScheduler::async_write(std::size_t count, const uint8_t* data,
+                                 Callback callback, bool exact,
+                                 unsigned int priority, unsigned int timeoutMillis)
+{
+    priority = std::min<unsigned int>(priority, classes_.size() - 1);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& queue = classes_[priority];
+        if(stopped_ || queue.size() >= parameters_.maxQueued) {
+            if(counters_) {
+                counters_->add(counters_->busy);
+            }
+            return false;
+        }
+
+        Request request;
+        request.id        = ++requestCounter_;
+        request.size      = count;
+        request.data      = data;
+        request.callback  = callback;
+        request.exact     = exact;
+        request.processed = 0;
+        request.timedOut  = false;
+        if(counters_) {
+            request.start = OperationCounters::Clock::now();
+        }
+        RTAC_ASIO_TRACE(write_start, stream_.get(), request.id, count);
+        if(timeoutMillis > 0) {
+            request.timeout = stream_->service()->timer_wheel().arm(timeoutMillis,
+                std::bind(&WriteScheduler::timeout_reached, this->shared_from_this(),
+                          priority, request.id));
+        }
+        if(queue.size() == 0) {
+            // A class becoming active does not get credit for the time it
+            // was idle.
+            virtualTime_[priority] = std::max(virtualTime_[priority], systemTime_);
+        }
+        queue.push_back(std::move(request));
+    }
+    this->start_write();
+    return true;
+}
+
+std::function<void()> WriteScheduler::completion(const Request& request,
+                                                 const ErrorCode& err)
+{
+    RTAC_ASIO_TRACE(write_done, stream_.get(), request.id,
+                    request.processed, err.value());
+    if(counters_) {
+        return OperationCounters::complete(counters_, request.callback, err,
+                                           request.processed, request.start);
+    }
+    return std::bind(request.callback, err, request.processed);
+}
+
+/**
+ * Must be called with mutex_ locked.
+ */
+void WriteScheduler::complete_front(unsigned int priority, const ErrorCode& err)
+{
+    Request request = std::move(classes_[priority].front());
+    classes_[priority].pop_front();
+    if(priority == current_) {
+        sliceLeft_ = 0;
+    }
+    stream_->service()->timer_wheel().cancel(request.timeout);
+    stream_->service()->post(this->completion(request, err),
+                             PostTag(stream_.get(), "scheduled write"));
+}
+
+/**
+ * Class of the next slice, -1 if all classes are empty. Must be called with
+ * mutex_ locked.
+ */
+int WriteScheduler::next_class() const
+{
+    int res = -1;
+    for(unsigned int c = 0; c < classes_.size(); c++) {
+        if(classes_[c].size() == 0) {
+            continue;
+        }
+        if(parameters_.policy == StrictPriority) {
+            return c;
+        }
+        if(res < 0 || virtualTime_[c] < virtualTime_[res]) {
+            res = c;
+        }
+    }
+    return res;
+}
+
+void WriteScheduler::start_write()
+{
+    const uint8_t*  data;
+    std::size_t     size;
+    WritePacer::Ptr pacer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(writing_ || stopped_) {
+            return;
+        }
+        if(sliceLeft_ == 0) {
+            int c = this->next_class();
+            if(c < 0) {
+                return;
+            }
+            auto& request = classes_[c].front();
+            sliceLeft_ = request.size - request.processed;
+            if(parameters_.sliceSize > 0) {
+                sliceLeft_ = std::min(sliceLeft_, parameters_.sliceSize);
+            }
+            current_    = c;
+            systemTime_ = virtualTime_[c];
+        }
+        // else the stream did not write the whole slice, the rest is written
+        // before switching to another write.
+        auto& request = classes_[current_].front();
+        data     = request.data + request.processed;
+        size     = sliceLeft_;
+        writing_ = true;
+        pacer    = pacer_;
+    }
+    // Outside of the lock, some streams may call the handler right away.
+    auto callback = std::bind(&WriteScheduler::write_continue,
+                              this->shared_from_this(), _1, _2);
+    if(pacer) {
+        pacer->async_write_some(size, data, callback);
+    }
+    else {
+        stream_->async_write_some(size, data, callback);
+    }
+}
+
+void WriteScheduler::write_continue(const ErrorCode& err, std::size_t writtenCount)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        writing_ = false;
+        virtualTime_[current_] += double(writtenCount)
+                                / parameters_.weights[current_];
+        auto& queue = classes_[current_];
+        if(queue.size() == 0) {
+            // stopped in the meantime
+            return;
+        }
+        auto& request = queue.front();
+        if(writtenCount > 0 && txDump_ && txDump_->is_open()) {
+            txDump_->write((const char*)request.data + request.processed, writtenCount);
+            txDump_->flush();
+        }
+        request.processed += writtenCount;
+        sliceLeft_ -= std::min(sliceLeft_, writtenCount);
+
+        bool aborted = err == boost::asio::error::operation_aborted;
+        if(request.processed >= request.size
+           || (!request.exact && request.processed > 0))
+        {
+            this->complete_front(current_, ErrorCode());
+        }
+        else if(stopped_) {
+            this->complete_front(current_, boost::asio::error::operation_aborted);
+        }
+        else if(request.timedOut) {
+            this->complete_front(current_, boost::asio::error::timed_out);
+        }
+        else if(err && !(aborted && stream_->is_open())) {
+            this->complete_front(current_, err);
+        }
+        // An aborted write while the stream is still open was cancelled for
+        // another reason (the timeout of a read...). It is simply continued.
+    }
+    this->start_write();
+}
+
+/**
+ * A queued write is removed from its class. The write of a slice of the
+ * write cannot be interrupted : the stream operation is cancelled and the
+ * write ends in write_continue.
+ */
+void WriteScheduler::timeout_reached(unsigned int priority, unsigned int id)
+{
+    bool cancel = false;
+    WritePacer::Ptr pacer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& queue = classes_[priority];
+        for(auto it = queue.begin(); it != queue.end(); it++) {
+            if(it->id != id) {
+                continue;
+            }
+            RTAC_ASIO_TRACE(write_timeout, stream_.get(), id);
+            if(writing_ && current_ == priority && it == queue.begin()) {
+                it->timedOut = true;
+                cancel = true;
+                pacer  = pacer_;
+            }
+            else {
+                if(current_ == priority && it == queue.begin()) {
+                    sliceLeft_ = 0;
+                }
+                stream_->service()->post(this->completion(*it,
+                    boost::asio::error::timed_out),
+                    PostTag(stream_.get(), "scheduled write"));
+                queue.erase(it);
+            }
+            break;
+        }
+    }
+    if(cancel && !(pacer && pacer->cancel())) {
+        // If the stream cannot cancel its operations, the write ends after
+        // the current slice.
+        stream_->cancel();
+    }
+}
+
+void WriteScheduler::set_pacer(WritePacer::Ptr pacer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pacer_ = pacer;
+}
+
+void WriteScheduler::stop()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    // The dump file belongs to the StreamWriter, which may be destroyed
+    // before the slice being written completes.
+    txDump_ = nullptr;
+    for(unsigned int c = 0; c < classes_.size(); c++) {
+        auto& queue = classes_[c];
+        // The request of the slice being written is kept until the slice
+        // completes (the stream still reads its data).
+        std::size_t keep = (writing_ && c == current_) ? 1 : 0;
+        while(queue.size() > keep) {
+            Request request = std::move(queue.back());
+            queue.pop_back();
+            stream_->service()->timer_wheel().cancel(request.timeout);
+            stream_->service()->post(this->completion(request,
+                boost::asio::error::operation_aborted),
+                PostTag(stream_.get(), "scheduled write"));
+        }
+    }
+}
+
+std::size_t WriteScheduler::queued() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t res = 0;
+    for(auto& c : classes_) {
+        res += c.size();
+    }
+    return res;
+}
+
+std::size_t WriteScheduler::queued(unsigned int priority) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    priority = std::min<unsigned int>(priority, classes_.size() - 1);
+    return classes_[priority].size();
+}
+
+} //namespace asio
+} //namespace rtac
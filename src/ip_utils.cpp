@@ -28,6 +28,8 @@
 
 #include <rtac_asio/ip_utils.h>
 
+#include <algorithm>
+
 namespace rtac { namespace asio {
 
 boost::asio::ip::address make_address(const std::string& ipStr)
@@ -39,8 +41,182 @@ boost::asio::ip::address make_address(const std::string& ipStr)
     #endif
 }
 
-} //namespace asio
-} //namespace rtac
+/**
+ * Same as make_address but returns false instead of throwing when ipStr is
+ * not a numeric address.
+ */
+bool parse_address(const std::string& ipStr, boost::asio::ip::address& address)
+{
+    boost::system::error_code err;
+    #ifdef RTAC_BOOST_OLD_VERSION
+    address = boost::asio::ip::address::from_string(ipStr, err);
+    #else
+    address = boost::asio::ip::make_address(ipStr, err);
+    #endif
+    return !err;
+}
+
+Resolver::Resolver(unsigned int ttlMillis) :
+    state_(std::make_shared<State>()),
+    service_(AsyncService::Create())
+{
+    state_->ttl = std::chrono::milliseconds(ttlMillis);
+}
+
+/**
+ * The lookup service is stopped first, so that no lookup completes while
+ * the pending callers are notified.
+ */
+Resolver::~Resolver()
+{
+    service_->stop();
+
+    std::unordered_map<std::string, std::vector<Waiter>> pending;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        pending = std::move(state_->pending);
+        state_->pending.clear();
+    }
+    for(auto& entry : pending) {
+        for(auto& waiter : entry.second) {
+            waiter.service->post(std::bind(waiter.callback,
+                ErrorCode(boost::asio::error::operation_aborted), AddressList()),
+                                 PostTag(state_.get(), "resolve"));
+        }
+    }
+}
+
+Resolver::Ptr Resolver::Create(unsigned int ttlMillis)
+{
+    return Ptr(new Resolver(ttlMillis));
+}
 
+Resolver::Ptr Resolver::Default()
+{
+    static Ptr instance = Create();
+    return instance;
+}
 
+void Resolver::set_ttl(unsigned int ttlMillis)
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->ttl = std::chrono::milliseconds(ttlMillis);
+}
 
+unsigned int Resolver::ttl() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->ttl.count();
+}
+
+void Resolver::clear()
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->cache.clear();
+}
+
+/**
+ * Returns true if host is a numeric address or was found in the cache and
+ * has not expired. This never triggers a lookup.
+ */
+bool Resolver::lookup(const std::string& host, AddressList& addresses) const
+{
+    Address address;
+    if(parse_address(host, address)) {
+        addresses.assign(1, address);
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    auto it = state_->cache.find(host);
+    if(it == state_->cache.end() || it->second.expiration < Clock::now()) {
+        return false;
+    }
+    addresses = it->second.addresses;
+    return true;
+}
+
+/**
+ * Resolves host and calls callback with the resolved addresses on the given
+ * AsyncService. The callback is never called from within this function.
+ */
+void Resolver::async_resolve(AsyncService::Ptr service, const std::string& host,
+                             const Callback& callback)
+{
+    AddressList addresses;
+    if(this->lookup(host, addresses)) {
+        service->post(std::bind(callback, ErrorCode(), addresses),
+                      PostTag(state_.get(), "resolve"));
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        auto& waiters = state_->pending[host];
+        waiters.push_back(Waiter{service, callback});
+        if(waiters.size() > 1) {
+            // a lookup for this host is already in progress.
+            return;
+        }
+    }
+
+    service_->start();
+
+    using tcp = boost::asio::ip::tcp;
+    auto resolver = std::make_shared<tcp::resolver>(service_->service());
+    auto state    = state_;
+    #ifdef RTAC_BOOST_OLD_VERSION
+    resolver->async_resolve(tcp::resolver::query(host, ""),
+        [state, host, resolver](const ErrorCode& err, tcp::resolver::iterator it) {
+            AddressList addresses;
+            for(; it != tcp::resolver::iterator(); it++) {
+                if(std::find(addresses.begin(), addresses.end(),
+                             it->endpoint().address()) == addresses.end()) {
+                    addresses.push_back(it->endpoint().address());
+                }
+            }
+            Resolver::resolve_continue(state, host, err, addresses);
+        });
+    #else
+    resolver->async_resolve(host, "",
+        [state, host, resolver](const ErrorCode& err, tcp::resolver::results_type results) {
+            AddressList addresses;
+            for(const auto& entry : results) {
+                if(std::find(addresses.begin(), addresses.end(),
+                             entry.endpoint().address()) == addresses.end()) {
+                    addresses.push_back(entry.endpoint().address());
+                }
+            }
+            Resolver::resolve_continue(state, host, err, addresses);
+        });
+    #endif
+}
+
+void Resolver::resolve_continue(const StatePtr& state, const std::string& host,
+                                const ErrorCode& err, const AddressList& addresses)
+{
+    std::vector<Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if(!err && addresses.size() > 0) {
+            state->cache[host] = Entry{addresses, Clock::now() + state->ttl};
+        }
+        auto it = state->pending.find(host);
+        if(it != state->pending.end()) {
+            waiters = std::move(it->second);
+            state->pending.erase(it);
+        }
+    }
+
+    ErrorCode res = err;
+    if(!res && addresses.size() == 0) {
+        res = boost::asio::error::host_not_found;
+    }
+    for(auto& waiter : waiters) {
+        waiter.service->post(std::bind(waiter.callback, res, addresses),
+                             PostTag(state.get(), "resolve"));
+    }
+}
+
+} //namespace asio
+} //namespace rtac
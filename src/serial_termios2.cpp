@@ -0,0 +1,78 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/serial_utils.h>
+
+#include <boost/asio/error.hpp>
+
+// This file must not include <termios.h> (directly or through boost) : the
+// kernel termios2 definitions conflict with the libc ones.
+#ifdef __linux__
+#include <asm/termbits.h>
+#include <asm/ioctls.h>
+extern "C" int ioctl(int fd, unsigned long request, ...);
+#endif
+
+namespace rtac { namespace asio {
+
+boost::system::error_code set_custom_baudrate(int fd, unsigned int baudrate)
+{
+    #if defined(__linux__) && defined(BOTHER)
+    struct termios2 config;
+    if(ioctl(fd, TCGETS2, &config) != 0) {
+        return boost::system::error_code(errno, boost::asio::error::get_system_category());
+    }
+    config.c_cflag &= ~CBAUD;
+    config.c_cflag |= BOTHER;
+    config.c_ispeed = baudrate;
+    config.c_ospeed = baudrate;
+    if(ioctl(fd, TCSETS2, &config) != 0) {
+        return boost::system::error_code(errno, boost::asio::error::get_system_category());
+    }
+    return boost::system::error_code();
+    #else
+    return boost::asio::error::operation_not_supported;
+    #endif
+}
+
+boost::system::error_code get_baudrate(int fd, unsigned int& baudrate)
+{
+    #if defined(__linux__) && defined(BOTHER)
+    struct termios2 config;
+    if(ioctl(fd, TCGETS2, &config) != 0) {
+        return boost::system::error_code(errno, boost::asio::error::get_system_category());
+    }
+    baudrate = config.c_ospeed;
+    return boost::system::error_code();
+    #else
+    return boost::asio::error::operation_not_supported;
+    #endif
+}
+
+} //namespace asio
+} //namespace rtac
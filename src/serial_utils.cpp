@@ -0,0 +1,123 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <rtac_asio/serial_utils.h>
+
+#include <fstream>
+
+#include <boost/asio/error.hpp>
+
+#include <termios.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+namespace rtac { namespace asio {
+
+namespace {
+
+boost::system::error_code errno_code()
+{
+    return boost::system::error_code(errno, boost::asio::error::get_system_category());
+}
+
+} //namespace
+
+boost::system::error_code set_raw_mode(int fd, uint8_t vmin, uint8_t vtime)
+{
+    termios config;
+    if(::tcgetattr(fd, &config) != 0) {
+        return errno_code();
+    }
+    // Not cfmakeraw : it also forces 8N1 and clears IXON, which would undo
+    // the character size, parity and flow control of the port.
+    config.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
+    config.c_oflag &= ~OPOST;
+    config.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    config.c_cflag |= CLOCAL | CREAD;
+    config.c_cc[VMIN]  = vmin;
+    config.c_cc[VTIME] = vtime;
+    if(::tcsetattr(fd, TCSANOW, &config) != 0) {
+        return errno_code();
+    }
+    return boost::system::error_code();
+}
+
+boost::system::error_code set_low_latency(int fd, bool enable)
+{
+    #if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+    serial_struct serial;
+    if(::ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+        return errno_code();
+    }
+    if(enable) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    }
+    else {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    if(::ioctl(fd, TIOCSSERIAL, &serial) != 0) {
+        return errno_code();
+    }
+    return boost::system::error_code();
+    #else
+    return boost::asio::error::operation_not_supported;
+    #endif
+}
+
+bool low_latency_enabled(int fd)
+{
+    #if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+    serial_struct serial;
+    if(::ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+        return false;
+    }
+    return serial.flags & ASYNC_LOW_LATENCY;
+    #else
+    return false;
+    #endif
+}
+
+boost::system::error_code set_usb_latency_timer(const std::string& device,
+                                                unsigned int millis)
+{
+    auto name = device.substr(device.find_last_of('/') + 1);
+    std::ofstream f("/sys/bus/usb-serial/devices/" + name + "/latency_timer");
+    if(!f.is_open()) {
+        return boost::asio::error::operation_not_supported;
+    }
+    f << millis << std::flush;
+    if(!f) {
+        return boost::asio::error::access_denied;
+    }
+    return boost::system::error_code();
+}
+
+} //namespace asio
+} //namespace rtac
@@ -0,0 +1,144 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <functional>
+#include <future>
+#include <cstring>
+#include <vector>
+#include <set>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+// Reads in blocks lent by the reader (async_read_borrowed) : blocks are
+// recycled from a fixed pool and datagrams are received directly in them.
+
+struct Result {
+    Stream::ErrorCode error;
+    BorrowedBuffer    buffer;
+};
+
+Result read_borrowed(Stream::Ptr stream)
+{
+    std::promise<Result> promise;
+    bool started = stream->async_read_borrowed(
+        [&](const Stream::ErrorCode& err, BorrowedBuffer buffer) {
+            // moved : the lease must not outlive the result
+            promise.set_value(Result{err, std::move(buffer)});
+        }, 1000);
+    if(!started) {
+        return Result{boost::asio::error::no_buffer_space, BorrowedBuffer()};
+    }
+    return promise.get_future().get();
+}
+
+int main()
+{
+    std::string path = "/tmp/rtac_asio_borrowed_read.sock";
+    ::unlink(path.c_str());
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    int listenFd = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    ::bind(listenFd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(listenFd, 1);
+
+    auto stream = Stream::CreateUnixDatagram(path);
+    int peer = ::accept(listenFd, nullptr, nullptr);
+    auto pool = ReadBlockPool::Create(4, 65536);
+    stream->set_block_pool(pool);
+    stream->start();
+
+    bool ok = true;
+
+    // data is delivered in the borrowed block
+    {
+        ::send(peer, "hello", 5, 0);
+        auto res = read_borrowed(stream);
+        ok &= check(!res.error && res.buffer.size() == 5
+                    && std::memcmp(res.buffer.data(), "hello", 5) == 0,
+                    "borrowed buffer holds the datagram");
+        ok &= check(pool->available() == 3, "block lent while buffer is held");
+        res.buffer.release();
+        ok &= check(pool->available() == 4, "block returned on release");
+    }
+
+    // pool exhaustion
+    {
+        std::vector<BorrowedBuffer> held;
+        std::set<const uint8_t*> blocks;
+        for(int i = 0; i < 4; i++) {
+            std::string msg = "datagram " + std::to_string(i);
+            ::send(peer, msg.c_str(), msg.size(), 0);
+            auto res = read_borrowed(stream);
+            ok &= check(!res.error && std::string((const char*)res.buffer.data(),
+                                                  res.buffer.size()) == msg,
+                        "read " + msg);
+            blocks.insert(res.buffer.data());
+            held.push_back(res.buffer);
+        }
+        ok &= check(blocks.size() == 4, "each held buffer has its own block");
+
+        bool started = stream->async_read_borrowed(
+            [](const Stream::ErrorCode&, BorrowedBuffer) {});
+        ok &= check(!started, "read refused when all blocks are lent");
+
+        // releasing one block makes reads possible again, in the same block.
+        const uint8_t* released = held[2].data();
+        held[2].release();
+        ::send(peer, "recycled", 8, 0);
+        auto res = read_borrowed(stream);
+        ok &= check(!res.error && res.buffer.size() == 8
+                    && std::memcmp(res.buffer.data(), "recycled", 8) == 0,
+                    "read after release");
+        ok &= check(res.buffer.data() == released, "released block was recycled");
+        ok &= check(std::memcmp(held[0].data(), "datagram 0", 10) == 0,
+                    "held buffers are not overwritten");
+    }
+    ok &= check(pool->available() == 4, "all blocks back in the pool");
+
+    // end of connection is still reported with direct receives
+    {
+        ::close(peer);
+        auto res = read_borrowed(stream);
+        ok &= check(res.error == boost::asio::error::eof, "eof reported");
+    }
+
+    stream->stop();
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    return ok ? 0 : 1;
+}
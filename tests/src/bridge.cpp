@@ -0,0 +1,250 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <ctime>
+using namespace std;
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <rtac_asio/Bridge.h>
+#include <rtac_asio/UnixStream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<uint8_t> pattern(std::size_t size, unsigned int seed)
+{
+    std::vector<uint8_t> res(size);
+    for(std::size_t i = 0; i < size; i++) {
+        res[i] = (i * 13 + seed) & 0xff;
+    }
+    return res;
+}
+
+void send_all(int fd, const std::vector<uint8_t>& data, bool shutdownAfter)
+{
+    std::size_t sent = 0;
+    while(sent < data.size()) {
+        ssize_t count = ::send(fd, data.data() + sent, data.size() - sent, 0);
+        if(count <= 0) break;
+        sent += count;
+    }
+    if(shutdownAfter) {
+        ::shutdown(fd, SHUT_WR);
+    }
+}
+
+// reads until the end of stream
+std::vector<uint8_t> recv_all(int fd)
+{
+    std::vector<uint8_t> res;
+    uint8_t buf[65536];
+    while(true) {
+        ssize_t count = ::recv(fd, buf, sizeof(buf), 0);
+        if(count <= 0) break;
+        res.insert(res.end(), buf, buf + count);
+    }
+    return res;
+}
+
+// client A <-> [ bridge ] <-> client B
+struct Setup
+{
+    int clientA, clientB;
+    Bridge::Ptr bridge;
+    std::promise<Bridge::ErrorCode> closed;
+
+    Setup(AsyncService::Ptr service, const Bridge::Parameters& params)
+    {
+        int a[2], b[2];
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, a);
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, b);
+        clientA = a[0];
+        clientB = b[0];
+        bridge = Bridge::Create(UnixStream::Create(service, a[1]),
+                                UnixStream::Create(service, b[1]), params);
+        bridge->set_closed_callback([this](const Bridge::ErrorCode& err) {
+            closed.set_value(err);
+        });
+        bridge->start();
+    }
+    ~Setup() {
+        bridge->stop();
+        ::close(clientA);
+        ::close(clientB);
+    }
+};
+
+bool transfer(AsyncService::Ptr service, const std::string& name,
+              const Bridge::Parameters& params, Bridge::Mode expected)
+{
+    bool ok = true;
+    cout << "=== " << name << endl;
+    Setup setup(service, params);
+
+    // both directions at the same time, each side half-closes after sending.
+    auto forward  = pattern(16*1024*1024, 1);
+    auto backward = pattern(4*1024*1024, 2);
+    auto    t0   = Clock::now();
+    clock_t cpu0 = std::clock();
+    std::thread sendA(send_all, setup.clientA, std::cref(forward),  true);
+    std::thread sendB(send_all, setup.clientB, std::cref(backward), true);
+    auto atB = std::async(std::launch::async, recv_all, setup.clientB);
+    auto atA = std::async(std::launch::async, recv_all, setup.clientA);
+
+    bool receivedB = atB.get() == forward;
+    bool receivedA = atA.get() == backward;
+    sendA.join();
+    sendB.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+    double cpu     = double(std::clock() - cpu0) / CLOCKS_PER_SEC;
+
+    auto closed = setup.closed.get_future();
+    bool wasClosed = closed.wait_for(std::chrono::seconds(2)) == std::future_status::ready;
+
+    auto stats = setup.bridge->stats();
+    cout << (forward.size() + backward.size()) / (1024*1024) << " MB in "
+         << elapsed << " s (" << (forward.size() + backward.size()) / elapsed / 1.0e6
+         << " MB/s), process cpu " << cpu << " s (senders and receivers included), "
+         << stats.forward.transfers + stats.backward.transfers << " writes" << endl;
+
+    ok &= check(stats.forward.mode == expected && stats.backward.mode == expected,
+                "forwarding mode");
+    ok &= check(receivedB, "first to second stream data intact");
+    ok &= check(receivedA, "second to first stream data intact");
+    ok &= check(stats.forward.bytes == forward.size()
+                && stats.backward.bytes == backward.size(), "bytes counted");
+    ok &= check(wasClosed && !closed.get(), "bridge closed once both sides ended");
+    return ok;
+}
+
+bool half_close_and_backpressure(AsyncService::Ptr service, const Bridge::Parameters& params)
+{
+    bool ok = true;
+    cout << "=== backpressure and half-close" << endl;
+    Setup setup(service, params);
+
+    // B does not read : the bridge stops reading A once its chunk and the
+    // socket buffers are full.
+    ::fcntl(setup.clientA, F_SETFL, O_NONBLOCK);
+    std::vector<uint8_t> chunk(4096, 0x5a);
+    std::size_t accepted = 0;
+    auto deadline = Clock::now() + std::chrono::seconds(2);
+    while(Clock::now() < deadline) {
+        ssize_t count = ::send(setup.clientA, chunk.data(), chunk.size(), 0);
+        if(count > 0) {
+            accepted += count;
+            continue;
+        }
+        // wait a bit for the bridge to move data, stop when it does not.
+        pollfd pfd{setup.clientA, POLLOUT, 0};
+        if(::poll(&pfd, 1, 100) == 0) break;
+    }
+    cout << accepted << " bytes accepted while the destination does not read" << endl;
+    ok &= check(Clock::now() < deadline && accepted < 16*1024*1024,
+                "writer blocked by a destination which does not read");
+
+    // A half-closes : B gets all the data then the end of stream, and can
+    // still answer.
+    ::shutdown(setup.clientA, SHUT_WR);
+    auto received = recv_all(setup.clientB);
+    ok &= check(received.size() == accepted, "pending bytes forwarded before the end of stream");
+    ok &= check(setup.bridge->is_open(), "bridge open while one direction is still alive");
+
+    std::vector<uint8_t> answer = pattern(1000, 3);
+    send_all(setup.clientB, answer, false);
+    ::fcntl(setup.clientA, F_SETFL, 0);
+    std::vector<uint8_t> got(answer.size());
+    std::size_t n = 0;
+    while(n < got.size()) {
+        ssize_t count = ::recv(setup.clientA, got.data() + n, got.size() - n, 0);
+        if(count <= 0) break;
+        n += count;
+    }
+    ok &= check(got == answer, "other direction still forwarding after the half-close");
+
+    // the peer closes the second side : the bridge ends.
+    ::shutdown(setup.clientB, SHUT_WR);
+    auto closed = setup.closed.get_future();
+    ok &= check(closed.wait_for(std::chrono::seconds(2)) == std::future_status::ready
+                && !closed.get(), "bridge closed after both half-closes");
+    return ok;
+}
+
+bool peer_reset(AsyncService::Ptr service, const Bridge::Parameters& params)
+{
+    cout << "=== peer closes" << endl;
+    Setup setup(service, params);
+    // B disappears while A is still sending : the bridge closes with an
+    // error (and the process is not killed by SIGPIPE).
+    ::close(setup.clientB);
+    setup.clientB = ::socket(AF_UNIX, SOCK_STREAM, 0); // closed by ~Setup
+    std::vector<uint8_t> data = pattern(1024*1024, 4);
+    std::thread sender([&]() {
+        ::fcntl(setup.clientA, F_SETFL, O_NONBLOCK);
+        std::size_t sent = 0;
+        auto deadline = Clock::now() + std::chrono::seconds(1);
+        while(sent < data.size() && Clock::now() < deadline) {
+            ssize_t count = ::send(setup.clientA, data.data() + sent,
+                                   data.size() - sent, MSG_NOSIGNAL);
+            if(count > 0) sent += count;
+            else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    auto closed = setup.closed.get_future();
+    bool ended = closed.wait_for(std::chrono::seconds(2)) == std::future_status::ready;
+    sender.join();
+    return check(ended && closed.get(), "bridge closed with an error when a peer disappears");
+}
+
+int main()
+{
+    bool ok = true;
+    auto service = AsyncService::Create();
+    service->start();
+
+    ok &= transfer(service, "splice", Bridge::Parameters(), Bridge::Splice);
+    ok &= transfer(service, "buffered", Bridge::Parameters(65536, false), Bridge::Buffered);
+    ok &= half_close_and_backpressure(service, Bridge::Parameters());
+    ok &= half_close_and_backpressure(service, Bridge::Parameters(65536, false));
+    ok &= peer_reset(service, Bridge::Parameters());
+    ok &= peer_reset(service, Bridge::Parameters(65536, false));
+
+    service->stop();
+    cout << (ok ? "All tests passed" : "Some tests failed") << endl;
+    return ok ? 0 : 1;
+}
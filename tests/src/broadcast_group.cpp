@@ -0,0 +1,200 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+using namespace std;
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rtac_asio/BroadcastGroup.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+const std::size_t FrameSize  = 1024;
+const std::size_t FrameCount = 1000;
+const std::size_t FastCount  = 4;
+
+// A group member and the peer socket of its client.
+struct Client
+{
+    int                      fds[2];
+    Stream::Ptr              stream;
+    std::thread              drain;
+    std::atomic<bool>        stop;
+    std::vector<uint8_t>     received;
+    std::atomic<std::size_t> receivedCount;
+
+    Client(AsyncService::Ptr service, bool reading) : stop(false), receivedCount(0)
+    {
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        if(!reading) {
+            int small = 1;
+            ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+            ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+        }
+        stream = Stream::Create(UnixStream::Create(service, fds[0]));
+        drain = std::thread([this, reading]() {
+            uint8_t buf[8192];
+            while(!stop) {
+                ssize_t count = reading ? ::recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT) : 0;
+                if(count > 0) {
+                    received.insert(received.end(), buf, buf + count);
+                    receivedCount += count;
+                }
+                else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            }
+        });
+    }
+    ~Client() {
+        stop = true;
+        drain.join();
+        ::close(fds[1]);
+    }
+};
+
+std::vector<uint8_t> frame_data(std::size_t index)
+{
+    std::vector<uint8_t> res(FrameSize);
+    for(std::size_t i = 0; i < FrameSize; i++) {
+        res[i] = (index + i) & 0xff;
+    }
+    return res;
+}
+
+bool run(const std::string& name, BroadcastGroup::SlowPolicy policy)
+{
+    bool ok = true;
+    cout << "=== " << name << endl;
+
+    auto service = AsyncService::Create();
+    auto group   = BroadcastGroup::Create(service,
+                        BroadcastGroup::Parameters(policy, 16));
+
+    std::vector<std::unique_ptr<Client>> clients;
+    for(std::size_t i = 0; i < FastCount; i++) {
+        clients.emplace_back(new Client(service, true));
+    }
+    // this client never reads
+    clients.emplace_back(new Client(service, false));
+    for(auto& c : clients) {
+        group->add(c->stream);
+    }
+    clients[0]->stream->start();
+
+    std::atomic<int> removed(0);
+    group->set_removed_callback([&](Stream::Ptr, const StreamInterface::ErrorCode&) {
+        removed++;
+    });
+
+    std::atomic<std::size_t> completed(0), fastDelivered(0);
+    std::vector<BroadcastGroup::Buffer> buffers;
+    auto t0 = Clock::now();
+    for(std::size_t i = 0; i < FrameCount; i++) {
+        auto buffer = BroadcastGroup::make_buffer(frame_data(i));
+        if(i == 0) buffers.push_back(buffer);
+        group->broadcast(buffer, [&](const BroadcastGroup::Result& res) {
+            completed++;
+            if(res.delivered >= FastCount) fastDelivered++;
+        });
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(Clock::now() < deadline) {
+        bool done = true;
+        for(std::size_t i = 0; i < FastCount; i++) {
+            done &= clients[i]->receivedCount >= FrameCount*FrameSize;
+        }
+        if(done) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto stats = group->stats();
+    cout << FrameCount << " frames broadcast in " << elapsed << " ms, "
+         << stats.delivered << " delivered, " << stats.dropped << " dropped, "
+         << stats.failed << " failed, " << stats.disconnected << " disconnected, "
+         << completed << " frames completed" << endl;
+
+    bool intact = true;
+    for(std::size_t i = 0; i < FastCount; i++) {
+        auto& received = clients[i]->received;
+        intact &= received.size() == FrameCount*FrameSize;
+        for(std::size_t f = 0; intact && f < FrameCount; f++) {
+            intact &= std::equal(received.begin() + f*FrameSize,
+                                 received.begin() + (f + 1)*FrameSize,
+                                 frame_data(f).begin());
+        }
+    }
+    ok &= check(intact, "fast members received every frame in order");
+    ok &= check(fastDelivered == completed, "fast members delivered every completed frame");
+    ok &= check(stats.dropped > 0, "frames skipped for the slow member");
+
+    switch(policy) {
+        case BroadcastGroup::Disconnect:
+            ok &= check(group->size() == FastCount && removed == 1
+                        && stats.disconnected == 1, "slow member disconnected");
+            ok &= check(completed == FrameCount, "every frame completed");
+            ok &= check(buffers[0].use_count() == 1, "frame buffers released");
+            ok &= check(!clients.back()->stream->is_open(), "slow member closed, not reconnected");
+            break;
+        default:
+            // the frames of the slow member stay queued while it is stalled.
+            ok &= check(group->size() == FastCount + 1 && removed == 0,
+                        "slow member kept in the group");
+            group->remove(clients.back()->stream);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ok &= check(completed + 1 >= FrameCount,
+                        "frames completed once the slow member is removed");
+            break;
+    }
+
+    clients[0]->stream->stop();
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= run("Drop",       BroadcastGroup::Drop);
+    ok &= run("DropOldest", BroadcastGroup::DropOldest);
+    ok &= run("Disconnect", BroadcastGroup::Disconnect);
+
+    cout << (ok ? "All tests passed" : "Some tests failed") << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+// Buffers of the streams are taken from the BufferPool of their service. Once
+// the traffic pattern was seen once, the pool does not grow anymore.
+
+void print_stats(const std::string& label, const BufferPool::Stats& stats)
+{
+    cout << label << " : arena " << stats.arenaUsed << "/" << stats.arenaSize
+         << " bytes, heap " << stats.heapBytes << " bytes, "
+         << stats.inUse << " blocks in use, " << stats.unpooled << " unpooled"
+         << (stats.hugePages ? ", huge pages" : "")
+         << (stats.locked    ? ", locked"     : "") << endl;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // blocks are recycled by size class
+    {
+        auto pool = BufferPool::Create();
+        void* a = pool->allocate(100);
+        ok &= check(pool->capacity(100) == 128, "size rounded up to the class size");
+        pool->deallocate(a, 100);
+        void* b = pool->allocate(120);
+        ok &= check(a == b, "released block reused by the same class");
+        pool->deallocate(b, 120);
+
+        // blocks released from another thread go back to the pool when the
+        // thread exits.
+        std::vector<void*> blocks;
+        for(int i = 0; i < 32; i++) blocks.push_back(pool->allocate(4096));
+        std::thread([&]() {
+            for(auto block : blocks) pool->deallocate(block, 4096);
+        }).join();
+        auto heap = pool->stats().heapBytes;
+        for(int i = 0; i < 32; i++) blocks[i] = pool->allocate(4096);
+        ok &= check(pool->stats().heapBytes == heap,
+                    "blocks released by an exited thread are reused");
+        for(auto block : blocks) pool->deallocate(block, 4096);
+        ok &= check(pool->stats().inUse == 0, "all blocks released");
+    }
+
+    // arena, huge pages and mlock (best effort)
+    {
+        auto pool = BufferPool::Create(BufferPool::Parameters::RealTime(4*1024*1024));
+        print_stats("Real-time pool", pool->stats());
+        ok &= check(pool->stats().arenaSize >= 4*1024*1024, "arena reserved");
+        void* block = pool->allocate(65536);
+        ok &= check(pool->stats().arenaUsed == 65536 && pool->stats().heapBytes == 0,
+                    "block carved in the arena");
+        pool->deallocate(block, 65536);
+    }
+
+    // stream traffic
+    std::string path = "/tmp/rtac_asio_buffer_pool.sock";
+    ::unlink(path.c_str());
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    int listenFd = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    ::bind(listenFd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(listenFd, 1);
+
+    {
+        auto service = AsyncService::Create(BufferPool::Parameters(64, 1024*1024,
+                                                                   2*1024*1024));
+        auto stream = Stream::Create(UnixDatagramStream::Create(service, path));
+        int peer = ::accept(listenFd, nullptr, nullptr);
+        stream->enable_io_dump("/tmp/rtac_asio_buffer_pool_rx.dump",
+                               "/tmp/rtac_asio_buffer_pool_tx.dump");
+        stream->start();
+        auto& pool = service->buffer_pool();
+        print_stats("After creation", pool.stats());
+
+        auto exchange = [&]() {
+            bool res = true;
+            uint8_t data[256];
+            std::string lines = "first line\nsecond line\n";
+            ::send(peer, lines.c_str(), lines.size(), 0);
+            for(int i = 0; i < 2; i++) {
+                std::size_t count = stream->read_until(sizeof(data), data, '\n', 1000);
+                res &= count > 0 && data[count - 1] == '\n';
+            }
+            res &= stream->write(6, (const uint8_t*)"reply\n", 1000) == 6;
+            char reply[16];
+            res &= ::recv(peer, reply, sizeof(reply), 0) == 6;
+            return res;
+        };
+
+        bool exchanged = true;
+        for(int i = 0; i < 100; i++) {
+            exchanged &= exchange(); // warm-up
+        }
+        auto warm = pool.stats();
+        print_stats("After warm-up ", warm);
+        for(int i = 0; i < 1000; i++) {
+            exchanged &= exchange();
+        }
+        auto after = pool.stats();
+        print_stats("After 1000 exchanges", after);
+        ok &= check(exchanged, "exchanges ok");
+        ok &= check(after.arenaUsed == warm.arenaUsed && after.heapBytes == warm.heapBytes,
+                    "pool did not grow after warm-up");
+        ok &= check(after.heapBytes == 0, "all buffers taken from the arena");
+
+        stream->stop();
+        ::close(peer);
+    }
+
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    ::unlink("/tmp/rtac_asio_buffer_pool_rx.dump");
+    ::unlink("/tmp/rtac_asio_buffer_pool_tx.dump");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+using namespace std;
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rtac_asio/ChannelMux.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+std::vector<uint8_t> pattern(std::size_t size, unsigned int seed)
+{
+    std::vector<uint8_t> res(size);
+    for(std::size_t i = 0; i < size; i++) {
+        res[i] = (i * 7 + seed) & 0xff;
+    }
+    return res;
+}
+
+int main()
+{
+    bool ok = true;
+
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    auto service = AsyncService::Create();
+    auto left    = Stream::Create(UnixStream::Create(service, fds[0]));
+    auto right   = Stream::Create(UnixStream::Create(service, fds[1]));
+    left->start();
+
+    const std::size_t window = 8192;
+    ChannelMux::Parameters params(window, 512);
+    auto leftMux  = ChannelMux::Create(left,  params);
+    auto rightMux = ChannelMux::Create(right, params);
+
+    // control is urgent, logs and data are bulk traffic.
+    auto leftControl  = Stream::Create(leftMux->open_channel(0, 0));
+    auto leftLogs     = Stream::Create(leftMux->open_channel(1, 1));
+    auto leftData     = Stream::Create(leftMux->open_channel(2, 1));
+    auto rightControl = Stream::Create(rightMux->open_channel(0, 0));
+    auto rightLogs    = Stream::Create(rightMux->open_channel(1, 1));
+    auto rightData    = Stream::Create(rightMux->open_channel(2, 1));
+    leftMux->start();
+    rightMux->start();
+
+    char line[64];
+    std::size_t count;
+
+    leftControl->write(6, (const uint8_t*)"hello\n", 1000);
+    count = rightControl->read_until(sizeof(line), (uint8_t*)line, '\n', 1000);
+    ok &= check(std::string(line, count) == "hello\n", "message on a channel");
+
+    // Bulk logs which the remote end does not read yet.
+    auto logs = pattern(64*1024, 1);
+    std::promise<std::size_t> logsWritten;
+    leftLogs->async_write(logs.size(), logs.data(),
+        [&](const Stream::ErrorCode&, std::size_t count) { logsWritten.set_value(count); },
+        5000);
+
+    // Control messages are not blocked by the logs.
+    bool controlOk = true;
+    for(int i = 0; i < 20; i++) {
+        std::string msg = "command " + std::to_string(i) + "\n";
+        leftControl->write(msg.size(), (const uint8_t*)msg.c_str(), 1000);
+        count = rightControl->read_until(sizeof(line), (uint8_t*)line, '\n', 1000);
+        controlOk &= std::string(line, count) == msg;
+    }
+    ok &= check(controlOk, "control messages delivered during bulk transfer");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto rightStats = rightMux->stats();
+    ok &= check(rightStats.bytesIn < window + 1024,
+                "unread channel limited to its window");
+    ok &= check(rightStats.overruns == 0, "window respected by the sender");
+
+    // Logs and data (same priority) interleaved.
+    auto data = pattern(32*1024, 2);
+    std::promise<std::size_t> dataWritten;
+    leftData->async_write(data.size(), data.data(),
+        [&](const Stream::ErrorCode&, std::size_t count) { dataWritten.set_value(count); },
+        5000);
+
+    std::vector<uint8_t> logsIn(logs.size()), dataIn(data.size());
+    std::thread dataReader([&]() {
+        count = rightData->read(dataIn.size(), dataIn.data(), 5000);
+    });
+    std::size_t logsCount = rightLogs->read(logsIn.size(), logsIn.data(), 5000);
+    dataReader.join();
+
+    ok &= check(logsCount == logs.size() && logsIn == logs, "logs received intact");
+    ok &= check(count == data.size() && dataIn == data, "data received intact");
+    ok &= check(logsWritten.get_future().get() == logs.size()
+                && dataWritten.get_future().get() == data.size(),
+                "bulk writes completed");
+
+    auto leftStats = leftMux->stats();
+    cout << "left  : " << leftStats.framesOut << " frames, "
+         << leftStats.bytesOut << " bytes out" << endl;
+    cout << "right : " << rightMux->stats().framesIn << " frames, "
+         << rightMux->stats().bytesIn << " bytes in" << endl;
+
+    // stop() ends the pending channel reads and the transport read, the
+    // transport itself stays open.
+    std::promise<Stream::ErrorCode> aborted;
+    rightLogs->async_read_some(sizeof(line), (uint8_t*)line,
+        [&](const Stream::ErrorCode& err, std::size_t) { aborted.set_value(err); });
+    rightMux->stop();
+    auto abortedFuture = aborted.get_future();
+    ok &= check(abortedFuture.wait_for(std::chrono::seconds(1)) == std::future_status::ready
+                && abortedFuture.get() == boost::asio::error::operation_aborted
+                && !rightLogs->is_open() && right->is_open(),
+                "stop ends the channel operations");
+
+    // The transport read in progress does not keep the mux alive.
+    std::weak_ptr<ChannelMux> leftWeak = leftMux;
+    leftMux = nullptr;
+    std::promise<Stream::ErrorCode> closed;
+    leftControl->async_write(6, (const uint8_t*)"hello\n",
+        [&](const Stream::ErrorCode& err, std::size_t) { closed.set_value(err); });
+    ok &= check(leftWeak.expired()
+                && closed.get_future().get() == boost::asio::error::bad_descriptor,
+                "released mux closes its channels");
+
+    left->stop();
+    return ok ? 0 : 1;
+}
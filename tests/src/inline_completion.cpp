@@ -0,0 +1,128 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <string>
+using namespace std;
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+// Reads lines with async_read_until, re-arming from the callback. Lines
+// already in the leftovers complete synchronously inside async_read_until.
+struct LineReader
+{
+    Stream::Ptr        stream;
+    unsigned int       expected;
+    unsigned int       received = 0;
+    unsigned int       depth    = 0;
+    unsigned int       maxDepth = 0;
+    bool               offThread = false;
+    char               line[64];
+    std::promise<void> done;
+
+    void start() {
+        stream->async_read_until(sizeof(line), (uint8_t*)line, '\n',
+            std::bind(&LineReader::callback, this,
+                      std::placeholders::_1, std::placeholders::_2), 1000);
+    }
+    void callback(const Stream::ErrorCode& err, std::size_t count) {
+        depth++;
+        maxDepth = std::max(maxDepth, depth);
+        if(!stream->service()->service().get_executor().running_in_this_thread()) {
+            offThread = true;
+        }
+        if(err || count == 0) {
+            done.set_value();
+        }
+        else if(++received == expected) {
+            done.set_value();
+        }
+        else {
+            this->start();
+        }
+        depth--;
+    }
+};
+
+int main()
+{
+    bool ok = true;
+
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    auto service = AsyncService::Create();
+    auto stream  = Stream::Create(UnixStream::Create(service, fds[0]));
+    stream->start();
+    stream->set_inline_completion(true);
+    service->set_max_inline_depth(4);
+
+    // 1000 short lines in a single chunk : after the first read, all the
+    // lines are in the leftovers and would complete recursively.
+    const unsigned int lineCount = 1000;
+    std::string lines;
+    for(unsigned int i = 0; i < lineCount; i++) {
+        lines += "line " + std::to_string(i) + "\n";
+    }
+    ::send(fds[1], lines.c_str(), lines.size(), 0);
+
+    LineReader reader;
+    reader.stream   = stream;
+    reader.expected = lineCount;
+    // started from the service thread to be inlined from the start
+    service->post(std::bind(&LineReader::start, &reader));
+    auto status = reader.done.get_future().wait_for(std::chrono::seconds(5));
+
+    ok &= check(status == std::future_status::ready && reader.received == lineCount,
+                "all lines received");
+    ok &= check(std::string(reader.line, 9) == "line 999\n", "last line content");
+    ok &= check(!reader.offThread, "callbacks called on the service thread");
+    cout << "max nesting depth : " << reader.maxDepth << endl;
+    ok &= check(reader.maxDepth >= 2 && reader.maxDepth <= 5,
+                "inline recursion bounded by max_inline_depth");
+
+    // Outside the service thread, callbacks are still posted.
+    std::promise<std::thread::id> caller;
+    ::send(fds[1], "x", 1, 0);
+    uint8_t byte;
+    stream->async_read(1, &byte, [&](const Stream::ErrorCode&, std::size_t) {
+        caller.set_value(std::this_thread::get_id());
+    }, 1000);
+    ok &= check(caller.get_future().get() != std::this_thread::get_id(),
+                "callback not called from the caller thread");
+
+    stream->stop();
+    ::close(fds[1]);
+    return ok ? 0 : 1;
+}
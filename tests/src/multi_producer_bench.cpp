@@ -0,0 +1,136 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+using namespace std;
+using namespace std::placeholders;
+
+#include <rtac_asio/Stream.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Transport completing all operations right away from the service thread.
+ * Only the cost of the StreamReader / StreamWriter machinery is measured.
+ */
+class DummyStream : public StreamInterface
+{
+    public:
+
+    using Ptr = std::shared_ptr<DummyStream>;
+
+    protected:
+
+    DummyStream(AsyncService::Ptr service) : StreamInterface(service) {}
+
+    public:
+
+    static Ptr Create(AsyncService::Ptr service) { return Ptr(new DummyStream(service)); }
+
+    void flush() {}
+    void reset() {}
+
+    void async_read_some(std::size_t bufferSize, uint8_t* /*buffer*/, Callback callback) {
+        service_->post(std::bind(callback, ErrorCode(), bufferSize));
+    }
+    void async_write_some(std::size_t count, const uint8_t* /*data*/, Callback callback) {
+        service_->post(std::bind(callback, ErrorCode(), count));
+    }
+};
+
+/**
+ * Several threads write on the same Stream. A thread retries until its
+ * write is accepted (the writer handles one operation at a time).
+ */
+void producers(unsigned int threadCount, unsigned int writesPerThread)
+{
+    auto stream = Stream::Create(DummyStream::Create(AsyncService::Create()));
+    stream->start();
+
+    std::atomic<unsigned long> completed(0), rejected(0);
+    std::vector<std::thread> threads;
+    auto t0 = Clock::now();
+    for(unsigned int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&]() {
+            uint8_t data[64];
+            for(unsigned int i = 0; i < writesPerThread; i++) {
+                while(!stream->async_write(sizeof(data), data,
+                    [&](const Stream::ErrorCode&, std::size_t) { completed++; }))
+                {
+                    rejected++;
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(auto& t : threads) t.join();
+    while(completed.load() < (unsigned long)threadCount * writesPerThread) {
+        std::this_thread::yield();
+    }
+    double elapsed = 1.0e-6*std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - t0).count();
+    stream->stop();
+
+    cout << setw(2) << threadCount << " producers : "
+         << setw(9) << (unsigned long)(completed / elapsed) << " writes/s, "
+         << setw(6) << setprecision(1) << fixed
+         << (double)rejected / completed << " busy rejections per write" << endl;
+}
+
+// Single thread, synchronous reads : cost of one operation without contention.
+void sync_reads(unsigned int count)
+{
+    auto stream = Stream::Create(DummyStream::Create(AsyncService::Create()));
+    stream->start();
+    uint8_t data[64];
+    auto t0 = Clock::now();
+    for(unsigned int i = 0; i < count; i++) {
+        stream->read(sizeof(data), data, 1000);
+    }
+    double elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - t0).count();
+    stream->stop();
+    cout << "sync read with timeout : " << setprecision(2) << elapsed / count / 1000.0
+         << "us per read" << endl;
+}
+
+int main()
+{
+    sync_reads(50000);
+    for(unsigned int threads : {1, 2, 4, 8}) {
+        producers(threads, 50000 / threads);
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+using namespace std;
+using namespace std::placeholders;
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+// Sends totalSize bytes of a known pattern to the first client.
+void sender(int listenFd, std::size_t totalSize)
+{
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    std::vector<uint8_t> chunk(256*1024);
+    std::size_t sent = 0;
+    while(sent < totalSize) {
+        std::size_t count = std::min(chunk.size(), totalSize - sent);
+        for(std::size_t i = 0; i < count; i++) {
+            chunk[i] = (sent + i) % 251;
+        }
+        ssize_t res = ::send(fd, chunk.data(), count, MSG_NOSIGNAL);
+        if(res <= 0) break;
+        sent += res;
+        if((std::size_t)res < count) {
+            // partial send : the pattern is regenerated from the new offset
+            continue;
+        }
+    }
+    ::close(fd);
+}
+
+int tcp_server(uint16_t& port)
+{
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ::bind(fd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(fd, 1);
+    socklen_t size = sizeof(addr);
+    ::getsockname(fd, (sockaddr*)&addr, &size);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+/**
+ * Receives the whole stream, each read being followed by some processing
+ * (checking the pattern). With one read in flight, the socket is not read
+ * during the processing. With queued reads, the internal read loop keeps
+ * reading in the meantime.
+ */
+struct Receiver
+{
+    Stream::Ptr                       stream;
+    std::vector<std::vector<uint8_t>> buffers;
+    std::size_t                       received;
+    std::size_t                       totalSize;
+    bool                              corrupted;
+    bool                              done;
+    std::mutex                        mutex;
+    std::condition_variable           waiter;
+
+    void read(std::size_t index) {
+        stream->async_read_some(buffers[index].size(), buffers[index].data(),
+            std::bind(&Receiver::read_callback, this, index, _1, _2));
+    }
+
+    void read_callback(std::size_t index, const Stream::ErrorCode& err,
+                       std::size_t count) {
+        const uint8_t* data = buffers[index].data();
+        for(std::size_t i = 0; i < count; i++) {
+            if(data[i] != (received + i) % 251) {
+                corrupted = true;
+                break;
+            }
+        }
+        received += count;
+        if(err || corrupted || received >= totalSize) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            waiter.notify_all();
+            return;
+        }
+        this->read(index);
+    }
+};
+
+bool run(const std::string& name, std::size_t totalSize,
+         std::size_t readSize, std::size_t queued)
+{
+    uint16_t port;
+    int listenFd = tcp_server(port);
+    std::thread server(std::bind(&sender, listenFd, totalSize));
+
+    Receiver receiver;
+    receiver.stream    = Stream::CreateTCPClient("127.0.0.1", port);
+    receiver.received  = 0;
+    receiver.totalSize = totalSize;
+    receiver.corrupted = false;
+    receiver.done      = false;
+    receiver.buffers.resize(queued, std::vector<uint8_t>(readSize));
+    if(queued > 1) {
+        receiver.stream->enable_queued_reads(queued, 4*1024*1024);
+    }
+    receiver.stream->start();
+
+    auto t0 = Clock::now();
+    for(std::size_t i = 0; i < queued; i++) {
+        receiver.read(i);
+    }
+    {
+        std::unique_lock<std::mutex> lock(receiver.mutex);
+        receiver.waiter.wait(lock, [&]{ return receiver.done; });
+    }
+    double elapsed = 1.0e-6*std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - t0).count();
+
+    receiver.stream->stop();
+    server.join();
+    ::close(listenFd);
+
+    cout << setw(28) << left << name << right << " : "
+         << setw(8) << fixed << setprecision(1)
+         << receiver.received / elapsed / 1.0e6 << " MB/s" << endl;
+    if(receiver.corrupted || receiver.received != totalSize) {
+        cerr << "Data was corrupted or incomplete ("
+             << receiver.received << " bytes)" << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t totalSize = 512*1024*1024;
+    if(argc > 1) totalSize = std::stoul(argv[1]);
+
+    bool ok = true;
+    for(int i = 0; i < 2; i++) {
+        ok &= run("single read in flight",  totalSize, 65536, 1);
+        ok &= run("queued reads (4 x 64kB)", totalSize, 65536, 4);
+        ok &= run("queued reads (16 x 16kB)", totalSize, 16384, 16);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+using namespace std;
+using namespace std::placeholders;
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+using namespace rtac::asio;
+
+// Silence delimited frames (Modbus RTU style) read on a pseudo terminal.
+
+using Clock = std::chrono::steady_clock;
+
+struct FrameReader
+{
+    Stream::Ptr              stream;
+    std::vector<uint8_t>     buffer;
+    std::vector<std::string> frames;
+    std::vector<Clock::time_point> stamps;
+    std::mutex               mutex;
+    std::condition_variable  done;
+    std::size_t              expected;
+
+    void read() {
+        stream->async_read_frame(buffer.size(), buffer.data(),
+                                 std::bind(&FrameReader::frame_received, this, _1, _2));
+    }
+
+    void frame_received(const Stream::ErrorCode& err, std::size_t count) {
+        if(err) {
+            cerr << "Error on frame read : " << err.message() << endl;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frames.push_back(std::string((const char*)buffer.data(), count));
+            stamps.push_back(Clock::now());
+            if(frames.size() >= expected) {
+                done.notify_all();
+                return;
+            }
+        }
+        this->read();
+    }
+};
+
+int main()
+{
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || ::grantpt(master) != 0 || ::unlockpt(master) != 0) {
+        cerr << "Could not open a pseudo terminal." << endl;
+        return 1;
+    }
+
+    // 9600 bauds, 8N1 : 3.5 character times = 3646us
+    SerialStream::Parameters params(9600);
+    params.rawMode = true;
+    auto serial = SerialStream::Create(AsyncService::Create(), ::ptsname(master), params);
+    cout << "Frame gap : " << serial->frame_gap_micros() << "us" << endl;
+    if(serial->frame_gap_micros() != 3646) {
+        cerr << "Wrong frame gap." << endl;
+        return 1;
+    }
+
+    FrameReader reader;
+    reader.stream   = Stream::Create(serial);
+    reader.buffer.resize(256);
+    reader.expected = 3;
+    reader.stream->start();
+    reader.read();
+
+    // Each frame is written in several chunks separated by less than the gap.
+    std::vector<std::vector<std::string>> frames = {
+        {"\x01\x03", "\x01\x10\x02", "\x02\xc5\xce"},
+        {"\x11\x06\x01\x01", "\x04\x03\x9a\x9b"},
+        {"single chunk frame"}
+    };
+    std::vector<Clock::time_point> lastWrites;
+    for(const auto& frame : frames) {
+        Clock::time_point last;
+        for(const auto& chunk : frame) {
+            if(::write(master, chunk.c_str(), chunk.size()) != (ssize_t)chunk.size()) {
+                return 1;
+            }
+            last = Clock::now();
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        lastWrites.push_back(last);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(reader.mutex);
+        reader.done.wait_for(lock, std::chrono::seconds(2),
+                             [&]{ return reader.frames.size() >= reader.expected; });
+        if(reader.frames.size() != frames.size()) {
+            cerr << "Expected " << frames.size() << " frames, got "
+                 << reader.frames.size() << endl;
+            return 1;
+        }
+        for(std::size_t i = 0; i < frames.size(); i++) {
+            std::string expected;
+            for(const auto& chunk : frames[i]) expected += chunk;
+            auto delay = std::chrono::duration_cast<std::chrono::microseconds>(
+                reader.stamps[i] - lastWrites[i]).count();
+            cout << "Frame " << i << " : " << reader.frames[i].size()
+                 << " bytes, delivered " << delay << "us after its last chunk"
+                 << endl;
+            if(reader.frames[i] != expected) {
+                cerr << "Wrong frame content." << endl;
+                return 1;
+            }
+        }
+    }
+
+    // synchronous version with an explicit gap
+    std::string msg = "sync frame";
+    ::write(master, msg.c_str(), msg.size());
+    std::vector<uint8_t> buffer(256);
+    auto count = reader.stream->read_frame(buffer.size(), buffer.data(), 1000, 2000);
+    cout << "Sync frame : '" << std::string((const char*)buffer.data(), count)
+         << "'" << endl;
+    if(std::string((const char*)buffer.data(), count) != msg) {
+        return 1;
+    }
+
+    ::close(master);
+    return 0;
+}
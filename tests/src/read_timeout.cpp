@@ -0,0 +1,153 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+// Timeouts are reported as timed_out and cancel the operation on the stream.
+
+struct Result {
+    Stream::ErrorCode error;
+    std::size_t       count;
+};
+
+int main()
+{
+    std::string path = "/tmp/rtac_asio_read_timeout.sock";
+    ::unlink(path.c_str());
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::bind(listenFd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(listenFd, 1);
+
+    auto stream = Stream::CreateUnix(path);
+    int peer = ::accept(listenFd, nullptr, nullptr);
+    stream->start();
+
+    bool ok = true;
+    uint8_t first[16], second[16];
+    std::memset(first, 0, sizeof(first));
+
+    // silent peer
+    {
+        std::promise<Result> promise;
+        auto t0 = Clock::now();
+        stream->async_read(sizeof(first), first,
+            [&](const Stream::ErrorCode& err, std::size_t count) {
+                promise.set_value(Result{err, count});
+            }, 100);
+        auto res = promise.get_future().get();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            Clock::now() - t0).count();
+        cout << "Timed out after " << elapsed << "ms : " << res.error.message() << endl;
+        ok &= check(res.error == boost::asio::error::timed_out, "timeout reported as timed_out");
+        ok &= check(res.count == 0, "nothing read");
+    }
+
+    // data sent after the timeout goes to the next read, not the first buffer.
+    {
+        ::send(peer, "late data", 9, 0);
+        std::memset(second, 0, sizeof(second));
+        auto count = stream->read(9, second, 1000);
+        ok &= check(count == 9 && std::memcmp(second, "late data", 9) == 0,
+                    "data after a timeout is received by the next read");
+        ok &= check(first[0] == 0, "timed out buffer left untouched");
+    }
+
+    // partial read
+    {
+        ::send(peer, "12345", 5, 0);
+        std::promise<Result> promise;
+        stream->async_read(10, first,
+            [&](const Stream::ErrorCode& err, std::size_t count) {
+                promise.set_value(Result{err, count});
+            }, 100);
+        auto res = promise.get_future().get();
+        ok &= check(res.error == boost::asio::error::timed_out && res.count == 5,
+                    "partial read reports timed_out and the received count");
+    }
+
+    // A write timing out cancels the whole stream. The pending read which did
+    // not time out must continue.
+    {
+        std::promise<Result> readPromise;
+        stream->async_read(4, second,
+            [&](const Stream::ErrorCode& err, std::size_t count) {
+                readPromise.set_value(Result{err, count});
+            });
+
+        // the peer does not read : the write blocks when socket buffers are full
+        std::vector<uint8_t> data(16*1024*1024);
+        std::promise<Result> writePromise;
+        stream->async_write(data.size(), data.data(),
+            [&](const Stream::ErrorCode& err, std::size_t count) {
+                writePromise.set_value(Result{err, count});
+            }, 100);
+        auto wres = writePromise.get_future().get();
+        cout << "Write : " << wres.error.message() << ", " << wres.count
+             << " bytes written" << endl;
+        ok &= check(wres.error == boost::asio::error::timed_out
+                    && wres.count < data.size(), "write timeout reported as timed_out");
+
+        ::send(peer, "ping", 4, 0);
+        auto readFuture = readPromise.get_future();
+        bool completed = readFuture.wait_for(std::chrono::seconds(1))
+                      == std::future_status::ready;
+        ok &= check(completed, "read survived the cancellation of the write");
+        if(completed) {
+            auto res = readFuture.get();
+            ok &= check(!res.error && res.count == 4
+                        && std::memcmp(second, "ping", 4) == 0, "read data ok");
+        }
+    }
+
+    stream->stop();
+    ::close(peer);
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    return ok ? 0 : 1;
+}
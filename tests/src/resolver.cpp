@@ -0,0 +1,130 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <future>
+using namespace std;
+
+#include <rtac_asio/ip_utils.h>
+#include <rtac_asio/TCPServer.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+// These checks only rely on /etc/hosts and numeric addresses (no network).
+
+bool resolve(Resolver::Ptr resolver, AsyncService::Ptr service,
+             const std::string& host, Resolver::AddressList& addresses)
+{
+    std::promise<Resolver::ErrorCode> done;
+    auto t0 = Clock::now();
+    resolver->async_resolve(service, host,
+        [&](const Resolver::ErrorCode& err, const Resolver::AddressList& res) {
+            addresses = res;
+            done.set_value(err);
+        });
+    auto err = done.get_future().get();
+    cout << "Resolved '" << host << "' in "
+         << std::chrono::duration<double, std::micro>(Clock::now() - t0).count()
+         << " us : '" << err.message() << "'";
+    for(auto& a : addresses) cout << " " << a;
+    cout << endl;
+    return !err;
+}
+
+int main()
+{
+    auto service = AsyncService::Create();
+    service->start();
+
+    auto resolver = Resolver::Create(200);
+    Resolver::AddressList addresses;
+
+    if(!resolver->lookup("127.0.0.1", addresses) || !resolver->lookup("::1", addresses)) {
+        cerr << "Numeric addresses must not need a lookup." << endl;
+        return 1;
+    }
+    if(resolver->lookup("localhost", addresses)) {
+        cerr << "localhost should not be in cache yet." << endl;
+        return 1;
+    }
+    if(!resolve(resolver, service, "localhost", addresses)) {
+        return 1;
+    }
+    if(!resolver->lookup("localhost", addresses)) {
+        cerr << "localhost should be in cache." << endl;
+        return 1;
+    }
+    resolve(resolver, service, "localhost", addresses); // from cache
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    if(resolver->lookup("localhost", addresses)) {
+        cerr << "localhost cache entry should have expired." << endl;
+        return 1;
+    }
+
+    // The lookup does not depend on the service of the first caller : a
+    // caller on a stopped service must not block the others.
+    {
+        auto stopped = AsyncService::Create();
+        resolver->async_resolve(stopped, "localhost",
+            [](const Resolver::ErrorCode&, const Resolver::AddressList&) {});
+        std::promise<Resolver::ErrorCode> done;
+        resolver->async_resolve(service, "localhost",
+            [&](const Resolver::ErrorCode& err, const Resolver::AddressList&) {
+                done.set_value(err);
+            });
+        auto future = done.get_future();
+        if(future.wait_for(std::chrono::seconds(5)) != std::future_status::ready
+           || future.get())
+        {
+            cerr << "Lookup blocked by the stopped service of another caller." << endl;
+            return 1;
+        }
+        cout << "Lookup shared with a stopped service completed." << endl;
+    }
+
+    // Connecting through a host name.
+    auto server = TCPServer::Create(service, "127.0.0.1", 0);
+    server->start([](Stream::Ptr) {});
+
+    auto client = TCPClientStream::Create(service, "localhost", server->local().port());
+    for(int i = 0; i < 100 && !client->is_connected(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    cout << "Client connected to " << client->host() << " (" << client->remote() << ")" << endl;
+    if(!client->is_connected()) {
+        cerr << "Could not connect to localhost." << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+using namespace std;
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include <rtac_asio/serial_utils.h>
+using namespace rtac::asio;
+
+// Checks on a pseudo terminal that the low latency settings are applied.
+// Linux pseudo terminals force CS8 without parity, so this cannot check that
+// raw mode keeps the character size and parity. Software flow control (IXON)
+// is checked instead.
+
+int main()
+{
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || ::grantpt(master) != 0 || ::unlockpt(master) != 0) {
+        cerr << "Could not open a pseudo terminal." << endl;
+        return 1;
+    }
+    std::string device = ::ptsname(master);
+    cout << "Pseudo terminal : " << device << endl;
+
+    unsigned int bauds = 250000; // not a standard termios baudrate
+    auto params = SerialStream::Parameters::LowLatency(bauds, 4, 2);
+    params.flowControl = SerialStream::SerialPort::flow_control(
+        SerialStream::SerialPort::flow_control::software);
+    auto serial = SerialStream::Create(AsyncService::Create(), device, params);
+    auto stream = Stream::Create(serial);
+    stream->start();
+
+    // settings are checked through another file descriptor on the same tty.
+    int fd = ::open(device.c_str(), O_RDWR | O_NOCTTY);
+    termios config;
+    ::tcgetattr(fd, &config);
+    cout << "VMIN    : " << (int)config.c_cc[VMIN]  << endl;
+    cout << "VTIME   : " << (int)config.c_cc[VTIME] << endl;
+    cout << "ICANON  : " << ((config.c_lflag & ICANON) != 0) << endl;
+    cout << "ECHO    : " << ((config.c_lflag & ECHO) != 0) << endl;
+    cout << "IXON    : " << ((config.c_iflag & IXON) != 0) << endl;
+    if(config.c_cc[VMIN] != 4 || config.c_cc[VTIME] != 2
+       || (config.c_lflag & (ICANON | ECHO)))
+    {
+        cerr << "Raw mode was not applied." << endl;
+        return 1;
+    }
+    if(!(config.c_iflag & IXON)) {
+        cerr << "Raw mode cleared the software flow control." << endl;
+        return 1;
+    }
+
+    unsigned int actual = 0;
+    if(auto err = get_baudrate(fd, actual)) {
+        cerr << "Could not read baudrate : " << err.message() << endl;
+        return 1;
+    }
+    cout << "Baudrate : " << actual << endl;
+    if(actual != bauds) {
+        cerr << "Custom baudrate was not applied." << endl;
+        return 1;
+    }
+
+    // pseudo terminals do not implement TIOCSSERIAL. Only reporting.
+    cout << "ASYNC_LOW_LATENCY : " << low_latency_enabled(fd)
+         << " (not supported on pseudo terminals)" << endl;
+    ::close(fd);
+
+    // data still goes through in raw mode.
+    std::string msg = "Hello there !\n", received(msg.size(), '\0');
+    if(::write(master, msg.c_str(), msg.size()) != (ssize_t)msg.size()) {
+        return 1;
+    }
+    auto count = stream->read(received.size(), (uint8_t*)&received[0], 1000);
+    cout << "Received : '" << received.substr(0, count) << "'" << endl;
+    if(received != msg) {
+        cerr << "Data was not received." << endl;
+        return 1;
+    }
+
+    ::close(master);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <functional>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+int main()
+{
+    bool ok = true;
+
+    std::string path = "/tmp/rtac_asio_service_monitor.sock";
+    ::unlink(path.c_str());
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::bind(listenFd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(listenFd, 1);
+
+    auto stream = Stream::CreateUnix(path);
+    int peer = ::accept(listenFd, nullptr, nullptr);
+    stream->start();
+    stream->set_name("unix");
+
+    auto service = stream->service();
+    service->enable_monitoring(4, 10);
+
+    uint8_t data[64];
+    for(int i = 0; i < 100; i++) {
+        // asynchronous read : a synchronous read of data already available
+        // completes without going through the service.
+        std::promise<void> received;
+        stream->async_read(10, data, [&](const Stream::ErrorCode&, std::size_t) {
+            received.set_value();
+        }, 1000);
+        ::send(peer, "0123456789", 10, 0);
+        received.get_future().wait();
+        stream->write(10, data, 1000);
+        ::recv(peer, data, 10, MSG_WAITALL);
+    }
+
+    // A handler stalling the loop, and a burst queued behind it.
+    int slowSource = 0;
+    service->monitor().name_source(&slowSource, "slow");
+    service->post([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    }, PostTag(&slowSource, "sleep"));
+    for(int i = 0; i < 10; i++) {
+        service->post([]() {}, PostTag(&slowSource, "burst"));
+    }
+    std::promise<void> done;
+    service->post([&]() { done.set_value(); });
+    done.get_future().wait();
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    auto report = service->monitoring();
+    cout << report << endl;
+
+    ok &= check(report.executed == report.posted && report.queueDepth == 0,
+                "every posted handler executed");
+    ok &= check(report.maxQueueDepth >= 11, "burst seen in the queue depth");
+    ok &= check(report.slowest.size() == 4 && report.slowest[0].name == "slow"
+                && report.slowest[0].operation == "sleep"
+                && report.slowest[0].nanos >= 30000000, "slowest handler reported");
+    ok &= check(report.sources.size() > 0 && report.sources[0].name == "slow",
+                "sources sorted by total time");
+    bool reads = false, writes = false;
+    for(auto& s : report.sources) {
+        if(s.name == "unix" && s.operation == "read")  reads  = s.count == 100;
+        if(s.name == "unix" && s.operation == "write") writes = s.count == 100;
+    }
+    ok &= check(reads && writes, "stream handlers attributed to the stream");
+    ok &= check(report.queueDelay.max >= 30000000, "burst delayed by the slow handler");
+    ok &= check(report.loopLag.count > 0 && report.loopLag.max >= 15000000,
+                "loop lag probe saw the stall");
+
+    service->disable_monitoring();
+    service->post([]() {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ok &= check(service->monitoring().posted == report.posted,
+                "nothing recorded once disabled");
+
+    // A throwing handler is still counted as executed.
+    ServiceMonitor monitor;
+    auto throwing = monitor.wrap([]() { throw std::runtime_error("handler"); },
+                                 PostTag(&slowSource, "throw"));
+    try { throwing(); } catch(const std::runtime_error&) {}
+    ok &= check(monitor.snapshot().executed == 1 && monitor.snapshot().queueDepth == 0,
+                "throwing handler counted as executed");
+
+    // A destroyed transport is forgotten by the monitor.
+    stream->stop();
+    stream = nullptr;
+    bool forgotten = true;
+    for(auto& s : service->monitoring().sources) {
+        if(s.name == "unix") forgotten = false;
+    }
+    ok &= check(forgotten, "destroyed stream forgotten by the monitor");
+
+    ::close(peer);
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    return ok ? 0 : 1;
+}
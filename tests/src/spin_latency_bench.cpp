@@ -0,0 +1,159 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <thread>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+void pin(int cpu)
+{
+    if(cpu < 0) return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+// Blocking echo on the other end of the socketpair.
+void echo(int fd, int cpu)
+{
+    pin(cpu);
+    uint8_t buffer[4096];
+    while(true) {
+        ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+        if(count <= 0) break;
+        if(::send(fd, buffer, count, MSG_NOSIGNAL) != count) break;
+    }
+}
+
+double cpu_micros()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return 1.0e6*(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+         + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void ping_pong(const std::string& name, unsigned int iterations, std::size_t size,
+               bool busyPoll, unsigned int spinMicros, int serviceCpu, int clientCpu,
+               int echoCpu)
+{
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    std::thread peer(echo, fds[1], echoCpu);
+
+    auto service = AsyncService::Create();
+    auto stream  = Stream::Create(UnixStream::Create(service, fds[0]));
+    service->set_busy_poll(busyPoll, serviceCpu);
+    stream->set_sync_spin(spinMicros);
+    stream->start();
+    pin(clientCpu);
+
+    std::vector<uint8_t> request(size, 'r'), reply(size);
+    std::vector<double> rtts;
+    rtts.reserve(iterations);
+    // warm-up
+    for(unsigned int i = 0; i < 100; i++) {
+        stream->write(size, request.data(), 1000);
+        stream->read(size, reply.data(), 1000);
+    }
+    double cpu0 = cpu_micros();
+    auto   t0   = Clock::now();
+    for(unsigned int i = 0; i < iterations; i++) {
+        auto t = Clock::now();
+        stream->write(size, request.data(), 1000);
+        if(stream->read(size, reply.data(), 1000) != size) {
+            cerr << name << " : read failed" << endl;
+            break;
+        }
+        rtts.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t).count());
+    }
+    double wall = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+    double cpu  = cpu_micros() - cpu0;
+
+    stream->stop();
+    stream = nullptr; // closes fds[0], the echo thread exits
+    peer.join();
+    ::close(fds[1]);
+    pin(-1);
+
+    if(rtts.size() == 0) return;
+    std::sort(rtts.begin(), rtts.end());
+    cout << std::setw(28) << std::left << name << std::right
+         << std::fixed << std::setprecision(1)
+         << std::setw(10) << rtts[rtts.size() / 2]
+         << std::setw(10) << rtts[(rtts.size() * 99) / 100]
+         << std::setw(10) << rtts[(rtts.size() * 999) / 1000]
+         << std::setw(10) << rtts.back()
+         << std::setw(12) << cpu / wall << endl;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int iterations = 2000;
+    std::size_t  size       = 64;
+    int          serviceCpu = -1, clientCpu = -1, echoCpu = -1;
+    if(argc > 1) iterations = std::stoul(argv[1]);
+    if(argc > 2) size       = std::stoul(argv[2]);
+    if(argc > 5) {
+        // dedicated (isolated) cores for the service thread, the caller and
+        // the echo thread.
+        serviceCpu = std::stoi(argv[3]);
+        clientCpu  = std::stoi(argv[4]);
+        echoCpu    = std::stoi(argv[5]);
+    }
+
+    cout << "Ping-pong of " << size << " bytes on a socketpair, " << iterations
+         << " iterations, " << std::thread::hardware_concurrency() << " cores (us)" << endl;
+    cout << std::setw(28) << std::left << "mode" << std::right
+         << std::setw(10) << "median" << std::setw(10) << "p99"
+         << std::setw(10) << "p99.9" << std::setw(10) << "max"
+         << std::setw(12) << "CPU load" << endl;
+
+    ping_pong("blocking",               iterations, size, false,  0, -1, -1, -1);
+    ping_pong("sync spin 50us",         iterations, size, false, 50, -1, -1, -1);
+    ping_pong("busy poll + sync spin",  iterations, size, true,  50, -1, -1, -1);
+    if(serviceCpu >= 0) {
+        ping_pong("busy poll + spin, pinned", iterations, size, true, 50,
+                  serviceCpu, clientCpu, echoCpu);
+    }
+    return 0;
+}
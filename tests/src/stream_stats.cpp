@@ -0,0 +1,134 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <cstring>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+int main()
+{
+    bool ok = true;
+
+    // histogram
+    {
+        LatencyHistogram h;
+        for(uint64_t v = 1; v <= 10000; v++) {
+            h.record(v * 1000); // 1us to 10ms
+        }
+        auto s = h.snapshot();
+        ok &= check(s.count == 10000 && s.min == 1000 && s.max == 10000000,
+                    "histogram count, min and max");
+        double p50 = s.percentile(50.0), p99 = s.percentile(99.0);
+        ok &= check(p50 >= 5.0e6 && p50 <= 5.0e6 * 1.07, "p50 within bucket precision");
+        ok &= check(p99 >= 9.9e6 && p99 <= 9.9e6 * 1.07, "p99 within bucket precision");
+
+        const int N = 10000000;
+        auto t0 = Clock::now();
+        for(int i = 0; i < N; i++) {
+            h.record(i & 0xffff);
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - t0).count();
+        cout << "Histogram record : " << double(ns) / N << " ns" << endl;
+    }
+
+    std::string path = "/tmp/rtac_asio_stream_stats.sock";
+    ::unlink(path.c_str());
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::bind(listenFd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(listenFd, 1);
+
+    auto stream = Stream::CreateUnix(path);
+    int peer = ::accept(listenFd, nullptr, nullptr);
+    stream->start();
+
+    uint8_t data[64];
+    // reads and writes
+    for(int i = 0; i < 100; i++) {
+        ::send(peer, "0123456789", 10, 0);
+        stream->read(10, data, 1000);
+        stream->write(10, data, 1000);
+        ::recv(peer, data, 10, MSG_WAITALL);
+    }
+    // leftover from read_until
+    ::send(peer, "line\nrest", 9, 0);
+    stream->read_until(sizeof(data), data, '\n', 1000);
+    stream->read(4, data, 1000);
+    // timeout
+    stream->read(10, data, 50);
+    // busy rejection
+    std::promise<void> done;
+    stream->async_read(4, data, [&](const Stream::ErrorCode&, std::size_t) {
+        done.set_value();
+    }, 1000);
+    bool refused = !stream->async_read(4, data, Stream::Callback());
+    ::send(peer, "done", 4, 0);
+    done.get_future().wait();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    auto stats = stream->stats();
+    cout << stats << stats.to_json() << endl;
+
+    ok &= check(refused, "second read refused while busy");
+    ok &= check(stats.reader.ops == 104, "reader ops");
+    ok &= check(stats.reader.bytes == 1000 + 5 + 4 + 4, "reader bytes");
+    ok &= check(stats.reader.timeouts == 1, "reader timeouts");
+    ok &= check(stats.reader.busy == 1, "reader busy rejections");
+    ok &= check(stats.reader.buffered == 4, "bytes served from the leftover buffer");
+    ok &= check(stats.reader.latency.count == 104
+                && stats.reader.dispatch.count == 104, "reader histograms");
+    ok &= check(stats.writer.ops == 100 && stats.writer.bytes == 1000, "writer ops and bytes");
+    ok &= check(stats.transport.tx.bytes == 1000
+                && stats.transport.tx.completed == stats.transport.tx.submitted,
+                "transport tx");
+    ok &= check(stats.transport.rx.bytes == 1000 + 9 + 4
+                && stats.transport.rx.errors == 1, "transport rx (the timeout aborted a read)");
+
+    stream->stop();
+    ::close(peer);
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+using namespace std;
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+uint64_t read_posts(AsyncService::Ptr service)
+{
+    uint64_t count = 0;
+    for(auto& s : service->monitoring().sources) {
+        if(s.name == "unix" && s.operation == "read") count += s.count;
+    }
+    return count;
+}
+
+void send_later(int fd, const std::string& data, unsigned int millis)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    ::send(fd, data.c_str(), data.size(), 0);
+}
+
+int main()
+{
+    bool ok = true;
+
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    auto service = AsyncService::Create();
+    auto stream  = Stream::Create(UnixStream::Create(service, fds[0]));
+    stream->set_name("unix");
+    stream->start();
+    service->enable_monitoring(0, 0);
+
+    char line[64];
+    std::size_t count;
+    auto text = [&](std::size_t size) { return std::string(line, size); };
+
+    // Lines already available : served from the socket then from the
+    // leftovers, on the calling thread.
+    std::string lines = "alpha\nbeta\ngamma\n0123";
+    ::send(fds[1], lines.c_str(), lines.size(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    count = stream->read_until(sizeof(line), (uint8_t*)line, '\n', 1000);
+    ok &= check(text(count) == "alpha\n", "first line read");
+    count = stream->read_until(sizeof(line), (uint8_t*)line, '\n', 1000);
+    ok &= check(text(count) == "beta\n", "second line from the leftovers");
+    count = stream->read_until(sizeof(line), (uint8_t*)line, '\n', 1000);
+    ok &= check(text(count) == "gamma\n", "third line from the leftovers");
+    count = stream->read(4, (uint8_t*)line, 1000);
+    ok &= check(text(count) == "0123", "read from the leftovers");
+    ok &= check(read_posts(service) == 0, "no read went through the service");
+
+    // Partial line : the read continues asynchronously.
+    ::send(fds[1], "delt", 4, 0);
+    std::thread sender(send_later, fds[1], "a\nepsilon", 20);
+    count = stream->read_until(sizeof(line), (uint8_t*)line, '\n', 1000);
+    sender.join();
+    ok &= check(text(count) == "delta\n", "line completed asynchronously");
+    ok &= check(read_posts(service) == 1, "read completed by the service");
+
+    // Size limit reached on the fast path.
+    count = stream->read_until(4, (uint8_t*)line, '\n', 1000);
+    ok &= check(text(count) == "epsi", "read_until truncated to maxSize");
+    count = stream->read(3, (uint8_t*)line, 1000);
+    ok &= check(text(count) == "lon", "read of the leftovers after truncation");
+
+    // Nothing available : the timeout still applies.
+    auto t0 = std::chrono::steady_clock::now();
+    count = stream->read(8, (uint8_t*)line, 50);
+    auto elapsed = std::chrono::steady_clock::now() - t0;
+    ok &= check(count == 0 && elapsed >= std::chrono::milliseconds(40),
+                "timeout of a read with no data");
+
+    auto stats = stream->stats();
+    cout << stats << endl;
+    ok &= check(stats.reader.ops == 8 && stats.reader.timeouts == 1,
+                "fast path reads counted");
+
+    stream->stop();
+    ::close(fds[1]);
+    return ok ? 0 : 1;
+}
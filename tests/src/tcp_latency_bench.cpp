@@ -0,0 +1,165 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+using namespace std;
+using namespace std::placeholders;
+
+#include <rtac_asio/TCPServer.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+struct EchoSession
+{
+    Stream::Ptr          stream;
+    std::vector<uint8_t> buffer;
+};
+
+void echo_read(std::shared_ptr<EchoSession> session);
+
+void echo_written(std::shared_ptr<EchoSession> session,
+                  const Stream::ErrorCode& err, std::size_t count)
+{
+    if(!err) echo_read(session);
+}
+
+void echo_received(std::shared_ptr<EchoSession> session,
+                   const Stream::ErrorCode& err, std::size_t count)
+{
+    if(err) return;
+    session->stream->async_write(count, session->buffer.data(),
+                                 std::bind(&echo_written, session, _1, _2));
+}
+
+void echo_read(std::shared_ptr<EchoSession> session)
+{
+    session->stream->async_read_some(session->buffer.size(),
+                                     session->buffer.data(),
+                                     std::bind(&echo_received, session, _1, _2));
+}
+
+/**
+ * Request/response round trip time on loopback. The request is written in
+ * two parts (header then payload) which is the typical pattern triggering
+ * the Nagle / delayed ACK interaction.
+ */
+void run_benchmark(const std::string& name, const TCPSocketOptions& options,
+                   unsigned int iterations)
+{
+    TCPServer::Parameters serverParams;
+    serverParams.socketOptions = options;
+    auto server = TCPServer::Create("127.0.0.1", 0, serverParams);
+    server->service()->start();
+    server->start([](Stream::Ptr stream) {
+        auto session = std::make_shared<EchoSession>();
+        session->stream = stream;
+        session->buffer.resize(256);
+        echo_read(session);
+    });
+
+    TCPClientStream::Parameters clientParams(1000, false, options);
+    auto client = Stream::Create(TCPClientStream::Create(AsyncService::Create(),
+        "127.0.0.1", server->local().port(), clientParams));
+    client->start();
+
+    std::vector<uint8_t> header(4, 'h'), payload(28, 'p'), reply(32);
+    std::vector<double> rtts;
+    for(unsigned int i = 0; i < iterations; i++) {
+        auto t0 = Clock::now();
+        client->write(header.size(), header.data(), 1000);
+        client->write(payload.size(), payload.data(), 1000);
+        if(client->read(reply.size(), reply.data(), 1000) != reply.size()) {
+            cerr << name << " : read failed" << endl;
+            break;
+        }
+        rtts.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+    if(rtts.size() == 0) return;
+
+    std::sort(rtts.begin(), rtts.end());
+    double mean = 0.0;
+    for(auto v : rtts) mean += v;
+    mean /= rtts.size();
+    cout << std::setw(24) << std::left << name << std::right << std::fixed << std::setprecision(1)
+         << std::setw(12) << mean
+         << std::setw(12) << rtts[rtts.size() / 2]
+         << std::setw(12) << rtts[(rtts.size() * 99) / 100]
+         << std::setw(12) << rtts.back() << endl;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int iterations = 100;
+    if(argc > 1) iterations = std::stoul(argv[1]);
+
+    cout << "Request/response RTT on loopback (us), " << iterations << " iterations" << endl;
+    cout << std::setw(24) << std::left << "options" << std::right
+         << std::setw(12) << "mean" << std::setw(12) << "median"
+         << std::setw(12) << "p99" << std::setw(12) << "max" << endl;
+
+    TCPSocketOptions options;
+    run_benchmark("default", options, iterations);
+
+    options = TCPSocketOptions();
+    options.noDelay = true;
+    run_benchmark("TCP_NODELAY", options, iterations);
+
+    options = TCPSocketOptions();
+    options.quickAck = true;
+    run_benchmark("TCP_QUICKACK", options, iterations);
+
+    run_benchmark("TCP_NODELAY+QUICKACK", TCPSocketOptions::LowLatency(), iterations);
+
+    options = TCPSocketOptions();
+    options.keepAlive         = true;
+    options.keepAliveIdle     = 10;
+    options.keepAliveInterval = 2;
+    options.keepAliveCount    = 3;
+    run_benchmark("SO_KEEPALIVE", options, iterations);
+
+    options = TCPSocketOptions();
+    options.receiveBufferSize = 4096;
+    options.sendBufferSize    = 4096;
+    run_benchmark("SO_RCVBUF/SNDBUF 4k", options, iterations);
+
+    options = TCPSocketOptions();
+    options.userTimeoutMillis = 5000;
+    run_benchmark("TCP_USER_TIMEOUT", options, iterations);
+
+    options = TCPSocketOptions::LowLatency();
+    options.busyPollMicros = 50;
+    run_benchmark("LowLatency+SO_BUSY_POLL", options, iterations);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <functional>
+#include <thread>
+#include <chrono>
+using namespace std;
+using namespace std::placeholders;
+
+#include <rtac_asio/TCPServer.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+uint16_t free_port()
+{
+    boost::asio::io_service service;
+    TCPServer::Acceptor acceptor(service,
+        TCPServer::EndPoint(boost::asio::ip::address_v4::loopback(), 0));
+    return acceptor.local_endpoint().port();
+}
+
+int main()
+{
+    uint16_t port = free_port();
+
+    TCPClientStream::Parameters params(500, true);
+    params.reconnectMinMillis = 50;
+    params.reconnectMaxMillis = 400;
+
+    // No server listening yet : this must not block.
+    auto t0 = Clock::now();
+    auto client = TCPClientStream::Create(AsyncService::Create(), "127.0.0.1", port, params);
+    auto stream = Stream::Create(client);
+    stream->start();
+    cout << "Client created in "
+         << std::chrono::duration<double, std::milli>(Clock::now() - t0).count()
+         << " ms" << endl;
+    client->set_connect_handler([](const Stream::ErrorCode& err) {
+        cout << "Connect handler : '" << err.message() << "'" << endl;
+    });
+
+    // Written while disconnected, sent when connection is up.
+    std::string msg = "Hello there !\n";
+    if(stream->write(msg) != msg.size()) {
+        cerr << "Write was not buffered." << endl;
+        return 1;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    std::string received(msg.size(), '\0');
+    std::size_t count = 0;
+    auto server = TCPServer::Create("127.0.0.1", port);
+    server->service()->start();
+    server->start([&](Stream::Ptr session) {
+        // Called from the server service thread : must not block here.
+        session->async_read(received.size(), (uint8_t*)&received[0],
+            [&](const Stream::ErrorCode& err, std::size_t readCount) {
+                count = readCount;
+            });
+    });
+
+    for(int i = 0; i < 100 && count == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    cout << "Server received : '" << received.substr(0, count) << "'" << endl;
+    if(received != msg || !client->is_connected()) {
+        cerr << "Buffered data was not sent after reconnection." << endl;
+        return 1;
+    }
+
+    return 0;
+}
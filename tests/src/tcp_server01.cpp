@@ -0,0 +1,123 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <thread>
+using namespace std;
+using namespace std::placeholders;
+
+#include <rtac_asio/TCPServer.h>
+using namespace rtac::asio;
+
+struct EchoSession
+{
+    Stream::Ptr          stream;
+    std::vector<uint8_t> buffer;
+};
+
+void echo_read(std::shared_ptr<EchoSession> session);
+
+void echo_written(std::shared_ptr<EchoSession> session,
+                  const Stream::ErrorCode& err, std::size_t count)
+{
+    if(!err) echo_read(session);
+}
+
+void echo_received(std::shared_ptr<EchoSession> session,
+                   const Stream::ErrorCode& err, std::size_t count)
+{
+    if(err) {
+        return;
+    }
+    session->stream->async_write(count, session->buffer.data(),
+                                 std::bind(&echo_written, session, _1, _2));
+}
+
+void echo_read(std::shared_ptr<EchoSession> session)
+{
+    session->stream->async_read_some(session->buffer.size(),
+                                     session->buffer.data(),
+                                     std::bind(&echo_received, session, _1, _2));
+}
+
+std::string rss()
+{
+    std::ifstream f("/proc/self/status");
+    std::string line;
+    while(std::getline(f, line)) {
+        if(line.find("VmRSS") == 0) return line;
+    }
+    return "VmRSS: unknown";
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t clientCount = 1000;
+    if(argc > 1) clientCount = std::stoul(argv[1]);
+
+    auto server = TCPServer::Create("127.0.0.1", 0,
+        TCPServer::Parameters(TCPServer::Acceptor::max_listen_connections,
+                              clientCount, 500));
+    server->service()->start();
+    server->start([](Stream::Ptr stream) {
+        auto session = std::make_shared<EchoSession>();
+        session->stream = stream;
+        session->buffer.resize(64);
+        echo_read(session);
+    });
+    cout << "Listening on " << server->local() << endl;
+    cout << "Before connections : " << rss() << endl;
+
+    boost::asio::io_service clientService;
+    std::vector<std::unique_ptr<TCPServer::Socket>> clients;
+    std::string msg = "Hello there !\n";
+    std::string reply(msg.size(), '\0');
+    for(std::size_t i = 0; i < clientCount; i++) {
+        clients.push_back(std::make_unique<TCPServer::Socket>(clientService));
+        clients.back()->connect(server->local());
+        boost::asio::write(*clients.back(), boost::asio::buffer(msg));
+        boost::asio::read(*clients.back(), boost::asio::buffer(&reply[0], reply.size()));
+        if(reply != msg) {
+            cerr << "Wrong echo from server : '" << reply << "'" << endl;
+            return 1;
+        }
+    }
+    cout << "Sessions : " << server->session_count() << endl;
+    cout << "After connections : " << rss() << endl;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    cout << "Sessions after idle timeout : " << server->session_count() << endl;
+    if(server->session_count() != 0) {
+        cerr << "Idle sessions were not closed." << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+using namespace std;
+using namespace std::placeholders;
+
+#include <rtac_asio/Stream.h>
+#include <rtac_asio/TimerWheel.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Transport with no device behind it. Reads either complete immediately with
+ * dummy data or never complete (silent), in which case only the timeout of
+ * the StreamReader can end them.
+ */
+class DummyStream : public StreamInterface
+{
+    public:
+
+    using Ptr = std::shared_ptr<DummyStream>;
+
+    protected:
+
+    bool                  silent_;
+    std::vector<Callback> pending_;
+
+    DummyStream(AsyncService::Ptr service, bool silent) :
+        StreamInterface(service), silent_(silent)
+    {}
+
+    public:
+
+    static Ptr Create(AsyncService::Ptr service, bool silent) {
+        return Ptr(new DummyStream(service, silent));
+    }
+
+    void flush() {}
+    void reset() {}
+
+    void async_read_some(std::size_t bufferSize, uint8_t* buffer, Callback callback) {
+        if(silent_) {
+            pending_.push_back(callback); // never completed
+            return;
+        }
+        buffer[0] = 'a';
+        service_->post(std::bind(callback, ErrorCode(), 1));
+    }
+    void async_write_some(std::size_t count, const uint8_t* data, Callback callback) {
+        service_->post(std::bind(callback, ErrorCode(), count));
+    }
+};
+
+struct Reader
+{
+    Stream::Ptr              stream;
+    uint8_t                  buffer[16];
+    std::atomic<unsigned>*   remaining;
+    std::atomic<unsigned>*   done;
+    Clock::time_point        started;
+    double                   elapsedMillis;
+
+    void read(unsigned int timeoutMillis) {
+        stream->async_read_some(sizeof(buffer), buffer,
+            std::bind(&Reader::read_callback, this, timeoutMillis, _1, _2),
+            timeoutMillis);
+    }
+
+    void read_callback(unsigned int timeoutMillis,
+                       const Stream::ErrorCode& err, std::size_t count) {
+        elapsedMillis = 1.0e-3*std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - started).count();
+        if(remaining && remaining->fetch_sub(1) > 1) {
+            this->read(timeoutMillis);
+            return;
+        }
+        done->fetch_add(1);
+    }
+};
+
+void wait_for(std::atomic<unsigned>& done, unsigned int count)
+{
+    while(done.load() < count) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+// Many streams doing reads which complete before their timeout. The timeout
+// is armed and cancelled on each read.
+void completed_reads(unsigned int streamCount, unsigned int readsPerStream)
+{
+    auto service = AsyncService::Create();
+    std::vector<Reader> readers(streamCount);
+    std::vector<std::atomic<unsigned>> remaining(streamCount);
+    std::atomic<unsigned> done(0);
+    for(unsigned int i = 0; i < streamCount; i++) {
+        readers[i].stream    = Stream::Create(DummyStream::Create(service, false));
+        remaining[i]         = readsPerStream;
+        readers[i].remaining = &remaining[i];
+        readers[i].done      = &done;
+    }
+
+    service->start();
+    auto t0 = Clock::now();
+    for(auto& r : readers) {
+        r.started = t0;
+        r.read(1000);
+    }
+    wait_for(done, streamCount);
+    double elapsed = 1.0e-6*std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - t0).count();
+    service->stop();
+
+    double ops = (double)streamCount * readsPerStream;
+    cout << "Completed reads   : " << streamCount << " streams, " << ops
+         << " reads with timeout in " << elapsed << "s ("
+         << (unsigned int)(ops / elapsed) << " reads/s)" << endl;
+}
+
+// Many streams with a read which times out.
+bool expired_reads(unsigned int streamCount, unsigned int timeoutMillis)
+{
+    auto service = AsyncService::Create();
+    std::vector<Reader> readers(streamCount);
+    std::atomic<unsigned> done(0);
+    for(unsigned int i = 0; i < streamCount; i++) {
+        readers[i].stream    = Stream::Create(DummyStream::Create(service, true));
+        readers[i].remaining = nullptr;
+        readers[i].done      = &done;
+    }
+
+    service->start();
+    for(auto& r : readers) {
+        r.started = Clock::now();
+        r.read(timeoutMillis);
+    }
+    wait_for(done, streamCount);
+    service->stop();
+
+    std::vector<double> elapsed;
+    for(auto& r : readers) elapsed.push_back(r.elapsedMillis);
+    std::sort(elapsed.begin(), elapsed.end());
+    cout << "Expired reads     : " << streamCount << " streams, timeout "
+         << timeoutMillis << "ms, expired after min " << elapsed.front()
+         << "ms, median " << elapsed[elapsed.size() / 2]
+         << "ms, max " << elapsed.back() << "ms" << endl;
+    return elapsed.front() >= timeoutMillis;
+}
+
+// Cost of arming and cancelling a timeout (the common case).
+void arm_cancel(unsigned int iterations)
+{
+    boost::asio::io_service service;
+
+    TimerWheel wheel(service);
+    auto t0 = Clock::now();
+    for(unsigned int i = 0; i < iterations; i++) {
+        auto handle = wheel.arm(1000, []() {});
+        wheel.cancel(handle);
+    }
+    double wheelNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - t0).count() / (double)iterations;
+
+    AsyncService::Timer timer(service);
+    t0 = Clock::now();
+    for(unsigned int i = 0; i < iterations; i++) {
+        timer.expires_from_now(AsyncService::Millis(1000));
+        timer.async_wait([](const AsyncService::ErrorCode&) {});
+        timer.cancel();
+    }
+    double timerNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - t0).count() / (double)iterations;
+    service.run(); // flushes the cancelled handlers
+
+    cout << "Arm + cancel      : timer wheel " << wheelNs
+         << "ns, steady_timer " << timerNs << "ns" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int streamCount = 10000;
+    if(argc > 1) streamCount = std::stoul(argv[1]);
+
+    cout << std::fixed << std::setprecision(2);
+    arm_cancel(1000000);
+    completed_reads(streamCount, 100);
+    if(!expired_reads(streamCount, 100)) {
+        cerr << "A timeout expired early." << endl;
+        return 1;
+    }
+    return 0;
+}
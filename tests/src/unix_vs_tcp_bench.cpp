@@ -0,0 +1,201 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+// Blocking echo server running in its own thread. Same implementation for
+// all socket types so only the transport differs.
+void echo_server(int listenFd, bool connected)
+{
+    int fd = listenFd;
+    if(connected) {
+        fd = ::accept(listenFd, nullptr, nullptr);
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails on unix sockets
+    }
+    uint8_t buffer[65536];
+    sockaddr_un peer;
+    while(true) {
+        socklen_t peerSize = sizeof(peer);
+        ssize_t count = ::recvfrom(fd, buffer, sizeof(buffer), 0, (sockaddr*)&peer, &peerSize);
+        if(count <= 0) break;
+        if(connected) {
+            if(::send(fd, buffer, count, MSG_NOSIGNAL) != count) break;
+        }
+        else {
+            if(::sendto(fd, buffer, count, 0, (sockaddr*)&peer, peerSize) != count) break;
+        }
+    }
+    if(connected) ::close(fd);
+}
+
+int unix_server(const std::string& path, int type)
+{
+    ::unlink(path.c_str());
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    int fd = ::socket(AF_UNIX, type, 0);
+    ::bind(fd, (sockaddr*)&addr, sizeof(addr));
+    if(type != SOCK_DGRAM) ::listen(fd, 1);
+    return fd;
+}
+
+int tcp_server(uint16_t& port)
+{
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ::bind(fd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(fd, 1);
+    socklen_t size = sizeof(addr);
+    ::getsockname(fd, (sockaddr*)&addr, &size);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+double cpu_micros()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return 1.0e6*(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+         + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void ping_pong(const std::string& name, Stream::Ptr stream,
+               std::size_t size, unsigned int iterations)
+{
+    stream->start();
+    std::vector<uint8_t> request(size, 'r'), reply(size);
+    std::vector<double> rtts;
+    rtts.reserve(iterations);
+
+    double cpu0 = cpu_micros();
+    auto   t0   = Clock::now();
+    for(unsigned int i = 0; i < iterations; i++) {
+        auto t = Clock::now();
+        stream->write(request.size(), request.data(), 1000);
+        if(stream->read(reply.size(), reply.data(), 1000) != reply.size()) {
+            cerr << name << " : read failed" << endl;
+            return;
+        }
+        rtts.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t).count());
+    }
+    double wall = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+    double cpu  = cpu_micros() - cpu0;
+
+    std::sort(rtts.begin(), rtts.end());
+    cout << std::setw(20) << std::left << name << std::right
+         << std::fixed << std::setprecision(1)
+         << std::setw(12) << wall / iterations
+         << std::setw(12) << rtts[rtts.size() / 2]
+         << std::setw(12) << rtts[(rtts.size() * 99) / 100]
+         << std::setw(14) << cpu / iterations << endl;
+    stream->stop();
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int iterations = 10000;
+    std::size_t  size       = 64;
+    if(argc > 1) iterations = std::stoul(argv[1]);
+    if(argc > 2) size       = std::stoul(argv[2]);
+
+    cout << "Ping-pong of " << size << " bytes, " << iterations << " iterations (us)" << endl;
+    cout << std::setw(20) << std::left << "transport" << std::right
+         << std::setw(12) << "mean RTT" << std::setw(12) << "median"
+         << std::setw(12) << "p99" << std::setw(14) << "CPU/RTT" << endl;
+
+    {
+        uint16_t port;
+        int fd = tcp_server(port);
+        std::thread server(echo_server, fd, true);
+        ping_pong("TCP loopback", Stream::Create(TCPClientStream::Create(
+            AsyncService::Create(), "127.0.0.1", port,
+            TCPClientStream::Parameters(1000, false, TCPSocketOptions::LowLatency()))),
+            size, iterations);
+        server.join();
+        ::close(fd);
+    }
+    {
+        std::string path = "/tmp/rtac_asio_bench_stream.sock";
+        int fd = unix_server(path, SOCK_STREAM);
+        std::thread server(echo_server, fd, true);
+        ping_pong("Unix SOCK_STREAM", Stream::CreateUnix(path), size, iterations);
+        server.join();
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+    {
+        std::string path = "/tmp/rtac_asio_bench_seqpacket.sock";
+        int fd = unix_server(path, SOCK_SEQPACKET);
+        std::thread server(echo_server, fd, true);
+        ping_pong("Unix SOCK_SEQPACKET",
+                  Stream::CreateUnixDatagram(path, UnixDatagramStream::SeqPacket),
+                  size, iterations);
+        server.join();
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+    {
+        std::string path = "/tmp/rtac_asio_bench_dgram.sock";
+        int fd = unix_server(path, SOCK_DGRAM);
+        std::thread server(echo_server, fd, false);
+        ping_pong("Unix SOCK_DGRAM",
+                  Stream::CreateUnixDatagram(path, UnixDatagramStream::Datagram),
+                  size, iterations);
+        ::shutdown(fd, SHUT_RDWR);
+        server.join();
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+
+    return 0;
+}
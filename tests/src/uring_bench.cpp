@@ -0,0 +1,240 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <cstring>
+using namespace std;
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include <rtac_asio/Stream.h>
+#include <rtac_asio/UringQueue.h>
+using namespace rtac::asio;
+using namespace std::placeholders;
+
+using Clock = std::chrono::steady_clock;
+
+// The I/O and polling syscalls made by the library (boost::asio calls them
+// through libc) are counted by interposing the libc functions. io_uring_enter
+// calls are given by UringQueue::stats.
+std::atomic<uint64_t> syscallCount(0);
+
+#define COUNTED(ret, name, params, args)                                   \
+    extern "C" ret name params {                                           \
+        static auto real = (ret(*)params)::dlsym(RTLD_NEXT, #name);        \
+        syscallCount.fetch_add(1, std::memory_order_relaxed);              \
+        return real args;                                                  \
+    }
+COUNTED(ssize_t, recvmsg, (int fd, msghdr* msg, int flags), (fd, msg, flags))
+COUNTED(ssize_t, sendmsg, (int fd, const msghdr* msg, int flags), (fd, msg, flags))
+COUNTED(ssize_t, recv,    (int fd, void* data, size_t size, int flags), (fd, data, size, flags))
+COUNTED(ssize_t, send,    (int fd, const void* data, size_t size, int flags), (fd, data, size, flags))
+COUNTED(ssize_t, readv,  (int fd, const iovec* iov, int count), (fd, iov, count))
+COUNTED(ssize_t, writev, (int fd, const iovec* iov, int count), (fd, iov, count))
+COUNTED(ssize_t, read,   (int fd, void* data, size_t size), (fd, data, size))
+COUNTED(ssize_t, write,  (int fd, const void* data, size_t size), (fd, data, size))
+COUNTED(int, epoll_wait, (int fd, epoll_event* events, int max, int timeout),
+        (fd, events, max, timeout))
+
+// Echo server in a child process (its syscalls are not counted), serving any
+// number of connections with epoll.
+void echo_server(int listenFd)
+{
+    int epfd = ::epoll_create1(0);
+    epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = listenFd;
+    ::epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+    static uint8_t buffer[65536];
+    epoll_event events[64];
+    while(true) {
+        int count = ::epoll_wait(epfd, events, 64, -1);
+        for(int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if(fd == listenFd) {
+                ev.data.fd = ::accept(listenFd, nullptr, nullptr);
+                ::epoll_ctl(epfd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+                continue;
+            }
+            ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+            if(received <= 0) {
+                ::epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+                ::close(fd);
+                continue;
+            }
+            ::send(fd, buffer, received, MSG_NOSIGNAL);
+        }
+    }
+}
+
+struct Client
+{
+    Stream::Ptr       stream;
+    uint8_t*          data;
+    std::size_t       size;
+    std::atomic<bool>* stop;
+    std::atomic<int>*  active;
+    uint64_t          exchanges = 0;
+
+    void start() {
+        stream->async_write(size, data, std::bind(&Client::written, this, _1, _2));
+    }
+    void written(const Stream::ErrorCode& err, std::size_t) {
+        if(err) { active->fetch_sub(1); return; }
+        stream->async_read(size, data, std::bind(&Client::received, this, _1, _2));
+    }
+    void received(const Stream::ErrorCode& err, std::size_t) {
+        if(err) { active->fetch_sub(1); return; }
+        exchanges++;
+        if(*stop) { active->fetch_sub(1); return; }
+        this->start();
+    }
+};
+
+void run(const std::string& path, AsyncService::Backend backend,
+         unsigned int streamCount, std::size_t size, double seconds)
+{
+    AsyncService::Ptr service;
+    try {
+        service = AsyncService::Create(BufferPool::Parameters(64, 1024*1024, 4*1024*1024),
+                                       backend);
+    }
+    catch(const std::exception& e) {
+        cout << e.what() << endl;
+        return;
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<int>  active(streamCount);
+    std::vector<Client> clients(streamCount);
+    for(auto& c : clients) {
+        c.stream = Stream::Create(UnixStream::Create(service, path));
+        // from the pool arena : fixed buffers with io_uring.
+        c.data   = (uint8_t*)service->buffer_pool().allocate(size);
+        c.size   = size;
+        std::memset(c.data, 'r', size);
+        c.stop   = &stop;
+        c.active = &active;
+    }
+    service->start();
+
+    syscallCount = 0;
+    auto t0 = Clock::now();
+    for(auto& c : clients) {
+        c.start();
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    while(active > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+    uint64_t syscalls = syscallCount;
+
+    uint64_t exchanges = 0;
+    for(auto& c : clients) exchanges += c.exchanges;
+    UringQueue::Stats ustats;
+    if(service->uring()) {
+        ustats = service->uring()->stats();
+        syscalls += ustats.enters;
+    }
+    // 2 operations (a write and a read) per exchange.
+    cout << std::setw(9) << (backend == AsyncService::IoUring ? "io_uring" : "epoll")
+         << std::setw(9) << streamCount
+         << std::fixed << std::setprecision(2)
+         << std::setw(12) << exchanges / elapsed / 1000.0
+         << std::setw(10) << 2.0 * size * exchanges / elapsed / 1.0e6
+         << std::setw(14) << double(syscalls) / (2*exchanges);
+    if(service->uring()) {
+        cout << "   (enters " << double(ustats.enters) / (2*exchanges)
+             << "/op, fixed files " << ustats.fixedFiles
+             << ", fixed buffers " << ustats.fixedBuffers << ")";
+    }
+    cout << endl;
+
+    for(auto& c : clients) {
+        service->buffer_pool().deallocate(c.data, size);
+        c.stream = nullptr;
+    }
+    service->stop();
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t size    = 1024;
+    double      seconds = 1.0;
+    if(argc > 1) size    = std::stoul(argv[1]);
+    if(argc > 2) seconds = std::stod(argv[2]);
+
+    std::string path = "/tmp/rtac_asio_uring_bench.sock";
+    ::unlink(path.c_str());
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::bind(listenFd, (sockaddr*)&addr, sizeof(addr));
+    ::listen(listenFd, 512);
+
+    pid_t child = ::fork();
+    if(child == 0) {
+        echo_server(listenFd);
+        return 0;
+    }
+
+    if(!UringQueue::is_supported()) {
+        cout << "io_uring is not available on this system." << endl;
+    }
+    cout << "Echo of " << size << " bytes over Unix sockets, " << seconds
+         << "s per run" << endl;
+    cout << std::setw(9) << "backend" << std::setw(9) << "streams"
+         << std::setw(12) << "kexch/s" << std::setw(10) << "MB/s"
+         << std::setw(14) << "syscalls/op" << endl;
+    for(unsigned int streams : {1, 16, 256}) {
+        run(path, AsyncService::Reactor, streams, size, seconds);
+        run(path, AsyncService::IoUring, streams, size, seconds);
+    }
+
+    ::kill(child, SIGTERM);
+    ::waitpid(child, nullptr, 0);
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    return 0;
+}
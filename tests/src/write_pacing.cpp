@@ -0,0 +1,174 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <ctime>
+using namespace std;
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+using Clock = std::chrono::steady_clock;
+
+struct Link
+{
+    int               fds[2];
+    Stream::Ptr       stream;
+    std::thread       drain;
+    std::atomic<bool> stop;
+    std::atomic<std::size_t> received;
+
+    Link(AsyncService::Ptr service) : stop(false), received(0)
+    {
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        stream = Stream::Create(UnixStream::Create(service, fds[0]));
+        stream->start();
+        drain = std::thread([this]() {
+            uint8_t buf[4096];
+            while(!stop) {
+                ssize_t count = ::recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT);
+                if(count > 0) received += count;
+                else std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+    }
+    ~Link() {
+        stop = true;
+        drain.join();
+        ::close(fds[1]);
+    }
+};
+
+std::size_t timed_write(Stream::Ptr stream, std::size_t count, const uint8_t* data,
+                        unsigned int timeoutMillis, StreamInterface::ErrorCode& err)
+{
+    std::promise<std::size_t> done;
+    if(!stream->async_write(count, data,
+        [&](const StreamInterface::ErrorCode& e, std::size_t written) {
+            err = e;
+            done.set_value(written);
+        }, timeoutMillis))
+    {
+        return 0;
+    }
+    return done.get_future().get();
+}
+
+int main()
+{
+    bool ok = true;
+    auto service = AsyncService::Create();
+
+    const double      rate  = 100000.0; // bytes/s
+    const std::size_t burst = 1000;
+    std::vector<uint8_t> data(50000, 0x42);
+
+    {
+        Link link(service);
+        link.stream->enable_pacing(rate, burst);
+
+        // The service thread stays available while the write is paced.
+        std::atomic<bool> stopProbe(false);
+        std::atomic<double> worstProbe(0.0);
+        std::thread probe([&]() {
+            while(!stopProbe) {
+                auto t0 = Clock::now();
+                std::promise<void> ran;
+                service->post([&]() { ran.set_value(); });
+                ran.get_future().wait();
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+                if(ms > worstProbe) worstProbe = ms;
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        });
+
+        auto    t0   = Clock::now();
+        clock_t cpu0 = std::clock();
+        StreamInterface::ErrorCode err;
+        std::size_t written = timed_write(link.stream, data.size(), data.data(), 0, err);
+        double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+        double cpu     = double(std::clock() - cpu0) / CLOCKS_PER_SEC;
+        stopProbe = true;
+        probe.join();
+
+        double expected = (data.size() - burst) / rate;
+        cout << "paced write : " << written << " bytes in " << elapsed
+             << " s (expected " << expected << " s), process cpu " << cpu
+             << " s, worst service latency " << worstProbe << " ms" << endl;
+        ok &= check(!err && written == data.size(), "paced write complete");
+        ok &= check(elapsed > 0.9*expected && elapsed < 1.3*expected,
+                    "byte rate limited to the configured rate");
+        ok &= check(worstProbe < 20.0, "service thread not blocked by the pacing");
+        ok &= check(cpu < 0.5*elapsed, "no busy loop while pacing");
+
+        auto stats = link.stream->stats();
+        cout << stats;
+        ok &= check(stats.writer.paced > 0 && stats.writer.pacing.count > 0,
+                    "pacing delay reported in the writer stats");
+
+        // timeout of a write waiting for the bucket
+        link.stream->enable_pacing(1000.0, 100);
+        t0 = Clock::now();
+        written = timed_write(link.stream, 1000, data.data(), 50, err);
+        elapsed = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        cout << "timed out paced write : " << written << " bytes in "
+             << elapsed << " ms" << endl;
+        ok &= check(err == boost::asio::error::timed_out && written < 1000
+                    && elapsed < 200.0, "timeout of a paced write");
+    }
+
+    {
+        // pacing of the scheduled writes
+        Link link(service);
+        link.stream->enable_scheduled_writes();
+        link.stream->enable_pacing(rate, burst);
+
+        auto t0 = Clock::now();
+        StreamInterface::ErrorCode err;
+        std::size_t written = timed_write(link.stream, data.size(), data.data(), 0, err);
+        double elapsed  = std::chrono::duration<double>(Clock::now() - t0).count();
+        double expected = (data.size() - burst) / rate;
+        cout << "scheduled paced write : " << written << " bytes in " << elapsed
+             << " s" << endl;
+        ok &= check(!err && written == data.size()
+                    && elapsed > 0.9*expected && elapsed < 1.3*expected,
+                    "scheduled writes paced");
+    }
+
+    cout << (ok ? "All tests passed" : "Some tests failed") << endl;
+    return ok ? 0 : 1;
+}
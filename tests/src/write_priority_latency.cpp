@@ -0,0 +1,202 @@
+/**
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ * 
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ * 
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+using namespace std;
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rtac_asio/Stream.h>
+#include "test_utils.h"
+using namespace rtac::asio;
+
+// Latency of small urgent writes while a bulk transfer saturates a slow link
+// (the reader drains about 1 MB/s, roughly 100 times a 115200 baud line).
+
+using Clock = std::chrono::steady_clock;
+
+const uint8_t     Marker     = 0xff; // urgent bytes, never in the bulk data
+const std::size_t ChunkSize  = 16384;
+const std::size_t ChunkCount = 16;
+const std::size_t UrgentSize = 8;
+
+struct Result
+{
+    std::vector<double> latencies; // ms
+    bool                intact = false;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+    if(values.size() == 0) return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[std::min<std::size_t>(values.size() - 1, p * values.size())];
+}
+
+/**
+ * Writes and waits for completion, retries while the writer refuses the
+ * write (another write in progress without the scheduler, what the
+ * applications do today).
+ */
+std::size_t write_retry(Stream::Ptr stream, unsigned int priority,
+                        std::size_t count, const uint8_t* data)
+{
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while(Clock::now() < deadline) {
+        auto done = std::make_shared<std::promise<std::size_t>>();
+        if(stream->async_write_priority(priority, count, data,
+            [done](const StreamInterface::ErrorCode& err, std::size_t written) {
+                done->set_value(err ? 0 : written);
+            }))
+        {
+            return done->get_future().get();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return 0;
+}
+
+Result run(const char* name, bool scheduled, WriteScheduler::Policy policy)
+{
+    Result res;
+
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    int small = 1; // clamped to the minimum by the kernel
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+
+    auto service = AsyncService::Create();
+    auto stream  = Stream::Create(UnixStream::Create(service, fds[0]));
+    stream->start();
+    if(scheduled) {
+        stream->enable_scheduled_writes(WriteScheduler::Parameters(policy, 64));
+    }
+
+    std::vector<uint8_t> bulk(ChunkSize*ChunkCount);
+    for(std::size_t i = 0; i < bulk.size(); i++) {
+        bulk[i] = (i * 7) % 251;
+    }
+
+    // slow reader
+    std::vector<uint8_t> received;
+    std::atomic<std::size_t> receivedCount(0);
+    std::atomic<bool> stopDrain(false);
+    std::thread drain([&]() {
+        uint8_t buf[1024];
+        while(!stopDrain) {
+            ssize_t count = ::recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT);
+            if(count > 0) {
+                received.insert(received.end(), buf, buf + count);
+                receivedCount += count;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    // bulk transfer at the lowest priority.
+    std::atomic<std::size_t> bulkDone(0);
+    std::thread bulkWriter([&]() {
+        for(std::size_t i = 0; i < ChunkCount; i++) {
+            if(write_retry(stream, 2, ChunkSize, bulk.data() + i*ChunkSize)
+               != ChunkSize)
+            {
+                return;
+            }
+            bulkDone++;
+        }
+    });
+
+    std::vector<uint8_t> urgent(UrgentSize, Marker);
+    std::size_t urgentCount = 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    while(bulkDone < ChunkCount - 2) {
+        auto t0 = Clock::now();
+        std::size_t written = write_retry(stream, 0, UrgentSize, urgent.data());
+        res.latencies.push_back(std::chrono::duration<double, std::milli>(
+                                Clock::now() - t0).count());
+        urgentCount += written == UrgentSize;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    bulkWriter.join();
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while(Clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if(receivedCount >= bulk.size() + urgentCount*UrgentSize) break;
+    }
+    stopDrain = true;
+    drain.join();
+
+    // urgent messages are interleaved between slices, the bulk data must
+    // be intact once they are removed.
+    std::vector<uint8_t> data;
+    std::size_t markers = 0;
+    for(auto b : received) {
+        if(b == Marker) markers++;
+        else data.push_back(b);
+    }
+    res.intact = data == bulk && markers == urgentCount*UrgentSize;
+
+    cout << name << " : " << res.latencies.size() << " urgent writes, latency (ms)"
+         << " p50 " << percentile(res.latencies, 0.5)
+         << " p99 " << percentile(res.latencies, 0.99)
+         << " max " << percentile(res.latencies, 1.0) << endl;
+    return res;
+}
+
+int main()
+{
+    bool ok = true;
+
+    auto baseline = run("baseline     ", false, WriteScheduler::StrictPriority);
+    auto strict   = run("strict       ", true,  WriteScheduler::StrictPriority);
+    auto fair     = run("weighted fair", true,  WriteScheduler::WeightedFair);
+
+    ok &= check(baseline.intact, "baseline data intact");
+    ok &= check(strict.intact,   "strict priority data intact");
+    ok &= check(fair.intact,     "weighted fair data intact");
+    ok &= check(strict.latencies.size() > 0 && fair.latencies.size() > 0,
+                "urgent writes were sent during the bulk transfer");
+    ok &= check(percentile(strict.latencies, 0.99)
+                < 0.5*percentile(baseline.latencies, 0.99),
+                "strict priority p99 latency well below the baseline");
+    ok &= check(percentile(fair.latencies, 0.99)
+                < 0.5*percentile(baseline.latencies, 0.99),
+                "weighted fair p99 latency well below the baseline");
+
+    cout << (ok ? "All tests passed" : "Some tests failed") << endl;
+    return ok ? 0 : 1;
+}